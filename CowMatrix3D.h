@@ -0,0 +1,309 @@
+#ifndef COW_MAT3D_H
+#define COW_MAT3D_H
+
+#include <iostream>
+#include <atomic>
+#include <memory> //allocator
+#include <utility> //move, swap
+#include <cstddef> //size_t
+#include <cassert>
+
+#include "Matrix3D.h"
+
+/**
+  @brief CowMatrix3D Class
+
+  Copy-on-write counterpart of Matrix3D, for matrixes passed by value through
+  several layers of code which mostly read them. The cells are kept in a
+  Matrix3D owned by a block shared by all the copies and counted by an atomic
+  reference count: copying a CowMatrix3D is O(1), and the cells are deep
+  copied only when a shared matrix is written (detached), by the non-const
+  operator(), begin()/end(), fill(), fill_region() and mutable_matrix().
+  swap() only exchanges the blocks.
+
+  Concurrent reads of the copies are safe from any number of threads, as
+  are concurrent copies of a matrix only read; as with the standard
+  containers, the same CowMatrix3D object must not be written and accessed
+  at the same time by different threads. Once a non-const method has handed
+  out a reference or an iterator to the cells, they are marked unshareable
+  (leaked, as in the copy-on-write strings of the old libstdc++): the
+  following copies of the matrix are deep, so that writes through the
+  reference never reach them. The cells become shareable again when an
+  assignment replaces them.
+
+  All the functions of Matrix3D reading a matrix work on matrix(), which
+  returns a constant reference to the Matrix3D of the cells without copying.
+
+  @param T type of the data in the cells
+  @param F type of the functor used for the equality of the cells
+  @param Alloc type of the allocator of the cells
+  @param Layout layout of the cells in the array
+*/
+template <typename T, typename F = default_functor<T>, typename Alloc = std::allocator<T>, typename Layout = row_major_layout>
+class CowMatrix3D {
+
+public:
+
+	typedef Matrix3D<T, F, Alloc, Layout> matrix_type; ///< type of the matrix holding the cells
+	typedef typename matrix_type::size_type size_type; ///< type of the dimensions and indexes
+	typedef T value_type; ///< type of the data in the cells
+	typedef typename matrix_type::iterator iterator; ///< iterator on the cells (detaches)
+	typedef typename matrix_type::const_iterator const_iterator; ///< constant iterator on the cells
+
+private:
+
+	/// cells shared by the copies, with the number of copies
+	struct block {
+		std::atomic<std::size_t> references;
+		bool leaked; ///< true once a reference or an iterator to the cells has been handed out, which forbids sharing them
+		matrix_type matrix;
+
+		explicit block(matrix_type &&m) : references(1), leaked(false), matrix(std::move(m)) {}
+	};
+
+	block *_block; ///< shared cells, nullptr for an empty matrix
+
+	// Return the empty matrix seen through the matrixes without a block
+	static const matrix_type &_empty() {
+		static const matrix_type empty;
+		return empty;
+	}
+
+	// Return the block to use for a copy of other: the same one, counted, or a deep copy when it is leaked
+	static block *_share(const CowMatrix3D &other) {
+		if(other._block == nullptr)
+			return nullptr;
+		if(other._block->leaked)
+			return new block(matrix_type(other._block->matrix));
+		other._block->references.fetch_add(1, std::memory_order_relaxed);
+		matrix3d_instrumentation::count_shared_copy();
+		return other._block;
+	}
+
+	// Detaches the cells and marks them leaked, before handing out a reference or an iterator to them
+	matrix_type &_leak() {
+		_detach();
+		_block->leaked = true;
+		return _block->matrix;
+	}
+
+	// Gives up this reference to the block, deleting it with the last one
+	void _release() noexcept {
+		if(_block != nullptr && _block->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete _block;
+	}
+
+	/**
+	    @brief Detach of the cells
+
+	    Called before every write: if the block is shared with other copies,
+	    the cells are deep copied in a block owned by this matrix only.
+	    The acquire load pairs with the release of the other copies, so that
+	    their reads of the block happen before it is written.
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	void _detach() {
+		if(_block == nullptr) {
+			_block = new block(matrix_type());
+			return;
+		}
+		if(_block->references.load(std::memory_order_acquire) == 1)
+			return;
+		block *own = new block(matrix_type(_block->matrix));
+		matrix3d_instrumentation::count_detach();
+		_release();
+		_block = own;
+	}
+
+public:
+
+	// Default constructor: an empty matrix, without a block
+	CowMatrix3D() noexcept : _block(nullptr) {}
+
+	/**
+	    @brief Secondary constructor (z, y, x)
+
+	    @pre z!=0 && y!=0 && x!=0
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	CowMatrix3D(size_type z, size_type y, size_type x, const Alloc &alloc = Alloc()) : _block(new block(matrix_type(z, y, x, alloc))) {}
+
+	/**
+	    @brief Secondary constructor (z, y, x, value)
+
+	    @pre z!=0 && y!=0 && x!=0
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	CowMatrix3D(size_type z, size_type y, size_type x, const T &value, const Alloc &alloc = Alloc()) :
+		_block(new block(matrix_type(z, y, x, value, alloc))) {}
+
+	// Conversion from a Matrix3D, whose cells are copied
+	explicit CowMatrix3D(const matrix_type &m) : _block(new block(matrix_type(m))) {}
+
+	// Conversion from a Matrix3D, whose cells are moved
+	explicit CowMatrix3D(matrix_type &&m) : _block(new block(std::move(m))) {}
+
+	/**
+	    @brief Copy constructor
+
+	    Shares the cells of other, in O(1), unless they are leaked 
+	    (see the class description): then they are deep copied.
+
+	    @throw std::bad_alloc possible allocation exception, only for leaked cells
+	*/
+	CowMatrix3D(const CowMatrix3D &other) : _block(_share(other)) {}
+
+	// Move constructor: takes the cells of other, which is left empty
+	CowMatrix3D(CowMatrix3D &&other) noexcept : _block(other._block) {
+		other._block = nullptr;
+	}
+
+	// Assignment operator: shares the cells of other, in O(1), or deep copies them if they are leaked
+	CowMatrix3D &operator=(const CowMatrix3D &other) {
+		if(_block != other._block) {
+			block *shared = _share(other);
+			_release();
+			_block = shared;
+		}
+		return *this;
+	}
+
+	// Move assignment operator: exchanges the cells with other
+	CowMatrix3D &operator=(CowMatrix3D &&other) noexcept {
+		swap(other);
+		return *this;
+	}
+
+	~CowMatrix3D() {
+		_release();
+	}
+
+	// Return the constant reference to the matrix of the cells
+	const matrix_type &matrix() const {
+		return _block != nullptr ? _block->matrix : _empty();
+	}
+
+	// Return the reference to the matrix of the cells, detaching them and marking them leaked
+	matrix_type &mutable_matrix() {
+		return _leak();
+	}
+
+	// Return true if no other copy shares the cells
+	bool unique() const {
+		return _block == nullptr || _block->references.load(std::memory_order_acquire) == 1;
+	}
+
+	// Return the number of copies sharing the cells (0 for an empty matrix without a block)
+	std::size_t use_count() const {
+		return _block != nullptr ? _block->references.load(std::memory_order_relaxed) : 0;
+	}
+
+	size_type getFloors() const {
+		return matrix().getFloors();
+	}
+
+	size_type getRows() const {
+		return matrix().getRows();
+	}
+
+	size_type getColumns() const {
+		return matrix().getColumns();
+	}
+
+	size_type size() const {
+		return matrix().size();
+	}
+
+	// Getter of data in a cell
+	const T &operator()(size_type z, size_type y, size_type x) const {
+		return matrix()(z, y, x);
+	}
+
+	// Getter/setter of data in a cell, detaching the cells and marking them leaked
+	T &operator()(size_type z, size_type y, size_type x) {
+		return _leak()(z, y, x);
+	}
+
+	const_iterator begin() const {
+		return matrix().begin();
+	}
+
+	const_iterator end() const {
+		return matrix().end();
+	}
+
+	const_iterator cbegin() const {
+		return matrix().begin();
+	}
+
+	const_iterator cend() const {
+		return matrix().end();
+	}
+
+	// Return the iterator to the start of the cells, detaching them and marking them leaked
+	iterator begin() {
+		return _leak().begin();
+	}
+
+	// Return the iterator at the end of the cells, detaching them and marking them leaked
+	iterator end() {
+		return _leak().end();
+	}
+
+	// Fills the cells with a sequence (see Matrix3D::fill), detaching them
+	template <typename Iter>
+	void fill(Iter b, Iter e) {
+		_detach();
+		_block->matrix.fill(b, e);
+	}
+
+	// Assigns the value to all the cells: shared cells are replaced without being copied
+	void fill(const T &value) {
+		if(!unique()) {
+			if(size() == 0)
+				return;
+			*this = CowMatrix3D(getFloors(), getRows(), getColumns(), value, matrix().get_allocator());
+			return;
+		}
+		if(_block != nullptr)
+			_block->matrix.fill(value);
+	}
+
+	// Assigns the value to the cells of a region (see Matrix3D::fill_region), detaching them
+	void fill_region(size_type z1, size_type z2, size_type y1, size_type y2, size_type x1, size_type x2, const T &value) {
+		_detach();
+		_block->matrix.fill_region(z1, z2, y1, y2, x1, x2, value);
+	}
+
+	// Exchanges the cells of two matrixes, in O(1) and without detaching them
+	void swap(CowMatrix3D &other) noexcept {
+		std::swap(_block, other._block);
+	}
+
+	friend void swap(CowMatrix3D &a, CowMatrix3D &b) noexcept {
+		a.swap(b);
+	}
+
+	// Two matrixes sharing the cells are equal without looking at them, when every cell equals itself (see is_bitwise_comparable)
+	bool operator==(const CowMatrix3D &other) const {
+		if constexpr (is_bitwise_comparable<T, F>::value)
+			if(_block == other._block)
+				return true;
+		if(getFloors() != other.getFloors() || getRows() != other.getRows() || getColumns() != other.getColumns())
+			return false;
+		return matrix() == other.matrix();
+	}
+
+	bool operator!=(const CowMatrix3D &other) const {
+		return !(*this == other);
+	}
+
+	friend std::ostream &operator<<(std::ostream &os, const CowMatrix3D &m) {
+		return os << m.matrix();
+	}
+};
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef FIXED_MAT3D_H
+#define FIXED_MAT3D_H
+
+#include <iostream>
+#include <array>
+#include <cstddef> //size_t
+#include <type_traits> //is_invocable, enable_if
+#include <cassert>
+
+#include "Matrix3D.h"
+
+/**
+  @brief FixedMatrix3D Class
+
+  Counterpart of Matrix3D for small shapes known at compile time, such as
+  3x3x3 neighbourhoods or 4x4x4 kernels. The Z x Y x X cells are stored
+  row-major in a std::array inside the object, so a FixedMatrix3D never
+  allocates, lives on the stack or inside other objects, and can be built,
+  read, sliced and compared in constant expressions. The strides are
+  compile-time constants, so that loops over the cells can be fully unrolled.
+
+  It offers the same interface as Matrix3D where it makes sense:
+  operator()(z, y, x), slice (with the bounds as template parameters, since
+  they decide the type of the result), fill(), swap(), ==, !=, iterators,
+  the stream operator and trasform().
+
+  @param T type of the data in the cells
+  @param Z number of floors
+  @param Y number of rows
+  @param X number of columns
+  @param F type of the functor used for the equality of the cells
+*/
+template <typename T, std::size_t Z, std::size_t Y, std::size_t X, typename F = default_functor<T>>
+class FixedMatrix3D {
+
+	static_assert(Z > 0 && Y > 0 && X > 0, "a FixedMatrix3D cannot be empty");
+
+public:
+
+	typedef std::size_t size_type; ///< type of the dimensions and indexes
+	typedef T value_type; ///< type of the data in the cells
+	typedef T *iterator; ///< iterator on the cells, in row-major order
+	typedef const T *const_iterator; ///< constant iterator on the cells, in row-major order
+
+	static constexpr size_type floor_stride = Y * X; ///< distance between two floors in the array
+	static constexpr size_type row_stride = X; ///< distance between two rows in the array
+
+private:
+
+	std::array<T, Z * Y * X> _matrix; ///< cells, row-major (the functor F is not stored, to keep the size of the cells only)
+
+public:
+
+	/**
+	    @brief Default constructor
+
+	    Value-initializes all the cells.
+	*/
+	constexpr FixedMatrix3D() : _matrix() {}
+
+	/**
+	    @brief Secondary constructor (value)
+
+	    Initializes all the cells with the given value.
+
+	    @param value the value to initialize the cells with
+	*/
+	constexpr explicit FixedMatrix3D(const T &value) : _matrix() {
+		fill(value);
+	}
+
+	/**
+	    @brief Secondary constructor (cells)
+
+	    Initializes the cells with the given values, in row-major order:
+	    FixedMatrix3D<int, 1, 2, 2>({1, 2, 3, 4}).
+
+	    @param cells the values of the cells
+	*/
+	constexpr explicit FixedMatrix3D(const std::array<T, Z * Y * X> &cells) : _matrix(cells) {}
+
+	/**
+	    @brief Conversion from a Matrix3D
+
+	    Copies the cells of a Matrix3D with the same dimensions.
+
+	    @pre A.getFloors() == Z && A.getRows() == Y && A.getColumns() == X
+	*/
+	template <typename G, typename Alloc, typename L>
+	explicit FixedMatrix3D(const Matrix3D<T, G, Alloc, L> &A) : _matrix() {
+		assert(A.getFloors() == Z && A.getRows() == Y && A.getColumns() == X);
+		for(size_type z = 0; z < Z; ++z)
+			for(size_type y = 0; y < Y; ++y)
+				for(size_type x = 0; x < X; ++x)
+					(*this)(z, y, x) = A(z, y, x);
+	}
+
+	// Return the number of floors
+	static constexpr size_type getFloors() {
+		return Z;
+	}
+
+	// Return the number of rows
+	static constexpr size_type getRows() {
+		return Y;
+	}
+
+	// Return the number of columns
+	static constexpr size_type getColumns() {
+		return X;
+	}
+
+	// Return the number of cells
+	static constexpr size_type size() {
+		return Z * Y * X;
+	}
+
+	// Return the offset of a cell in the array
+	static constexpr size_type offset(size_type z, size_type y, size_type x) {
+		return z * floor_stride + y * row_stride + x;
+	}
+
+	/**
+	    @brief Getter of data in a cell
+
+	    @pre z < Z && y < Y && x < X
+	*/
+	constexpr const T &operator()(size_type z, size_type y, size_type x) const {
+		assert(z < Z && y < Y && x < X);
+		return _matrix[offset(z, y, x)];
+	}
+
+	/**
+	    @brief Getter/setter of data in a cell
+
+	    @pre z < Z && y < Y && x < X
+	*/
+	constexpr T &operator()(size_type z, size_type y, size_type x) {
+		assert(z < Z && y < Y && x < X);
+		return _matrix[offset(z, y, x)];
+	}
+
+	/**
+	    @brief slice method
+
+	    Return the FixedMatrix3D containing the cells in the coordinate
+	    intervals z1-z2, y1-y2 and x1-x2 (bounds included, as in Matrix3D::slice),
+	    checked at compile time.
+	*/
+	template <size_type z1, size_type z2, size_type y1, size_type y2, size_type x1, size_type x2>
+	constexpr FixedMatrix3D<T, z2 - z1 + 1, y2 - y1 + 1, x2 - x1 + 1, F> slice() const {
+		static_assert(z1 <= z2 && z2 < Z && y1 <= y2 && y2 < Y && x1 <= x2 && x2 < X, "the slice must be inside the matrix");
+		FixedMatrix3D<T, z2 - z1 + 1, y2 - y1 + 1, x2 - x1 + 1, F> sliced;
+		for(size_type z = z1; z <= z2; ++z)
+			for(size_type y = y1; y <= y2; ++y)
+				for(size_type x = x1; x <= x2; ++x)
+					sliced(z - z1, y - y1, x - x1) = (*this)(z, y, x);
+		return sliced;
+	}
+
+	// Return a Matrix3D with the same cells
+	template <typename Alloc = std::allocator<T>, typename L = row_major_layout>
+	Matrix3D<T, F, Alloc, L> to_matrix(const Alloc &alloc = Alloc()) const {
+		Matrix3D<T, F, Alloc, L> A(Z, Y, X, alloc);
+		for(size_type z = 0; z < Z; ++z)
+			for(size_type y = 0; y < Y; ++y)
+				for(size_type x = 0; x < X; ++x)
+					A(z, y, x) = (*this)(z, y, x);
+		return A;
+	}
+
+	/**
+	    @brief Equality operator
+
+	    Two fixed matrixes are equal if their cells are equal according to
+	    the functor F (the dimensions are part of the type).
+	*/
+	constexpr bool operator==(const FixedMatrix3D &other) const {
+		F equals{};
+		for(size_type i = 0; i < size(); ++i)
+			if(!equals(_matrix[i], other._matrix[i]))
+				return false;
+		return true;
+	}
+
+	constexpr bool operator!=(const FixedMatrix3D &other) const {
+		return !(*this == other);
+	}
+
+	// Assigns the value to all the cells
+	constexpr void fill(const T &value) {
+		for(size_type i = 0; i < size(); ++i)
+			_matrix[i] = value;
+	}
+
+	// Swaps the cells of two fixed matrixes
+	void swap(FixedMatrix3D &other) {
+		_matrix.swap(other._matrix);
+	}
+
+	// Return the pointer to the array of the cells
+	constexpr T *data() {
+		return _matrix.data();
+	}
+
+	// Return the pointer to the array of the cells
+	constexpr const T *data() const {
+		return _matrix.data();
+	}
+
+	// Return the iterator to the start of the data sequence
+	constexpr iterator begin() {
+		return _matrix.data();
+	}
+
+	// Return the iterator at the end of the data sequence
+	constexpr iterator end() {
+		return _matrix.data() + size();
+	}
+
+	// Return the constant iterator to the start of the data sequence
+	constexpr const_iterator begin() const {
+		return _matrix.data();
+	}
+
+	// Return the constant iterator at the end of the data sequence
+	constexpr const_iterator end() const {
+		return _matrix.data() + size();
+	}
+
+	/**
+	    @brief Stream operator
+
+	    Prints the dimensions and each floor of the matrix, as the stream
+	    operator of Matrix3D.
+	*/
+	friend std::ostream &operator<<(std::ostream &os, const FixedMatrix3D &m) {
+
+		os << "rows: " << Y << '\n';
+		os << "columns: " << X << '\n';
+		os << "floors: " << Z << '\n';
+
+		os << "matrix: " << '\n';
+
+		for(size_type z = 0; z < Z; ++z) {
+
+			os << z+1 << "° floor: " << z << '\n';
+
+			for(size_type y = 0; y < Y; ++y) {
+
+				for(size_type x = 0; x < X; ++x)
+					os << m(z, y, x) << " ";
+
+				os << '\n';
+			}
+
+			os << '\n';
+		}
+
+		return os;
+	}
+};
+
+/**
+    @brief Global function transform (fixed matrix)
+
+    Same as the transform function on a Matrix3D: return the FixedMatrix3D
+    obtained by applying a default-constructed functor of type F to the
+    cells of A. Nothing is allocated.
+
+    @param A the starting fixed matrix
+
+    @return the fixed matrix of the transformed cells
+*/
+template <typename Q, typename F, typename H = default_functor<Q>, typename T, std::size_t Z, std::size_t Y, std::size_t X, typename G>
+constexpr FixedMatrix3D<Q, Z, Y, X, H> trasform(const FixedMatrix3D<T, Z, Y, X, G> &A) {
+	FixedMatrix3D<Q, Z, Y, X, H> B;
+	F functor{};
+	for(std::size_t i = 0; i < A.size(); ++i)
+		B.data()[i] = functor(A.data()[i]);
+	return B;
+}
+
+/**
+    @brief Global function transform (fixed matrix, functor object)
+
+    Same as the transform function taking a functor object, on a
+    FixedMatrix3D: the functor (e.g. a lambda) is applied to the cells in order.
+
+    @param A the starting fixed matrix
+    @param functor the functor to apply to the data in the cells
+
+    @return the fixed matrix of the transformed cells
+*/
+template <typename Q, typename H = default_functor<Q>, typename T, std::size_t Z, std::size_t Y, std::size_t X, typename G, typename Fn,
+	typename = typename std::enable_if<std::is_invocable<Fn&, const T&>::value>::type>
+constexpr FixedMatrix3D<Q, Z, Y, X, H> trasform(const FixedMatrix3D<T, Z, Y, X, G> &A, Fn functor) {
+	FixedMatrix3D<Q, Z, Y, X, H> B;
+	for(std::size_t i = 0; i < A.size(); ++i)
+		B.data()[i] = functor(A.data()[i]);
+	return B;
+}
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef HASHED_MAT3D_H
+#define HASHED_MAT3D_H
+
+#include <iostream>
+#include <cstdint> //uint64_t
+#include <utility> //move, swap
+#include <cstddef> //size_t
+
+#include "Matrix3D.h"
+
+/**
+  @brief HashedMatrix3D Class
+
+  Matrix3D kept together with its content hash (see Matrix3D::hash()), for
+  matrixes used as the keys of unordered containers or compared many times
+  for deduplication. The hash is computed once, when the cells are set, and
+  the cells can only be written by the bulk mutators fill() and
+  fill_region(), which compute it again: no reference or iterator able to
+  write the cells is ever handed out, so the stored hash is always the hash
+  of the content and hash() is O(1).
+
+  Matrixes with different hashes are different, so operator== compares the
+  cells only when the hashes match. All the functions of Matrix3D reading a
+  matrix work on matrix(); a matrix to modify cell by cell is taken back
+  with release() and wrapped again after the writes.
+
+  @param T type of the data in the cells, hashed as raw bytes or with std::hash enabled
+  @param F type of the functor used for the equality of the cells
+  @param Alloc type of the allocator of the cells
+  @param Layout layout of the cells in the array
+*/
+template <typename T, typename F = default_functor<T>, typename Alloc = std::allocator<T>, typename Layout = row_major_layout>
+class HashedMatrix3D {
+
+	static_assert(matrix3d_hashable<T>::value, "the cells must be hashed as raw bytes or have std::hash enabled");
+
+public:
+
+	typedef Matrix3D<T, F, Alloc, Layout> matrix_type; ///< type of the matrix holding the cells
+	typedef typename matrix_type::size_type size_type; ///< type of the dimensions and indexes
+	typedef T value_type; ///< type of the data in the cells
+	typedef typename matrix_type::const_iterator const_iterator; ///< constant iterator on the cells
+
+private:
+
+	matrix_type _matrix; ///< cells
+	std::uint64_t _hash; ///< content hash of _matrix
+
+	// Return the hash of the empty matrix, left in the moved-from matrixes
+	static std::uint64_t _empty_hash() {
+		static const std::uint64_t empty = matrix_type().hash();
+		return empty;
+	}
+
+public:
+
+	// Default constructor: an empty matrix
+	HashedMatrix3D() : _matrix(), _hash(_empty_hash()) {}
+
+	/**
+	    @brief Secondary constructor (z, y, x, value)
+
+	    @pre z!=0 && y!=0 && x!=0
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	HashedMatrix3D(size_type z, size_type y, size_type x, const T &value, const Alloc &alloc = Alloc()) :
+		_matrix(z, y, x, value, alloc), _hash(_matrix.hash()) {}
+
+	// Conversion from a Matrix3D, whose cells are copied and hashed
+	explicit HashedMatrix3D(const matrix_type &m) : _matrix(m), _hash(_matrix.hash()) {}
+
+	// Conversion from a Matrix3D, whose cells are moved and hashed
+	explicit HashedMatrix3D(matrix_type &&m) : _matrix(std::move(m)), _hash(_matrix.hash()) {}
+
+	// Copy constructor: copies the cells and the hash, without computing it again
+	HashedMatrix3D(const HashedMatrix3D &other) = default;
+
+	// Move constructor: takes the cells and the hash of other, which is left empty
+	HashedMatrix3D(HashedMatrix3D &&other) noexcept : _matrix(std::move(other._matrix)), _hash(other._hash) {
+		other._hash = _empty_hash();
+	}
+
+	// Assignment operator: copies the cells and the hash of other
+	HashedMatrix3D &operator=(const HashedMatrix3D &other) {
+		if(this != &other) {
+			HashedMatrix3D tmp(other);
+			swap(tmp);
+		}
+		return *this;
+	}
+
+	// Move assignment operator: exchanges the cells and the hashes with other
+	HashedMatrix3D &operator=(HashedMatrix3D &&other) noexcept {
+		swap(other);
+		return *this;
+	}
+
+	// Return the constant reference to the matrix of the cells
+	const matrix_type &matrix() const {
+		return _matrix;
+	}
+
+	// Return the content hash, in O(1)
+	std::uint64_t hash() const {
+		return _hash;
+	}
+
+	/**
+	    @brief Release of the cells
+
+	    Moves the matrix of the cells out, to write it cell by cell,
+	    and leaves this matrix empty.
+
+	    @return the matrix of the cells
+	*/
+	matrix_type release() {
+		matrix_type m(std::move(_matrix));
+		_hash = _empty_hash();
+		return m;
+	}
+
+	size_type getFloors() const {
+		return _matrix.getFloors();
+	}
+
+	size_type getRows() const {
+		return _matrix.getRows();
+	}
+
+	size_type getColumns() const {
+		return _matrix.getColumns();
+	}
+
+	size_type size() const {
+		return _matrix.size();
+	}
+
+	// Getter of data in a cell
+	const T &operator()(size_type z, size_type y, size_type x) const {
+		return _matrix(z, y, x);
+	}
+
+	const_iterator begin() const {
+		return _matrix.begin();
+	}
+
+	const_iterator end() const {
+		return _matrix.end();
+	}
+
+	const_iterator cbegin() const {
+		return _matrix.begin();
+	}
+
+	const_iterator cend() const {
+		return _matrix.end();
+	}
+
+	// Fills the cells with a sequence (see Matrix3D::fill), hashing them again
+	template <typename Iter>
+	void fill(Iter b, Iter e) {
+		_matrix.fill(b, e);
+		_hash = _matrix.hash();
+	}
+
+	// Assigns the value to all the cells, hashing them again
+	void fill(const T &value) {
+		_matrix.fill(value);
+		_hash = _matrix.hash();
+	}
+
+	// Assigns the value to the cells of a region (see Matrix3D::fill_region), hashing them again
+	void fill_region(size_type z1, size_type z2, size_type y1, size_type y2, size_type x1, size_type x2, const T &value) {
+		_matrix.fill_region(z1, z2, y1, y2, x1, x2, value);
+		_hash = _matrix.hash();
+	}
+
+	// Exchanges the cells and the hashes of two matrixes
+	void swap(HashedMatrix3D &other) noexcept {
+		_matrix.swap(other._matrix);
+		std::swap(_hash, other._hash);
+	}
+
+	friend void swap(HashedMatrix3D &a, HashedMatrix3D &b) noexcept {
+		a.swap(b);
+	}
+
+	/**
+	    @brief Equality operator
+
+	    Matrixes with different hashes are different without comparing
+	    the cells; with equal hashes, the cells are compared by
+	    Matrix3D::operator==. The short circuit is taken only with the
+	    default functor, for which equal matrixes have equal hashes
+	    (see matrix3d_hash_consistent).
+
+	    @param other HashedMatrix3D to compare
+
+	    @return true if the matrixes are equal, false otherwise
+	*/
+	bool operator==(const HashedMatrix3D &other) const {
+		if constexpr (matrix3d_hash_consistent<T, F>::value)
+			if(_hash != other._hash)
+				return false;
+		return _matrix == other._matrix;
+	}
+
+	bool operator!=(const HashedMatrix3D &other) const {
+		return !(*this == other);
+	}
+
+	friend std::ostream &operator<<(std::ostream &os, const HashedMatrix3D &m) {
+		return os << m._matrix;
+	}
+};
+
+namespace std {
+
+// Hash functor of HashedMatrix3D, returning the stored hash (disabled as the one of Matrix3D, see matrix3d_std_hash)
+template <typename T, typename F, typename Alloc, typename Layout>
+struct hash<HashedMatrix3D<T, F, Alloc, Layout>> :
+	matrix3d_std_hash<HashedMatrix3D<T, F, Alloc, Layout>, matrix3d_hash_consistent<T, F>::value> {};
+
+}
+
+#endif
@@ -3,9 +3,41 @@
 
 #include <iostream>
 #include <algorithm> //swap
+#include <utility> //move
+#include <iterator> //random_access_iterator_tag
+#include <type_traits> //remove_const
+#include <cstddef> //size_t, ptrdiff_t
+#include <cstdint> //uint32_t
+#include <limits> //numeric_limits
+#include <new> //bad_array_new_length, align_val_t
+#include <stdexcept> //length_error
+#include <memory> //allocator, allocator_traits
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <optional>
+#include <functional> //plus, minus, multiplies, divides, less, greater
+#include <charconv> //to_chars, from_chars
+#include <locale>
+#include <string>
+#include <cctype> //isspace
+#include <cstring> //memcpy, memset
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__BMI2__)
+#include <immintrin.h> //_pdep_u32, _pext_u32
+#endif
 
 #include <cassert>
 
+#include "Matrix3DThreadPool.h"
+
 /**
   @brief Matrix3D Class
 
@@ -16,518 +48,5189 @@
 template <typename Q>
 struct default_functor
 {
-	bool operator()(Q a, Q b) const {
+	constexpr bool operator()(Q a, Q b) const {
 		return a == b;
 	}
 };
 
-template <typename T, typename F = default_functor<T>>
-class Matrix3D {
-
-	T* _matrix; ///< pointer to the first cell of the 3D array
+/**
+  @brief Kinds of deep copies
 
-	unsigned int _floors; ///< number of floors of the 3D matrix
-	unsigned int _rows; ///< number of rows of the 3D matrix
-	unsigned int _columns; ///< number of columns of the 3D matrix
+  Operations of Matrix3D copying a whole array of cells, counted separately 
+  by the instrumentation: the copy constructor, the assignment operator, 
+  slice(), fill() and fill_region() (which copy the matrix before filling 
+  the copy when the assignment of the cells may throw) and the conversion 
+  constructor.
+*/
+enum class Matrix3DCopyKind { copy_constructor, copy_assignment, slice, fill, conversion };
 
-	F _equals; //< functor used to check if two data of type T are equal
+const std::size_t matrix3d_copy_kinds = 5; ///< number of kinds of deep copies
 
-public:
+/**
+  @brief Snapshot of the instrumentation counters
 
-	/**
-	    @brief Default constructor
+  Values of the counters of matrix3d_instrumentation at some point: arrays 
+  allocated and deallocated with their bytes, deep copies by kind, 
+  cells written by the deep copies, and the copies of copy-on-write 
+  matrixes (CowMatrix3D) which shared their cells instead of copying them.
+*/
+struct matrix3d_counters {
+	std::size_t allocations; ///< arrays allocated
+	std::size_t deallocations; ///< arrays deallocated
+	std::size_t bytes_allocated; ///< bytes of the arrays allocated
+	std::size_t bytes_deallocated; ///< bytes of the arrays deallocated
+	std::size_t deep_copies[matrix3d_copy_kinds]; ///< deep copies, indexed by Matrix3DCopyKind
+	std::size_t elements_touched; ///< cells written by the deep copies
+	std::size_t shared_copies; ///< copies of copy-on-write matrixes which shared the cells
+	std::size_t detaches; ///< deep copies made by copy-on-write matrixes written while shared
+
+	// Return the number of deep copies avoided by the copy-on-write matrixes
+	std::size_t copies_saved() const {
+		return shared_copies > detaches ? shared_copies - detaches : 0;
+	}
 
-	    The default constructor is used to initialize member data
-	    to represent an empty 3D array.
+	// Return the number of deep copies of a kind
+	std::size_t copies(Matrix3DCopyKind kind) const {
+		return deep_copies[static_cast<std::size_t>(kind)];
+	}
 
-	    @post _matrix = nullptr
-	    @post _floors == 0
-	    @post _rows == 0
-	    @post _column == 0
-	*/
-	Matrix3D() : _matrix(nullptr), _floors(0), _rows(0), _columns(0) {}
+	// Return the number of deep copies of all kinds
+	std::size_t total_copies() const {
+		std::size_t total = 0;
+		for(std::size_t i = 0; i < matrix3d_copy_kinds; ++i)
+			total += deep_copies[i];
+		return total;
+	}
 
 	/**
-	    @brief Secondary constructor (z, y, x)
+	    @brief Export of the counters
 
-	    Secondary constructor used to construct a 3D matrix based on 
-	    the given dimensions. The cells of the array are not initialized.
-
-	    @param z number of floors of the 3D matrix to create
-	    @param y number of rows of the 3D matrix to create
-	    @param x number of columns of the 3D matrix to create
+	    Calls fn(name, value) for each counter, with names like "allocations" 
+	    or "deep_copies.slice", to export them to a metrics system.
+	*/
+	template <typename Fn>
+	void visit(Fn fn) const {
+		static const char *const copy_names[matrix3d_copy_kinds] = {
+			"deep_copies.copy_constructor", "deep_copies.copy_assignment", "deep_copies.slice", 
+			"deep_copies.fill", "deep_copies.conversion"
+		};
+		fn("allocations", allocations);
+		fn("deallocations", deallocations);
+		fn("bytes_allocated", bytes_allocated);
+		fn("bytes_deallocated", bytes_deallocated);
+		for(std::size_t i = 0; i < matrix3d_copy_kinds; ++i)
+			fn(copy_names[i], deep_copies[i]);
+		fn("elements_touched", elements_touched);
+		fn("shared_copies", shared_copies);
+		fn("detaches", detaches);
+	}
+};
 
-	    @pre z!=0 && y!=0 && x!=0
+/**
+  @brief Instrumentation of Matrix3D
+
+  Process-wide counters of the memory traffic caused by the matrixes: 
+  allocations and deallocations of arrays, deep copies by kind and cells 
+  written by them. The counters are only updated when the program is 
+  compiled with MATRIX3D_INSTRUMENTATION defined; otherwise the counting 
+  functions are empty and the snapshots are all zeros, so the 
+  instrumentation costs nothing. The counters are relaxed atomics, so 
+  they can be updated and read from any thread.
+*/
+class matrix3d_instrumentation {
 
-	    @post _matrix != nullptr
-	    @post _floors == z
-	    @post _rows == y
-	    @post _column == x
+	static inline std::atomic<std::size_t> _allocations{0};
+	static inline std::atomic<std::size_t> _deallocations{0};
+	static inline std::atomic<std::size_t> _bytes_allocated{0};
+	static inline std::atomic<std::size_t> _bytes_deallocated{0};
+	static inline std::atomic<std::size_t> _deep_copies[matrix3d_copy_kinds] = {};
+	static inline std::atomic<std::size_t> _elements_touched{0};
+	static inline std::atomic<std::size_t> _shared_copies{0};
+	static inline std::atomic<std::size_t> _detaches{0};
 
-	    @throw std::bad_alloc possible allocation exception
-	*/
-	Matrix3D(int z, int y, int x) : _matrix(nullptr), _floors(z), _rows(y), _columns(x) {
+public:
 
-		assert(z > 0 && y > 0 && x > 0);
+#if defined(MATRIX3D_INSTRUMENTATION)
+	static constexpr bool enabled = true;
+#else
+	static constexpr bool enabled = false;
+#endif
+
+	// Counts the allocation of an array
+	static void count_allocation(std::size_t bytes) {
+		if constexpr (enabled) {
+			_allocations.fetch_add(1, std::memory_order_relaxed);
+			_bytes_allocated.fetch_add(bytes, std::memory_order_relaxed);
+		}
+	}
 
-		try {
-			_matrix = new T[z * y * x];
+	// Counts the deallocation of an array
+	static void count_deallocation(std::size_t bytes) {
+		if constexpr (enabled) {
+			_deallocations.fetch_add(1, std::memory_order_relaxed);
+			_bytes_deallocated.fetch_add(bytes, std::memory_order_relaxed);
 		}
-		catch(...) {
-			clear();
-			throw;
+	}
+
+	// Counts a deep copy writing the given number of cells
+	static void count_copy(Matrix3DCopyKind kind, std::size_t cells) {
+		if constexpr (enabled) {
+			_deep_copies[static_cast<std::size_t>(kind)].fetch_add(1, std::memory_order_relaxed);
+			_elements_touched.fetch_add(cells, std::memory_order_relaxed);
 		}
+	}
 
+	// Counts a copy of a copy-on-write matrix which shares the cells
+	static void count_shared_copy() {
+		if constexpr (enabled)
+			_shared_copies.fetch_add(1, std::memory_order_relaxed);
 	}
 
-	/**
-	    @brief Secondary constructor (z, y, x, value)
+	// Counts the deep copy made when a shared copy-on-write matrix is written
+	static void count_detach() {
+		if constexpr (enabled)
+			_detaches.fetch_add(1, std::memory_order_relaxed);
+	}
 
-	    Secondary constructor which is used to construct a 3D matrix based on 
-	    the given dimensions, and which initializes each cell of the matrix to 
-	    the value of type T value passed.
+	// Return the current values of the counters
+	static matrix3d_counters snapshot() {
+		matrix3d_counters c;
+		c.allocations = _allocations.load(std::memory_order_relaxed);
+		c.deallocations = _deallocations.load(std::memory_order_relaxed);
+		c.bytes_allocated = _bytes_allocated.load(std::memory_order_relaxed);
+		c.bytes_deallocated = _bytes_deallocated.load(std::memory_order_relaxed);
+		for(std::size_t i = 0; i < matrix3d_copy_kinds; ++i)
+			c.deep_copies[i] = _deep_copies[i].load(std::memory_order_relaxed);
+		c.elements_touched = _elements_touched.load(std::memory_order_relaxed);
+		c.shared_copies = _shared_copies.load(std::memory_order_relaxed);
+		c.detaches = _detaches.load(std::memory_order_relaxed);
+		return c;
+	}
 
-	    @param z number of floors of the 3D matrix to create
-	    @param y number of rows of the 3D matrix to create
-	    @param x number of columns of the 3D matrix to create
-	    @param value value of the type of the array with which to initialize the cells
+	// Sets all the counters to zero
+	static void reset() {
+		_allocations.store(0, std::memory_order_relaxed);
+		_deallocations.store(0, std::memory_order_relaxed);
+		_bytes_allocated.store(0, std::memory_order_relaxed);
+		_bytes_deallocated.store(0, std::memory_order_relaxed);
+		for(std::size_t i = 0; i < matrix3d_copy_kinds; ++i)
+			_deep_copies[i].store(0, std::memory_order_relaxed);
+		_elements_touched.store(0, std::memory_order_relaxed);
+		_shared_copies.store(0, std::memory_order_relaxed);
+		_detaches.store(0, std::memory_order_relaxed);
+	}
+};
 
-	    @pre z!=0 && y!=0 && x!=0
+/**
+  @brief Fast text trait
 
-	    @post _matrix != nullptr
-	    @post _floors == z
-	    @post _rows == y
-	    @post _column == x
+  True for the types of cells written by the stream operator of Matrix3D 
+  with std::to_chars and read back with std::from_chars (the arithmetic 
+  types); the cells of the other types go through their own stream operators.
+*/
+template <typename T>
+struct matrix3d_fast_text : std::is_arithmetic<T> {};
 
-	    @throw std::bad_alloc possible allocation exception
-	*/
-	Matrix3D(int z, int y, int x, const T &value) : _matrix(nullptr), _floors(z), _rows(y), _columns(x) {
+/**
+  @brief Buffered text writer
+
+  Writes the text of a matrix into a local buffer, which is passed to the 
+  stream only when full and at the end, instead of through the formatted 
+  output of the stream for every token. The arithmetic values are formatted 
+  with std::to_chars, giving the same text as a stream in its default 
+  state: integers in decimal, characters as themselves, bool as 0 or 1, 
+  floating point values as %g with the precision of the stream.
+*/
+class matrix3d_text_writer {
 
-		assert(z > 0 && y > 0 && x > 0);
+	static constexpr std::size_t capacity = 1 << 13; ///< small enough for the stack of any thread, large enough to batch the writes
+	static constexpr std::size_t max_token = 512; ///< longest token written without checking the space left
 
-		try {
-			_matrix = new T[z * y * x];
-			for (unsigned int i = 0; i < _floors * _rows * _columns; ++i)
-				_matrix[i] = value;
-		}
-		catch(...) {
-			clear();
-			throw;
-		}
+	std::ostream &_os;
+	int _precision;
+	std::size_t _used;
+	char _buffer[capacity];
 
+	void _reserve(std::size_t n) {
+		if(_used + n > capacity)
+			flush();
 	}
 
-	/**
-	    @brief Copy Constructor
+public:
 
-	    Copy constructor. It is used to create an object as a copy of 
-	    another object. The two objects must be independent.
+	explicit matrix3d_text_writer(std::ostream &os) : _os(os), _precision(int(os.precision())), _used(0) {}
 
-	    @param other source Matrix3D to copy
-	    
-	    @post _matrix != nullptr
-	    @post _floors == other._floors
-	    @post _rows == other._rows
-	    @post _column == other._column
+	~matrix3d_text_writer() {
+		flush();
+	}
 
-	    @throw std::bad_alloc possible allocation exception
+	matrix3d_text_writer(const matrix3d_text_writer &) = delete;
+	matrix3d_text_writer &operator=(const matrix3d_text_writer &) = delete;
+
+	/**
+	    @brief Stream state check
+
+	    Return true if the stream formats the arithmetic values as 
+	    std::to_chars does: default flags, no width and the classic locale.
 	*/
-	Matrix3D(const Matrix3D &other) : _matrix(nullptr), _floors(other._floors), _rows(other._rows), _columns(other._columns) {
-		try {
-			_matrix = new T[other._floors * other._rows * other._columns];
-			for (unsigned int i = 0; i < _floors * _rows * _columns; ++i)
-				_matrix[i] = other._matrix[i];
-		}
-		catch(...) {
-			clear();
-			throw;
-		}
-		
+	static bool is_plain(const std::ios_base &s) {
+		return s.flags() == (std::ios_base::skipws | std::ios_base::dec) && s.width() == 0 && 
+			s.precision() >= 0 && s.precision() <= 100 && s.getloc() == std::locale::classic();
 	}
 
-	/**
-	    @brief Assignment operator
+	// Passes the buffered text to the stream
+	void flush() {
+		if(_used > 0)
+			_os.write(_buffer, std::streamsize(_used));
+		_used = 0;
+	}
 
-	    The assignment operator is used to copy the contents of one 
-	    object into another object of the same type. 
-	    The two objects must be independent.
+	// Writes a character
+	void put(char c) {
+		_reserve(1);
+		_buffer[_used++] = c;
+	}
 
-	    @param other source Matrix3D to copy
+	// Writes a string
+	void put(const char *s) {
+		for(; *s; ++s)
+			put(*s);
+	}
 
-	    @return a reference to the current object
+	// Writes an arithmetic value
+	template <typename V>
+	void put_value(V value) {
+		static_assert(std::is_arithmetic<V>::value, "only the arithmetic types are written with to_chars");
+		_reserve(max_token);
+		char *first = _buffer + _used, *last = first + max_token;
+		if constexpr (std::is_same<V, bool>::value)
+			*first++ = value ? '1' : '0';
+		else if constexpr (std::is_same<V, char>::value || std::is_same<V, signed char>::value || std::is_same<V, unsigned char>::value)
+			*first++ = char(value);
+		else if constexpr (std::is_floating_point<V>::value)
+			first = std::to_chars(first, last, value, std::chars_format::general, _precision).ptr;
+		else
+			first = std::to_chars(first, last, value).ptr;
+		_used = std::size_t(first - _buffer);
+	}
 
-	    @post _matrix != nullptr
-	    @post _floors == other._floors
-	    @post _rows == other._rows
-	    @post _column == other._column 
-	*/
-	Matrix3D &operator=(const Matrix3D &other) {
-		if(this != &other) {
-			Matrix3D tmp(other);
-			this->swap(tmp);
+	// Writes the text of a matrix or of a view, in the format of the stream operator of Matrix3D, reading the cells through m(z, y, x)
+	template <typename M>
+	void put_matrix(const M &m) {
+		put("rows: ");
+		put_value(m.getRows());
+		put("\ncolumns: ");
+		put_value(m.getColumns());
+		put("\nfloors: ");
+		put_value(m.getFloors());
+		put("\nmatrix: \n");
+
+		for(std::size_t z = 0; z < m.getFloors(); ++z) {
+			put_value(z + 1);
+			put("° floor: ");
+			put_value(z);
+			put('\n');
+			for(std::size_t y = 0; y < m.getRows(); ++y) {
+				for(std::size_t x = 0; x < m.getColumns(); ++x) {
+					put_value(m(z, y, x));
+					put(' ');
+				}
+				put('\n');
+			}
+			put('\n');
 		}
-
-		return *this;
 	}
+};
 
-	/**
-	    @brief Access to the number of floors of the 3D matrix
+/**
+  @brief Text reader
 
-	    Method to obtain the number of floors of the 3D matrix.
+  Reads the whitespace-separated tokens of the text of a matrix directly 
+  from the buffer of a stream, without consuming anything after the last 
+  token read, and parses the arithmetic values with std::from_chars.
+*/
+class matrix3d_text_reader {
 
-    	@return number of floors of the 3D matrix
-	*/
-	unsigned int getFloors() const {
-		return _floors;
-	}
+	static constexpr std::size_t max_token = 512;
 
-	/**
-	    @brief Access to the number of rows of the 3D matrix
+	std::streambuf *_buf;
+	char _token[max_token];
+	std::size_t _length;
 
-	    Method to obtain the number of rows of the 3D matrix.
+public:
 
-    	@return number of rows of the 3D matrix
-	*/
-	unsigned int getRows() const {
-		return _rows;
-	}
+	explicit matrix3d_text_reader(std::streambuf *buf) : _buf(buf), _length(0) {}
 
 	/**
-	    @brief Access to the number of columns of the 3D matrix
+	    @brief Reads the next token
 
-	    Method to obtain the number of columns of the 3D matrix.
+	    Skips the whitespaces and reads the characters up to the next 
+	    whitespace or the end of the stream.
 
-    	@return number of columns of the 3D matrix
+	    @return false if the stream ended before a token, or the token is too long
 	*/
-	unsigned int getColumns() const {
-		return _columns;
+	bool next() {
+		typedef std::char_traits<char> traits;
+		traits::int_type c = _buf->sgetc();
+		while(!traits::eq_int_type(c, traits::eof()) && std::isspace(static_cast<unsigned char>(traits::to_char_type(c))))
+			c = _buf->snextc();
+		_length = 0;
+		while(!traits::eq_int_type(c, traits::eof()) && !std::isspace(static_cast<unsigned char>(traits::to_char_type(c)))) {
+			if(_length == max_token)
+				return false;
+			_token[_length++] = traits::to_char_type(c);
+			c = _buf->snextc();
+		}
+		return _length > 0;
 	}
 
-	/**
-	    @brief swap method
+	// Reads the next token and return true if it is the given word
+	bool expect(const char *word) {
+		return next() && std::char_traits<char>::length(word) == _length && 
+			std::char_traits<char>::compare(word, _token, _length) == 0;
+	}
 
-	    Function that swaps the contents and dimensions of two 3D matrixes.
+	// Reads the next token and return true if it is an arithmetic value, written to value
+	template <typename V>
+	bool value(V &value) {
+		static_assert(std::is_arithmetic<V>::value, "only the arithmetic types are read with from_chars");
+		if(!next())
+			return false;
+		if constexpr (std::is_same<V, bool>::value) {
+			value = (_token[0] == '1');
+			return _length == 1 && (_token[0] == '0' || _token[0] == '1');
+		}
+		else if constexpr (std::is_same<V, char>::value || std::is_same<V, signed char>::value || std::is_same<V, unsigned char>::value) {
+			value = V(_token[0]);
+			return _length == 1;
+		}
+		else {
+			const char *first = _token, *last = _token + _length;
+			if(*first == '+' && _length > 1) // written by showpos, not accepted by from_chars
+				++first;
+			std::from_chars_result r;
+			if constexpr (std::is_floating_point<V>::value)
+				r = std::from_chars(first, last, value, std::chars_format::general);
+			else
+				r = std::from_chars(first, last, value);
+			return r.ec == std::errc() && r.ptr == last;
+		}
+	}
+};
 
-	    @param other the Matrix3D with which to exchange content
-	*/
-	void swap(Matrix3D &other) {
-        std::swap(_matrix, other._matrix);
-        std::swap(_rows, other._rows);
-        std::swap(_columns, other._columns);
-        std::swap(_floors, other._floors);
-    }
+/**
+    Minimum number of cells of the blocks processed by a thread in the parallel 
+    transformations and fills, large enough to amortize the scheduling of the block 
+    even with the cheapest functors.
+*/
+const std::size_t trasform_grain = 4096;
 
-    /**
-    	@brief clear method
+/**
+  @brief Contiguous iterator trait
 
-    	Function that empties the Matrix3D, deallocating the memory allocated 
-    	on the heap, and bringing member data to a coherent state.
+  True for the iterators known to walk an array: pointers and the iterators 
+  of std::vector (except std::vector<bool>). Matrix3D::fill() copies the 
+  sequences they identify with a single memmove when the cells are trivially 
+  copyable and of the same type.
+*/
+template <typename Iter, typename V = typename std::iterator_traits<Iter>::value_type>
+struct matrix3d_contiguous_iterator : std::integral_constant<bool, std::is_pointer<Iter>::value || 
+	(!std::is_same<V, bool>::value && (std::is_same<Iter, typename std::vector<V>::iterator>::value || 
+		std::is_same<Iter, typename std::vector<V>::const_iterator>::value))> {};
 
-    	@post _matrix == nullptr
-	    @post _floors == 0
-	    @post _rows == 0
-	    @post _column == 0
-    */
+/**
+  @brief Uninitialized tag
 
-	void clear() {
-		delete[] _matrix;
-        _matrix = nullptr;
-        _rows = 0;
-        _columns = 0;
-        _floors = 0;
-    }
+  Selects the Matrix3D constructor which allocates the array of cells 
+  without giving them a value, for arrays that are going to be overwritten 
+  anyway: trivial cells are left indeterminate (no write at all), the others 
+  are default constructed, since they must be objects to be assigned and destroyed.
+*/
+struct uninitialized_t {
+	explicit uninitialized_t() = default;
+};
 
-    /**
-	    @brief Destructor
+inline constexpr uninitialized_t uninitialized{};
 
-	    Class destructor. The destructor must remove all resources used 
-	    by the class. In this case the heap-allocated array must be deallocated 
-	    and the other data members must be returned to a coherent state.
+/**
+  @brief Plain construction trait
 
-	    @post _matrix == nullptr
-	    @post _floors == 0
-	    @post _rows == 0
-	    @post _column == 0
-	*/
-    ~Matrix3D() {
-        clear();
-    }
+  True if the allocator constructs the cells with placement new, i.e. it is 
+  std::allocator or has no construct member: the cells can then be 
+  initialized in bulk (memset, memcpy, std::uninitialized_fill) instead of 
+  one by one through std::allocator_traits.
+*/
+template <typename Alloc, typename T, typename = void>
+struct matrix3d_plain_construct : std::true_type {};
 
-	/**
-	    @brief Getter/Setter of the (z, y, x)-th cell
+template <typename Alloc, typename T>
+struct matrix3d_plain_construct<Alloc, T, std::void_t<decltype(std::declval<Alloc &>().construct(std::declval<T *>(), std::declval<const T &>()))>> : 
+	std::is_same<Alloc, std::allocator<T>> {};
 
-	    Method that allows to read and/or write the (z, y, x)-th cell of the matrix.
+/**
+  @brief Adopt buffer tag
 
-	    @param z floor index of the 3D matrix in which the cell is located
-	    @param y row index of the 3D matrix where the cell is located
-	    @param x column index of the 3D matrix where the cell is located
+  Selects the Matrix3D constructor which takes ownership of an array 
+  of cells already allocated and constructed, instead of allocating its own.
+*/
+struct adopt_buffer_t {
+	explicit adopt_buffer_t() = default;
+};
 
-	    @return reference to the (z, y, x)-th cell of the 3D matrix
+inline constexpr adopt_buffer_t adopt_buffer{};
 
-	    @pre z < _floors && y < _rows && x < _columns
-	*/
-    T& operator()(int z, int y, int x) {
-    	assert(z >= 0 && y >= 0 && x >= 0);
-    	assert(z < _floors && y < _rows && x < _columns);
-    	return _matrix[(z * _rows * _columns) + (y * _columns) + x];
-    }
+/**
+  @brief Coordinates of a cell
 
-    /**
-	    @brief Getter of the (z, y, x)-th cell
+  Triple of indexes (z, y, x) identifying a cell of a 3D matrix, 
+  returned by the functions which locate a cell, like mismatch().
+*/
+struct Matrix3DIndex
+{
+	std::size_t z; ///< floor index
+	std::size_t y; ///< row index
+	std::size_t x; ///< column index
 
-	    Method which allows to read the (z, y, x)-th cell of the matrix.
+	bool operator==(const Matrix3DIndex &other) const {
+		return z == other.z && y == other.y && x == other.x;
+	}
 
-	    @param z floor index of the 3D matrix in which the cell is located
-	    @param y row index of the 3D matrix where the cell is located
-	    @param x column index of the 3D matrix where the cell is located
+	bool operator!=(const Matrix3DIndex &other) const {
+		return !(*this == other);
+	}
+};
 
-	    @return reference alla cella (z, y, x)-esima della matrice 3D
+/**
+  @brief Row-major layout
 
-	    @pre z < _floors && y < _rows && x < _columns
-	*/
-    const T& operator()(int z, int y, int x) const {
-    	assert(z >= 0 && y >= 0 && x >= 0);
-    	assert(z < _floors && y < _rows && x < _columns);
-    	return _matrix[(z * _rows * _columns) + (y * _columns) + x];
-    }
+  Layout policy of Matrix3D storing the cells floor after floor, each 
+  floor row after row: the columns of a row are contiguous, the rows of 
+  a floor are columns cells apart, and the floors rows*columns cells apart.
 
-    /**
-    @brief slice method
+  A layout policy maps the coordinates of a cell of a matrix with the given 
+  dimensions to its offset in the array (offset) and back (index), gives 
+  the coordinates of the cell following a given one in the array (next), 
+  and tells whether it is this row-major layout (is_row_major), which the 
+  strided views and some fast paths rely on.
+*/
+struct row_major_layout {
 
-	    Method that returns a sub-Matrix3D containing the values in the coordinate 
-	    intervals z1-z2, y1-y2 and x1-x2.
+	static const bool is_row_major = true;
 
-	    @param z1 floor index from which to start the slicing of the original 3D matrix
-	    @param y1 row index from which to start the slicing of the original 3D matrix
-	    @param x1 column index from which to start the slicing of the original 3D matrix
-	    @param z2 floor index from which to end the slicing of the original 3D matrix
-	    @param y2 row index from which to end the slicing of the original 3D matrix
-	    @param x2 column index from which to end the slicing of the original 3D matrix
+	static std::size_t offset(std::size_t z, std::size_t y, std::size_t x, std::size_t, std::size_t rows, std::size_t columns) {
+		return (((z * rows) + y) * columns) + x;
+	}
 
-	    @return sub-Matrix3D containing the values in the specified ranges
+	static Matrix3DIndex index(std::size_t offset, std::size_t, std::size_t rows, std::size_t columns) {
+		Matrix3DIndex i;
+		i.z = offset / (rows * columns);
+		i.y = (offset / columns) % rows;
+		i.x = offset % columns;
+		return i;
+	}
 
-	    @pre z1 < _floors && z2 < _floors && y1 < _rows && y2 < _rows && x1 < _columns && x2 < _columns
-	*/
-    Matrix3D slice(int z1, int z2, int y1, int y2, int x1, int x2) const {
+	static void next(Matrix3DIndex &i, std::size_t, std::size_t rows, std::size_t columns) {
+		if(++i.x < columns)
+			return;
+		i.x = 0;
+		if(++i.y < rows)
+			return;
+		i.y = 0;
+		++i.z;
+	}
+};
 
-    	assert(z1 >= 0 && z2 >= 0 && y1 >= 0 && y2 >= 0 && x1 >= 0 && x2 >= 0);
-    	assert(z1 < _floors && z2 < _floors && y1 < _rows && y2 < _rows && x1 < _columns && x2 < _columns);
-    	assert(z2 >= z1 && y2 >= y1 && x2 >= x1);
+/**
+  @brief Bricked layout
+
+  Layout policy of Matrix3D storing the cells in bricks of BrickFloors x 
+  BrickRows x BrickColumns cells, each one row-major and contiguous, the 
+  bricks being stored in row-major order of their coordinates. The cells 
+  which are close in any direction (and so the neighbours along z) are 
+  close in memory, usually in the same few cache lines and pages, while 
+  with the row-major layout two neighbours along z are a whole floor apart.
+  The bricks on the far edges of the matrix are smaller, so there is no 
+  padding and the array has exactly floors*rows*columns cells: the iterators 
+  of the matrix walk it brick after brick.
+*/
+template <std::size_t BrickFloors = 8, std::size_t BrickRows = 8, std::size_t BrickColumns = 8>
+struct bricked_layout {
+
+	static_assert(BrickFloors > 0 && BrickRows > 0 && BrickColumns > 0, "the bricks must not be empty");
+
+	static const bool is_row_major = false;
+
+	static std::size_t offset(std::size_t z, std::size_t y, std::size_t x, std::size_t floors, std::size_t rows, std::size_t columns) {
+		const std::size_t z0 = z - z % BrickFloors, y0 = y - y % BrickRows, x0 = x - x % BrickColumns;
+		if(z0 + BrickFloors <= floors && y0 + BrickRows <= rows && x0 + BrickColumns <= columns) // whole brick
+			return z0 * rows * columns + BrickFloors * (y0 * columns + BrickRows * x0) + 
+				((z - z0) * BrickRows + (y - y0)) * BrickColumns + (x - x0);
+		const std::size_t floors_in_brick = std::min(BrickFloors, floors - z0);
+		const std::size_t rows_in_brick = std::min(BrickRows, rows - y0);
+		const std::size_t columns_in_brick = std::min(BrickColumns, columns - x0);
+		return z0 * rows * columns + floors_in_brick * (y0 * columns + rows_in_brick * x0) + 
+			((z - z0) * rows_in_brick + (y - y0)) * columns_in_brick + (x - x0);
+	}
 
-    	Matrix3D sliced_matrix(z2-z1+1, y2-y1+1, x2-x1+1);
+	static Matrix3DIndex index(std::size_t offset, std::size_t floors, std::size_t rows, std::size_t columns) {
+		const std::size_t z0 = offset / (BrickFloors * rows * columns) * BrickFloors;
+		offset -= z0 * rows * columns;
+		const std::size_t floors_in_brick = std::min(BrickFloors, floors - z0);
 
-    	for(unsigned int z = z1; z <= z2; ++z) 
-        	for(unsigned int y = y1; y <= y2; ++y) 
-        		for(unsigned int x = x1; x <= x2; ++x) 
-        			sliced_matrix((z - z1), (y - y1), (x - x1)) = (*this)(z, y, x);
+		const std::size_t y0 = offset / (floors_in_brick * BrickRows * columns) * BrickRows;
+		offset -= floors_in_brick * y0 * columns;
+		const std::size_t rows_in_brick = std::min(BrickRows, rows - y0);
 
-        return sliced_matrix;
+		const std::size_t x0 = offset / (floors_in_brick * rows_in_brick * BrickColumns) * BrickColumns;
+		offset -= floors_in_brick * rows_in_brick * x0;
+		const std::size_t columns_in_brick = std::min(BrickColumns, columns - x0);
 
-    }
+		Matrix3DIndex i;
+		i.z = z0 + offset / (rows_in_brick * columns_in_brick);
+		i.y = y0 + (offset / columns_in_brick) % rows_in_brick;
+		i.x = x0 + offset % columns_in_brick;
+		return i;
+	}
+
+	static void next(Matrix3DIndex &i, std::size_t floors, std::size_t rows, std::size_t columns) {
+		const std::size_t z0 = i.z - i.z % BrickFloors, y0 = i.y - i.y % BrickRows, x0 = i.x - i.x % BrickColumns;
+
+		// inside the brick
+		if(++i.x < std::min(x0 + BrickColumns, columns))
+			return;
+		i.x = x0;
+		if(++i.y < std::min(y0 + BrickRows, rows))
+			return;
+		i.y = y0;
+		if(++i.z < std::min(z0 + BrickFloors, floors))
+			return;
+
+		// first cell of the next brick
+		i.z = z0;
+		if((i.x = x0 + BrickColumns) < columns)
+			return;
+		i.x = 0;
+		if((i.y = y0 + BrickRows) < rows)
+			return;
+		i.y = 0;
+		i.z = z0 + BrickFloors;
+	}
+};
+
+/**
+  @brief Morton codes
+
+  Interleaving of the bits of the coordinates of a cell (up to 10 bits 
+  each), giving its position along the Morton (Z-order) curve: bit i of x 
+  becomes bit 3i of the code, bit i of y bit 3i+1 and bit i of z bit 3i+2.
+  Uses the BMI2 instructions pdep and pext when the compiler targets them, 
+  the usual shift-and-mask sequences otherwise.
+*/
+struct morton_code {
+
+	static const std::uint32_t x_mask = 0x09249249; ///< bits of the code holding x
+
+#if defined(__BMI2__)
+	static std::uint32_t encode(std::uint32_t z, std::uint32_t y, std::uint32_t x) {
+		return _pdep_u32(x, x_mask) | _pdep_u32(y, x_mask << 1) | _pdep_u32(z, x_mask << 2);
+	}
+
+	static void decode(std::uint32_t code, std::uint32_t &z, std::uint32_t &y, std::uint32_t &x) {
+		x = _pext_u32(code, x_mask);
+		y = _pext_u32(code, x_mask << 1);
+		z = _pext_u32(code, x_mask << 2);
+	}
+#else
+	static std::uint32_t encode(std::uint32_t z, std::uint32_t y, std::uint32_t x) {
+		return _spread(x) | (_spread(y) << 1) | (_spread(z) << 2);
+	}
+
+	static void decode(std::uint32_t code, std::uint32_t &z, std::uint32_t &y, std::uint32_t &x) {
+		x = _compact(code);
+		y = _compact(code >> 1);
+		z = _compact(code >> 2);
+	}
+
+private:
+
+	// Moves bit i of v to bit 3i
+	static std::uint32_t _spread(std::uint32_t v) {
+		v &= 0x000003ff;
+		v = (v | (v << 16)) & 0x030000ff;
+		v = (v | (v << 8)) & 0x0300f00f;
+		v = (v | (v << 4)) & 0x030c30c3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	// Moves bit 3i of v to bit i
+	static std::uint32_t _compact(std::uint32_t v) {
+		v &= 0x09249249;
+		v = (v | (v >> 2)) & 0x030c30c3;
+		v = (v | (v >> 4)) & 0x0300f00f;
+		v = (v | (v >> 8)) & 0x030000ff;
+		v = (v | (v >> 16)) & 0x000003ff;
+		return v;
+	}
+#endif
+};
+
+/**
+  @brief Morton layout
+
+  Layout policy of Matrix3D storing the cells in cubic bricks of 2^BrickBits 
+  cells per side, in row-major order of the bricks like bricked_layout, but 
+  with the cells of each brick in Morton (Z-order) order: the cells of any 
+  2x2x2, 4x4x4, ... aligned cube inside a brick are contiguous, so lookups 
+  clustered in a small 3D neighbourhood touch few cache lines, whatever the 
+  direction. Encoding and decoding use morton_code.
+  The bricks on the far edges of the matrix are smaller and row-major, as 
+  with bricked_layout, so there is no padding and the array has exactly 
+  floors*rows*columns cells: the iterators walk the whole bricks in Z-order.
+*/
+template <unsigned int BrickBits = 5>
+struct morton_layout {
+
+	static_assert(BrickBits > 0 && BrickBits <= 10, "the bricks must have between 2 and 1024 cells per side");
+
+	static const bool is_row_major = false;
+
+	static const std::size_t brick_side = std::size_t(1) << BrickBits; ///< cells per side of a brick
+
+	static std::size_t offset(std::size_t z, std::size_t y, std::size_t x, std::size_t floors, std::size_t rows, std::size_t columns) {
+		const std::size_t z0 = z & ~(brick_side - 1), y0 = y & ~(brick_side - 1), x0 = x & ~(brick_side - 1);
+		if(z0 + brick_side <= floors && y0 + brick_side <= rows && x0 + brick_side <= columns) // whole brick
+			return z0 * rows * columns + brick_side * (y0 * columns + brick_side * x0) + 
+				morton_code::encode(std::uint32_t(z - z0), std::uint32_t(y - y0), std::uint32_t(x - x0));
+		return bricked_layout<brick_side, brick_side, brick_side>::offset(z, y, x, floors, rows, columns);
+	}
+
+	static Matrix3DIndex index(std::size_t offset, std::size_t floors, std::size_t rows, std::size_t columns) {
+		Matrix3DIndex i = bricked_layout<brick_side, brick_side, brick_side>::index(offset, floors, rows, columns);
+		const std::size_t z0 = i.z & ~(brick_side - 1), y0 = i.y & ~(brick_side - 1), x0 = i.x & ~(brick_side - 1);
+		if(z0 + brick_side <= floors && y0 + brick_side <= rows && x0 + brick_side <= columns) { // whole brick
+			std::uint32_t z, y, x;
+			morton_code::decode(std::uint32_t(((i.z - z0) * brick_side + (i.y - y0)) * brick_side + (i.x - x0)), z, y, x);
+			i.z = z0 + z;
+			i.y = y0 + y;
+			i.x = x0 + x;
+		}
+		return i;
+	}
+
+	static void next(Matrix3DIndex &i, std::size_t floors, std::size_t rows, std::size_t columns) {
+		const std::size_t z0 = i.z & ~(brick_side - 1), y0 = i.y & ~(brick_side - 1), x0 = i.x & ~(brick_side - 1);
+		if(z0 + brick_side > floors || y0 + brick_side > rows || x0 + brick_side > columns) { // row-major edge brick
+			bricked_layout<brick_side, brick_side, brick_side>::next(i, floors, rows, columns);
+			return;
+		}
+
+		const std::uint32_t code = morton_code::encode(std::uint32_t(i.z - z0), std::uint32_t(i.y - y0), std::uint32_t(i.x - x0)) + 1;
+		if(code < brick_side * brick_side * brick_side) {
+			std::uint32_t z, y, x;
+			morton_code::decode(code, z, y, x);
+			i.z = z0 + z;
+			i.y = y0 + y;
+			i.x = x0 + x;
+			return;
+		}
+
+		// first cell of the next brick: the last cell of the brick is its far corner
+		i.z = z0 + brick_side - 1;
+		i.y = y0 + brick_side - 1;
+		i.x = x0 + brick_side - 1;
+		bricked_layout<brick_side, brick_side, brick_side>::next(i, floors, rows, columns);
+	}
+};
+
+/**
+  @brief Indexed iterator
+
+  Forward iterator walking the cells of a Matrix3D in the order of its 
+  array, like the plain iterators, but also keeping the coordinates of 
+  the current cell, which are updated incrementally through the layout 
+  (so walking a bricked matrix goes brick by brick, without divisions).
+  Returned by Matrix3D::indexed_begin() and Matrix3D::indexed_end().
+*/
+template <typename T, typename Layout>
+class Matrix3DIndexedIterator {
+
+	T *_cell; ///< current cell
+	Matrix3DIndex _index; ///< coordinates of the current cell
+	std::size_t _floors; ///< number of floors of the matrix
+	std::size_t _rows; ///< number of rows of the matrix
+	std::size_t _columns; ///< number of columns of the matrix
+
+	template <typename U, typename M> friend class Matrix3DIndexedIterator;
+
+public:
+
+	typedef std::forward_iterator_tag iterator_category;
+	typedef typename std::remove_const<T>::type value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef T *pointer;
+	typedef T &reference;
+
+	Matrix3DIndexedIterator() : _cell(nullptr), _index(), _floors(0), _rows(0), _columns(0) {}
+
+	Matrix3DIndexedIterator(T *cell, const Matrix3DIndex &index, std::size_t floors, std::size_t rows, std::size_t columns) : 
+		_cell(cell), _index(index), _floors(floors), _rows(rows), _columns(columns) {}
+
+	// Conversion from the iterator on non-const cells to the one on const cells
+	template <typename U, typename = typename std::enable_if<std::is_same<const U, T>::value && !std::is_same<U, T>::value>::type>
+	Matrix3DIndexedIterator(const Matrix3DIndexedIterator<U, Layout> &other) : 
+		_cell(&*other), _index(other.index()), _floors(other._floors), _rows(other._rows), _columns(other._columns) {}
+
+	reference operator*() const {
+		return *_cell;
+	}
+
+	pointer operator->() const {
+		return _cell;
+	}
+
+	// Return the coordinates of the current cell
+	const Matrix3DIndex &index() const {
+		return _index;
+	}
+
+	Matrix3DIndexedIterator &operator++() {
+		++_cell;
+		Layout::next(_index, _floors, _rows, _columns);
+		return *this;
+	}
+
+	Matrix3DIndexedIterator operator++(int) {
+		Matrix3DIndexedIterator tmp(*this);
+		++(*this);
+		return tmp;
+	}
+
+	bool operator==(const Matrix3DIndexedIterator &other) const {
+		return _cell == other._cell;
+	}
+
+	bool operator!=(const Matrix3DIndexedIterator &other) const {
+		return _cell != other._cell;
+	}
+};
+
+/**
+  @brief Common layout of the operands of an expression
+
+  The operands of an elementwise expression are combined cell by cell 
+  through their offsets, so all the matrixes in it must have the same 
+  layout; scalars (whose layout is void) fit any of them.
+*/
+template <typename A, typename B>
+struct matrix3d_common_layout {
+	static_assert(std::is_same<A, B>::value, "the matrixes of an expression must have the same layout");
+	typedef A type;
+};
+
+template <typename A>
+struct matrix3d_common_layout<void, A> {
+	typedef A type;
+};
+
+template <typename A>
+struct matrix3d_common_layout<A, void> {
+	typedef A type;
+};
+
+template <>
+struct matrix3d_common_layout<void, void> {
+	typedef void type;
+};
+
+/**
+  @brief Bytewise equality trait
+
+  True for the types whose == is known to compare the whole object 
+  representation: integral, enum and pointer types. A class type without 
+  padding whose == compares every member can opt in by specializing it 
+  (template <> struct matrix3d_bytewise_equality<S> : std::true_type {};); 
+  the others are never assumed bytewise, since their == may ignore a member.
+*/
+template <typename T>
+struct matrix3d_bytewise_equality : std::integral_constant<bool, 
+	std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value> {};
+
+/**
+  @brief Bitwise comparability trait
+
+  True when two cells of type T compared through the functor F are equal 
+  if and only if their object representations are equal, so that whole 
+  arrays of them can be compared as raw bytes. This is the case of the 
+  default functor on the types with bytewise equality (see 
+  matrix3d_bytewise_equality) and without padding bits nor multiple 
+  representations of the same value, but not on floating point types, 
+  for which +0.0 == -0.0 and NaN != NaN.
+*/
+template <typename T, typename F>
+struct is_bitwise_comparable : std::integral_constant<bool, 
+	std::is_same<F, default_functor<T>>::value && matrix3d_bytewise_equality<T>::value && 
+	std::has_unique_object_representations<T>::value> {};
+
+/**
+  @brief First different byte of two buffers
+
+  Compares two buffers of the same size in chunks of 64 bytes through 
+  SIMD byte comparisons (AVX2 or SSE2, whichever the target supports, 
+  with a plain byte loop as fallback), returning as soon as a chunk differs.
+
+  @param a first buffer
+  @param b second buffer
+  @param bytes size in bytes of both buffers
+
+  @return offset of the first byte at which the buffers differ, bytes if they are equal
+*/
+inline std::size_t first_different_byte(const void *a, const void *b, std::size_t bytes) {
+
+	const unsigned char *pa = static_cast<const unsigned char*>(a);
+	const unsigned char *pb = static_cast<const unsigned char*>(b);
+
+	std::size_t i = 0;
+
+#if defined(__AVX2__)
+	for(; i + 64 <= bytes; i += 64) {
+		const unsigned int low = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pa + i)), 
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pb + i)))));
+		const unsigned int high = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pa + i + 32)), 
+			_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pb + i + 32)))));
+		if((low & high) != 0xFFFFFFFFu) {
+			if(low != 0xFFFFFFFFu)
+				return i + __builtin_ctz(~low);
+			return i + 32 + __builtin_ctz(~high);
+		}
+	}
+#elif defined(__SSE2__)
+	for(; i + 64 <= bytes; i += 64) {
+		unsigned int equal[4];
+		for(int k = 0; k < 4; ++k)
+			equal[k] = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(pa + i + 16 * k)), 
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + i + 16 * k)))));
+		if((equal[0] & equal[1] & equal[2] & equal[3]) != 0xFFFFu)
+			for(int k = 0; k < 4; ++k)
+				if(equal[k] != 0xFFFFu)
+					return i + 16 * k + __builtin_ctz(~equal[k]);
+	}
+#endif
+
+	for(; i < bytes; ++i)
+		if(pa[i] != pb[i])
+			return i;
+
+	return bytes;
+}
+
+/**
+  @brief Byte hashing trait
+
+  True when the content hash of the cells of type T can be computed on
+  their raw bytes: for the types compared as raw bytes by the default 
+  functor (see is_bitwise_comparable), and for float and double, whose 
+  -0.0 is turned into +0.0 before hashing, since the two compare equal. 
+  The other class types go through std::hash<T>, since their == may 
+  ignore some of their bytes.
+*/
+template <typename T>
+struct matrix3d_hash_as_bytes : std::integral_constant<bool,
+	is_bitwise_comparable<T, default_functor<T>>::value || std::is_same<T, float>::value || std::is_same<T, double>::value> {};
+
+/**
+  @brief Hashability trait
+
+  True when the content hash of a Matrix3D<T> (see Matrix3D::hash) can be
+  computed: the cells are hashed as raw bytes (see matrix3d_hash_as_bytes)
+  or through std::hash<T>, when it is enabled.
+*/
+template <typename T>
+struct matrix3d_hashable : std::integral_constant<bool,
+	matrix3d_hash_as_bytes<T>::value || std::is_default_constructible<std::hash<T>>::value> {};
+
+/**
+  @brief Hash consistency trait
+
+  True when two Matrix3D<T, F> which compare equal always have the same
+  content hash, that is when F is the default functor (hence the == of T,
+  which std::hash<T> agrees with) and T is hashable. Only then different
+  hashes prove that two matrixes differ.
+*/
+template <typename T, typename F>
+struct matrix3d_hash_consistent : std::integral_constant<bool,
+	std::is_same<F, default_functor<T>>::value && matrix3d_hashable<T>::value> {};
+
+/**
+  @brief Content hasher
+
+  Streaming 64-bit hash in the style of xxHash (XXH3): the input is cut in
+  stripes of 64 bytes, whose 8 words are accumulated in 8 independent lanes,
+  each with a 32x32 -> 64 bit multiplication of the word mixed with a key;
+  the lanes are scrambled every 16 stripes and folded together at the end.
+  The lanes are processed 4 or 2 at a time with AVX2 or SSE2 instructions,
+  whichever the target supports, with the same result as the scalar fallback.
+  It detects accidental differences between contents, it is not a
+  cryptographic hash.
+*/
+class matrix3d_hasher {
+
+	static constexpr std::uint64_t _prime32_1 = 0x9E3779B1ULL;
+	static constexpr std::uint64_t _prime32_2 = 0x85EBCA77ULL;
+	static constexpr std::uint64_t _prime32_3 = 0xC2B2AE3DULL;
+	static constexpr std::uint64_t _prime64_1 = 0x9E3779B185EBCA87ULL;
+	static constexpr std::uint64_t _prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+	static constexpr std::uint64_t _prime64_3 = 0x165667B19E3779F9ULL;
+	static constexpr std::uint64_t _prime64_4 = 0x85EBCA77C2B2AE63ULL;
+	static constexpr std::uint64_t _prime64_5 = 0x27D4EB2F165667C5ULL;
+
+	static constexpr std::size_t _stripe = 64; ///< bytes accumulated at each step
+	static constexpr std::size_t _block = 16; ///< stripes between two scrambles
+
+	std::uint64_t _acc[8]; ///< accumulators of the lanes
+	std::uint64_t _keys[8]; ///< keys of the lanes, derived from the seed
+	unsigned char _pending[_stripe]; ///< bytes of the incomplete stripe
+	std::size_t _buffered; ///< bytes in _pending
+	std::size_t _stripes; ///< stripes accumulated since the last scramble
+	std::uint64_t _bytes; ///< bytes hashed
+	std::uint64_t _seed; ///< seed of the hash
+
+	// Accumulates n stripes starting at p in the lanes
+	static void _accumulate(std::uint64_t *acc, const std::uint64_t *keys, const unsigned char *p, std::size_t n) {
+#if defined(__AVX2__)
+		__m256i a[2];
+		for(int v = 0; v < 2; ++v)
+			a[v] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + 4 * v));
+		for(std::size_t s = 0; s < n; ++s, p += _stripe)
+			for(int v = 0; v < 2; ++v) {
+				const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * v));
+				const __m256i key = _mm256_xor_si256(data, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + 4 * v)));
+				const __m256i product = _mm256_mul_epu32(key, _mm256_srli_epi64(key, 32));
+				a[v] = _mm256_add_epi64(a[v], _mm256_add_epi64(product, _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2))));
+			}
+		for(int v = 0; v < 2; ++v)
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + 4 * v), a[v]);
+#elif defined(__SSE2__)
+		__m128i a[4];
+		for(int v = 0; v < 4; ++v)
+			a[v] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + 2 * v));
+		for(std::size_t s = 0; s < n; ++s, p += _stripe)
+			for(int v = 0; v < 4; ++v) {
+				const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * v));
+				const __m128i key = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + 2 * v)));
+				const __m128i product = _mm_mul_epu32(key, _mm_srli_epi64(key, 32));
+				a[v] = _mm_add_epi64(a[v], _mm_add_epi64(product, _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2))));
+			}
+		for(int v = 0; v < 4; ++v)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(acc + 2 * v), a[v]);
+#else
+		for(std::size_t s = 0; s < n; ++s, p += _stripe)
+			for(int j = 0; j < 8; ++j) {
+				std::uint64_t data;
+				std::memcpy(&data, p + 8 * j, sizeof(data));
+				const std::uint64_t key = data ^ keys[j];
+				acc[j ^ 1] += data;
+				acc[j] += (key & 0xFFFFFFFFULL) * (key >> 32);
+			}
+#endif
+	}
+
+	// Scrambles the lanes, so that the bits of the accumulators spread
+	static void _scramble(std::uint64_t *acc, const std::uint64_t *keys) {
+		for(int j = 0; j < 8; ++j) {
+			acc[j] ^= acc[j] >> 47;
+			acc[j] ^= keys[j];
+			acc[j] *= _prime32_1;
+		}
+	}
+
+	// Accumulates n stripes starting at p, scrambling the lanes every _block stripes
+	void _consume(const unsigned char *p, std::size_t n) {
+		while(n > 0) {
+			const std::size_t step = std::min(n, _block - _stripes);
+			_accumulate(_acc, _keys, p, step);
+			_stripes += step;
+			if(_stripes == _block) {
+				_scramble(_acc, _keys);
+				_stripes = 0;
+			}
+			p += step * _stripe;
+			n -= step;
+		}
+	}
+
+	// Folds two lanes through their 128 bit product, computed from the 32 bit halves
+	static std::uint64_t _fold(std::uint64_t a, std::uint64_t b) {
+		const std::uint64_t lo_lo = (a & 0xFFFFFFFFULL) * (b & 0xFFFFFFFFULL);
+		const std::uint64_t hi_lo = (a >> 32) * (b & 0xFFFFFFFFULL);
+		const std::uint64_t lo_hi = (a & 0xFFFFFFFFULL) * (b >> 32);
+		const std::uint64_t hi_hi = (a >> 32) * (b >> 32);
+		const std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFFULL) + lo_hi;
+		const std::uint64_t high = hi_hi + (hi_lo >> 32) + (cross >> 32);
+		const std::uint64_t low = (cross << 32) | (lo_lo & 0xFFFFFFFFULL);
+		return low ^ high;
+	}
+
+public:
+
+	explicit matrix3d_hasher(std::uint64_t seed = 0) :
+		_acc{_prime32_3, _prime64_1, _prime64_2, _prime64_3, _prime64_4, _prime32_2, _prime64_5, _prime32_1},
+		_keys{_prime64_1 + seed, _prime64_2 - seed, _prime64_3 + seed, _prime64_4 - seed,
+			_prime64_5 + seed, (_prime64_1 ^ _prime64_3) - seed, (_prime64_2 ^ _prime64_4) + seed, (_prime64_3 ^ _prime64_5) - seed},
+		_buffered(0), _stripes(0), _bytes(0), _seed(seed) {}
+
+	// Adds bytes of data to the hashed content
+	void update(const void *data, std::size_t bytes) {
+		const unsigned char *p = static_cast<const unsigned char*>(data);
+		_bytes += bytes;
+		if(_buffered != 0) {
+			const std::size_t take = std::min(_stripe - _buffered, bytes);
+			std::memcpy(_pending + _buffered, p, take);
+			_buffered += take;
+			p += take;
+			bytes -= take;
+			if(_buffered < _stripe)
+				return;
+			_consume(_pending, 1);
+			_buffered = 0;
+		}
+		const std::size_t stripes = bytes / _stripe;
+		_consume(p, stripes);
+		p += stripes * _stripe;
+		bytes -= stripes * _stripe;
+		if(bytes != 0)
+			std::memcpy(_pending, p, bytes);
+		_buffered = bytes;
+	}
+
+	// Return the hash of the content added so far
+	std::uint64_t digest() const {
+		std::uint64_t acc[8];
+		std::memcpy(acc, _acc, sizeof(acc));
+		if(_buffered != 0) {
+			// the last stripe is padded with zeros, the length tells it apart
+			unsigned char last[_stripe] = {};
+			std::memcpy(last, _pending, _buffered);
+			_accumulate(acc, _keys, last, 1);
+		}
+		std::uint64_t h = _bytes * _prime64_1 + _seed;
+		for(int j = 0; j < 8; j += 2)
+			h += _fold(acc[j] ^ _keys[j], acc[j + 1] ^ _keys[j + 1]);
+		h ^= h >> 37;
+		h *= 0x165667919E3779F9ULL;
+		h ^= h >> 32;
+		return h;
+	}
+};
+
+/**
+  @brief Aligned allocator
+
+  Standard-compliant allocator returning memory aligned to Alignment bytes 
+  (by default a cache line, which is also the widest SIMD register), 
+  so that the first cell of every Matrix3D using it starts on a cache line 
+  boundary and vectorized loops over the array never split their loads.
+*/
+template <typename T, std::size_t Alignment = 64>
+struct aligned_allocator
+{
+	static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0, "Alignment must be a power of 2 not smaller than alignof(T)");
+
+	typedef T value_type;
+	typedef std::true_type is_always_equal;
+
+	template <typename U>
+	struct rebind {
+		typedef aligned_allocator<U, Alignment> other;
+	};
+
+	aligned_allocator() noexcept {}
+
+	template <typename U>
+	aligned_allocator(const aligned_allocator<U, Alignment> &) noexcept {}
+
+	T *allocate(std::size_t n) {
+		if(n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+			throw std::bad_array_new_length();
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+	}
+
+	void deallocate(T *p, std::size_t) noexcept {
+		::operator delete(p, std::align_val_t(Alignment));
+	}
+
+	template <typename U>
+	bool operator==(const aligned_allocator<U, Alignment> &) const noexcept {
+		return true;
+	}
+
+	template <typename U>
+	bool operator!=(const aligned_allocator<U, Alignment> &) const noexcept {
+		return false;
+	}
+};
+
+/**
+  @brief Pool of recyclable buffers
+
+  Thread-safe pool of memory buffers, grouped by their exact size in bytes.
+  A buffer given back to the pool is not returned to the system, but kept 
+  in the free list of its size, and handed out again to the next request 
+  of the same size: a pipeline creating many temporaries with the same shape 
+  ends up allocating their arrays only once.
+  The buffers are aligned to 64 bytes. At most max_cached_bytes are kept 
+  idle in the pool, buffers exceeding this budget are freed immediately.
+*/
+class matrix_pool {
+
+	std::unordered_map<std::size_t, std::vector<void*>> _free; ///< idle buffers, by size in bytes
+	std::size_t _cached_bytes; ///< total size of the idle buffers
+	std::size_t _max_cached_bytes; ///< maximum total size of the idle buffers
+	std::size_t _hits; ///< number of requests served with a recycled buffer
+	std::size_t _misses; ///< number of requests which needed a new buffer
+	mutable std::mutex _mutex; ///< mutex protecting the free lists and the statistics
+
+	static const std::size_t _alignment = 64;
+
+public:
+
+	explicit matrix_pool(std::size_t max_cached_bytes = std::numeric_limits<std::size_t>::max()) :
+		_cached_bytes(0), _max_cached_bytes(max_cached_bytes), _hits(0), _misses(0) {}
+
+	matrix_pool(const matrix_pool &) = delete;
+	matrix_pool &operator=(const matrix_pool &) = delete;
+
+	~matrix_pool() {
+		release();
+	}
+
+	/**
+	    @brief Buffer request
+
+	    Returns a buffer of the given size, recycling an idle one of 
+	    the same size if there is any.
+
+	    @param bytes size of the buffer in bytes
+
+	    @return pointer to the buffer
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	void *allocate(std::size_t bytes) {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::unordered_map<std::size_t, std::vector<void*>>::iterator bucket = _free.find(bytes);
+			if(bucket != _free.end() && !bucket->second.empty()) {
+				void *p = bucket->second.back();
+				bucket->second.pop_back();
+				_cached_bytes -= bytes;
+				++_hits;
+				return p;
+			}
+			++_misses;
+		}
+		return ::operator new(bytes, std::align_val_t(_alignment));
+	}
+
+	/**
+	    @brief Buffer release
+
+	    Gives a buffer back to the pool, which keeps it for the next request 
+	    of the same size, unless the budget of idle memory would be exceeded.
+
+	    @param p pointer to the buffer
+	    @param bytes size of the buffer in bytes, as passed to allocate()
+	*/
+	void deallocate(void *p, std::size_t bytes) noexcept {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if(_cached_bytes + bytes <= _max_cached_bytes) {
+				try {
+					_free[bytes].push_back(p);
+					_cached_bytes += bytes;
+					return;
+				}
+				catch(...) {} // no room to remember it, free it
+			}
+		}
+		::operator delete(p, std::align_val_t(_alignment));
+	}
+
+	// Frees all the idle buffers
+	void release() noexcept {
+		std::lock_guard<std::mutex> lock(_mutex);
+		for(std::unordered_map<std::size_t, std::vector<void*>>::iterator i = _free.begin(); i != _free.end(); ++i)
+			for(std::size_t j = 0; j < i->second.size(); ++j)
+				::operator delete(i->second[j], std::align_val_t(_alignment));
+		_free.clear();
+		_cached_bytes = 0;
+	}
+
+	// Return the total size of the idle buffers
+	std::size_t cached_bytes() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _cached_bytes;
+	}
+
+	// Return the number of requests served with a recycled buffer
+	std::size_t hits() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _hits;
+	}
+
+	// Return the number of requests which needed a new buffer
+	std::size_t misses() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _misses;
+	}
+
+	// Return the pool used by default by pool_allocator
+	static matrix_pool &global() {
+		static matrix_pool pool;
+		return pool;
+	}
+};
+
+/**
+  @brief Pool allocator
+
+  Standard-compliant allocator drawing its memory from a matrix_pool 
+  (by default the global one), so that freed arrays are recycled by the 
+  next Matrix3D of the same shape instead of going back to the system.
+  The pool is propagated on copy, move and swap, and two allocators are 
+  equal if they use the same pool.
+*/
+template <typename T>
+class pool_allocator {
+
+	template <typename U>
+	friend class pool_allocator;
+
+	matrix_pool *_pool; ///< pool from which the memory is taken
+
+public:
+
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+	typedef std::false_type is_always_equal;
+
+	pool_allocator() noexcept : _pool(&matrix_pool::global()) {}
+
+	explicit pool_allocator(matrix_pool &pool) noexcept : _pool(&pool) {}
+
+	template <typename U>
+	pool_allocator(const pool_allocator<U> &other) noexcept : _pool(other._pool) {}
+
+	T *allocate(std::size_t n) {
+		if(n > std::numeric_limits<std::size_t>::max() / sizeof(T))
+			throw std::bad_array_new_length();
+		return static_cast<T*>(_pool->allocate(n * sizeof(T)));
+	}
+
+	void deallocate(T *p, std::size_t n) noexcept {
+		_pool->deallocate(p, n * sizeof(T));
+	}
+
+	// Return the pool from which the memory is taken
+	matrix_pool &pool() const noexcept {
+		return *_pool;
+	}
+
+	template <typename U>
+	bool operator==(const pool_allocator<U> &other) const noexcept {
+		return _pool == other._pool;
+	}
+
+	template <typename U>
+	bool operator!=(const pool_allocator<U> &other) const noexcept {
+		return _pool != other._pool;
+	}
+};
+
+template <typename T>
+class Matrix3DView;
+
+/**
+  @brief Expression trait
+
+  True for the nodes of the elementwise expressions built by the arithmetic 
+  operators on Matrix3D (see Matrix3DBinaryExpression), which a Matrix3D 
+  can be constructed from or assigned.
+*/
+template <typename E>
+struct is_matrix3d_expression : std::false_type {};
+
+template <typename X, typename = void>
+struct matrix3d_operand;
+
+template <typename T, typename F = default_functor<T>, typename Alloc = std::allocator<T>, typename Layout = row_major_layout>
+class Matrix3D {
+
+	template <typename U, typename Q, typename B, typename M>
+	friend class Matrix3D;
+
+	typedef std::allocator_traits<Alloc> alloc_traits;
+
+	T* _matrix; ///< pointer to the first cell of the 3D array
+
+public:
+
+	typedef std::size_t size_type; ///< type of the dimensions and of the indexes of the cells
+	typedef std::ptrdiff_t difference_type; ///< type of the distance between two cells
+	typedef Alloc allocator_type; ///< type of the allocator of the array
+	typedef T value_type; ///< type of the data in the cells
+	typedef Layout layout_type; ///< layout of the cells in the array
+
+private:
+
+	size_type _floors; ///< number of floors of the 3D matrix
+	size_type _rows; ///< number of rows of the 3D matrix
+	size_type _columns; ///< number of columns of the 3D matrix
+
+	F _equals; //< functor used to check if two data of type T are equal
+
+	Alloc _alloc; ///< allocator used for the array of cells
+
+	static constexpr bool _plain_construct = matrix3d_plain_construct<Alloc, T>::value; ///< true if the cells can be initialized in bulk
+
+	/**
+	    @brief Allocation of the array of cells
+
+	    Allocates an array of n cells through the allocator, and constructs 
+	    each of them passing args. If a construction fails, the cells already 
+	    constructed are destroyed and the memory is given back to the allocator, 
+	    so that nothing leaks.
+	    With a plain allocator (see matrix3d_plain_construct) the cells are 
+	    value-initialized with a memset for arithmetic types, and filled with 
+	    std::uninitialized_fill_n (a memset for single-byte types) when a 
+	    value is given.
+
+	    @param n number of cells to allocate
+	    @param args arguments for the construction of each cell
+
+	    @return pointer to the first cell, nullptr if n == 0
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	template <typename... Args>
+	T *_allocate(size_type n, const Args &... args) {
+
+		if(n == 0)
+			return nullptr;
+
+		T *p = alloc_traits::allocate(_alloc, n);
+		matrix3d_instrumentation::count_allocation(n * sizeof(T));
+
+		if constexpr (_plain_construct && sizeof...(Args) == 0 && std::is_arithmetic<T>::value) {
+			std::memset(static_cast<void *>(p), 0, n * sizeof(T));
+			return p;
+		}
+		else if constexpr (_plain_construct && sizeof...(Args) == 1 && (std::is_same<Args, T>::value && ...)) {
+			try {
+				if constexpr (sizeof(T) == 1 && std::is_trivially_copyable<T>::value) {
+					unsigned char byte;
+					std::memcpy(&byte, &args..., 1);
+					std::memset(static_cast<void *>(p), byte, n);
+				}
+				else
+					std::uninitialized_fill_n(p, n, args...);
+			}
+			catch(...) {
+				_deallocate(p, 0, n);
+				throw;
+			}
+			return p;
+		}
+		else {
+			size_type i = 0;
+			try {
+				for(; i < n; ++i)
+					alloc_traits::construct(_alloc, p + i, args...);
+			}
+			catch(...) {
+				_deallocate(p, i, n);
+				throw;
+			}
+			return p;
+		}
+	}
+
+	/**
+	    @brief Allocation of an uninitialized array of cells
+
+	    Same as _allocate, but trivial cells are not written at all with a 
+	    plain allocator (see uninitialized_t): the caller must overwrite them.
+
+	    @param n number of cells to allocate
+
+	    @return pointer to the first cell, nullptr if n == 0
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	T *_allocate_uninitialized(size_type n) {
+
+		if constexpr (_plain_construct && std::is_trivial<T>::value) {
+			if(n == 0)
+				return nullptr;
+			T *p = alloc_traits::allocate(_alloc, n);
+			matrix3d_instrumentation::count_allocation(n * sizeof(T));
+			return p;
+		}
+		else
+			return _allocate(n);
+	}
+
+	/**
+	    @brief Allocation of a copy of an array of cells
+
+	    Same as _allocate, but the i-th cell is copy constructed from source[i]: 
+	    with a memcpy for trivially copyable cells and a plain allocator.
+
+	    @param source array of n cells to copy
+	    @param n number of cells to allocate
+
+	    @return pointer to the first cell, nullptr if n == 0
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	T *_allocate_copy(const T *source, size_type n) {
+
+		if(n == 0)
+			return nullptr;
+
+		T *p = alloc_traits::allocate(_alloc, n);
+		matrix3d_instrumentation::count_allocation(n * sizeof(T));
+
+		if constexpr (_plain_construct && std::is_trivially_copyable<T>::value) {
+			std::memcpy(static_cast<void *>(p), source, n * sizeof(T));
+		}
+		else if constexpr (_plain_construct) {
+			try {
+				std::uninitialized_copy_n(source, n, p);
+			}
+			catch(...) {
+				_deallocate(p, 0, n);
+				throw;
+			}
+		}
+		else {
+			size_type i = 0;
+			try {
+				for(; i < n; ++i)
+					alloc_traits::construct(_alloc, p + i, source[i]);
+			}
+			catch(...) {
+				_deallocate(p, i, n);
+				throw;
+			}
+		}
+
+		return p;
+	}
+
+	/**
+	    @brief Allocation of an array of cells computed from their coordinates
+
+	    Allocates the array for the dimensions of this matrix and constructs 
+	    its cells in the order of the array, the one at (z, y, x) directly 
+	    from value(z, y, x): no cell is default constructed and then assigned, 
+	    so T does not need a default constructor. Unwinds as _allocate.
+
+	    @param value function returning the value of the cell at (z, y, x)
+
+	    @return pointer to the first cell, nullptr if the matrix is empty
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	template <typename Fn>
+	T *_allocate_from(Fn value) {
+
+		const size_type n = _cells(_floors, _rows, _columns);
+		if(n == 0)
+			return nullptr;
+
+		T *p = alloc_traits::allocate(_alloc, n);
+		matrix3d_instrumentation::count_allocation(n * sizeof(T));
+		Matrix3DIndex c{0, 0, 0};
+		size_type i = 0;
+		try {
+			for(; i < n; ++i) {
+				alloc_traits::construct(_alloc, p + i, value(c.z, c.y, c.x));
+				Layout::next(c, _floors, _rows, _columns);
+			}
+		}
+		catch(...) {
+			_deallocate(p, i, n);
+			throw;
+		}
+
+		return p;
+	}
+
+	/**
+	    @brief Deallocation of an array of cells
+
+	    Destroys the first constructed cells of the array and gives 
+	    the memory of all its n cells back to the allocator.
+
+	    @param p pointer to the first cell (may be nullptr)
+	    @param constructed number of constructed cells
+	    @param n number of allocated cells
+	*/
+	void _deallocate(T *p, size_type constructed, size_type n) noexcept {
+		if(p == nullptr)
+			return;
+		for(size_type i = 0; i < constructed; ++i)
+			alloc_traits::destroy(_alloc, p + i);
+		alloc_traits::deallocate(_alloc, p, n);
+		matrix3d_instrumentation::count_deallocation(n * sizeof(T));
+	}
+
+	/**
+	    @brief Copy constructor (implementation)
+
+	    Copies the cells of other in an array allocated through alloc, 
+	    counting the deep copy as being of the given kind.
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	Matrix3D(const Matrix3D &other, const Alloc &alloc, Matrix3DCopyKind kind) : _matrix(nullptr), 
+		_floors(other._floors), _rows(other._rows), _columns(other._columns), _equals(other._equals), _alloc(alloc) {
+		try {
+			_matrix = _allocate_copy(other._matrix, other.size());
+		}
+		catch(...) {
+			clear();
+			throw;
+		}
+		matrix3d_instrumentation::count_copy(kind, size());
+	}
+
+	/**
+	    @brief First different cell
+
+	    Walks the arrays of two matrixes with the same dimensions looking for 
+	    the first cell in which they differ. When the cells are bitwise comparable 
+	    (see is_bitwise_comparable) the arrays are compared as raw bytes in SIMD 
+	    chunks, otherwise each pair of cells is compared through the _equals functor.
+
+	    @param other Matrix3D to compare
+
+	    @return linear index of the first different cell, size() if the matrixes are equal
+	*/
+	size_type _first_difference(const Matrix3D &other) const {
+
+		const size_type cells = size();
+
+		if constexpr (is_bitwise_comparable<T, F>::value) {
+			// a matrix equals itself only when every cell equals itself, as it does bytewise
+			if(this == &other)
+				return cells;
+			return first_different_byte(_matrix, other._matrix, cells * sizeof(T)) / sizeof(T);
+		}
+		else {
+			for(size_type i = 0; i < cells; ++i)
+				if(!(_equals(other._matrix[i], _matrix[i])))
+					return i;
+			return cells;
+		}
+	}
+
+	/**
+	    @brief Content hash of the cells
+
+	    Hashes the dimensions (as the seed) and the cells through a 
+	    matrix3d_hasher. The cells hashed as raw bytes (see 
+	    matrix3d_hash_as_bytes) are passed to it directly, or in chunks 
+	    with -0.0 turned into +0.0 for floating point types; the other 
+	    cells are hashed one by one through std::hash<T>.
+
+	    @return 64-bit hash of the content of the matrix
+	*/
+	std::uint64_t _content_hash() const {
+
+		matrix3d_hasher hasher(((_floors * 0x9E3779B185EBCA87ULL) ^ _rows) * 0xC2B2AE3D27D4EB4FULL ^ _columns);
+		const size_type cells = size();
+		const size_type chunk = 256;
+
+		if constexpr (std::is_same<T, float>::value || std::is_same<T, double>::value) {
+			// adding +0.0 turns -0.0 into +0.0 and leaves every other value unchanged
+			T normalized[chunk];
+			for(size_type i = 0; i < cells; i += chunk) {
+				const size_type n = std::min(chunk, cells - i);
+				for(size_type k = 0; k < n; ++k)
+					normalized[k] = _matrix[i + k] + T(0);
+				hasher.update(normalized, n * sizeof(T));
+			}
+		}
+		else if constexpr (matrix3d_hash_as_bytes<T>::value) {
+			hasher.update(_matrix, cells * sizeof(T));
+		}
+		else {
+			const std::hash<T> cell_hash;
+			std::uint64_t hashed[chunk];
+			for(size_type i = 0; i < cells; i += chunk) {
+				const size_type n = std::min(chunk, cells - i);
+				for(size_type k = 0; k < n; ++k)
+					hashed[k] = static_cast<std::uint64_t>(cell_hash(_matrix[i + k]));
+				hasher.update(hashed, n * sizeof(std::uint64_t));
+			}
+		}
+
+		return hasher.digest();
+	}
+
+	/**
+	    @brief Evaluation of an expression
+
+	    Writes each cell of the expression, converted to T, into the 
+	    corresponding cell of this matrix, in one linear pass which the 
+	    compiler can vectorize.
+
+	    @param expression expression with the same dimensions as the matrix
+	*/
+	template <typename E>
+	void _evaluate(const E &expression) {
+		static_assert(std::is_same<typename matrix3d_common_layout<typename E::layout_type, Layout>::type, Layout>::value, 
+			"the matrixes of an expression must have the same layout");
+		const size_type cells = size();
+		T *out = _matrix;
+		for(size_type i = 0; i < cells; ++i)
+			out[i] = static_cast<T>(expression[i]);
+	}
+
+	// Applies op between each cell and the corresponding one of other, in place
+	template <typename X, typename Op>
+	Matrix3D &_compound(const X &other, Op op) {
+		typename matrix3d_operand<X>::type operand = matrix3d_operand<X>::make(other);
+		static_assert(std::is_same<typename matrix3d_common_layout<typename matrix3d_operand<X>::type::layout_type, Layout>::type, Layout>::value, 
+			"the matrixes of an expression must have the same layout");
+		assert(matrix3d_operand<X>::is_scalar || 
+			(operand.getFloors() == _floors && operand.getRows() == _rows && operand.getColumns() == _columns));
+		const size_type cells = size();
+		T *out = _matrix;
+		for(size_type i = 0; i < cells; ++i)
+			out[i] = static_cast<T>(op(out[i], operand[i]));
+		return *this;
+	}
+
+public:
+
+	/**
+	    @brief Default constructor
+
+	    The default constructor is used to initialize member data
+	    to represent an empty 3D array.
+
+	    @post _matrix = nullptr
+	    @post _floors == 0
+	    @post _rows == 0
+	    @post _column == 0
+	*/
+	Matrix3D() : _matrix(nullptr), _floors(0), _rows(0), _columns(0) {}
+
+	/**
+	    @brief Allocator constructor
+
+	    Creates an empty 3D array which will use a copy of the passed 
+	    allocator for its cells.
+
+	    @param alloc allocator to use
+	*/
+	explicit Matrix3D(const Alloc &alloc) : _matrix(nullptr), _floors(0), _rows(0), _columns(0), _alloc(alloc) {}
+
+	/**
+	    @brief Adopting constructor
+
+	    Creates a 3D matrix which takes ownership of an existing array of 
+	    z*y*x constructed cells, without allocating or copying anything. 
+	    The array is destroyed and deallocated through alloc like the arrays 
+	    allocated by the matrix, so it must come from alloc (or from memory 
+	    alloc knows how to release, like the file mappings of mapped_allocator).
+
+	    @param cells pointer to the first cell of the array, nullptr for an empty matrix
+	    @param z number of floors
+	    @param y number of rows
+	    @param x number of columns
+	    @param alloc allocator which will release the array (optional)
+
+	    @pre (cells != nullptr && z!=0 && y!=0 && x!=0) || (cells == nullptr && z*y*x == 0)
+	*/
+	Matrix3D(adopt_buffer_t, T *cells, size_type z, size_type y, size_type x, const Alloc &alloc = Alloc()) noexcept : 
+		_matrix(cells), _floors(cells ? z : 0), _rows(cells ? y : 0), _columns(cells ? x : 0), _alloc(alloc) {
+		assert(cells ? (z > 0 && y > 0 && x > 0) : (z == 0 || y == 0 || x == 0));
+	}
+
+	/**
+	    @brief Secondary constructor (z, y, x)
+
+	    Secondary constructor used to construct a 3D matrix based on 
+	    the given dimensions. The cells of the array are value-initialized 
+	    through the allocator, hence zero for the arithmetic types (zeroed 
+	    by a single memset with a plain allocator). To skip this pass over 
+	    the array when the cells are going to be overwritten anyway, use 
+	    Matrix3D(uninitialized, z, y, x) instead.
+
+	    @param z number of floors of the 3D matrix to create
+	    @param y number of rows of the 3D matrix to create
+	    @param x number of columns of the 3D matrix to create
+	    @param alloc allocator to use (optional)
+
+	    @pre z!=0 && y!=0 && x!=0
+
+	    @post _matrix != nullptr
+	    @post _floors == z
+	    @post _rows == y
+	    @post _column == x
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	Matrix3D(size_type z, size_type y, size_type x, const Alloc &alloc = Alloc()) : _matrix(nullptr), _floors(z), _rows(y), _columns(x), _alloc(alloc) {
+
+		assert(z > 0 && y > 0 && x > 0);
+
+		try {
+			_matrix = _allocate(_cells(z, y, x));
+		}
+		catch(...) {
+			clear();
+			throw;
+		}
+
+	}
+
+	/**
+	    @brief Secondary constructor (z, y, x, value)
+
+	    Secondary constructor which is used to construct a 3D matrix based on 
+	    the given dimensions, and which initializes each cell of the matrix to 
+	    the value of type T value passed.
+
+	    @param z number of floors of the 3D matrix to create
+	    @param y number of rows of the 3D matrix to create
+	    @param x number of columns of the 3D matrix to create
+	    @param value value of the type of the array with which to initialize the cells
+	    @param alloc allocator to use (optional)
+
+	    @pre z!=0 && y!=0 && x!=0
+
+	    @post _matrix != nullptr
+	    @post _floors == z
+	    @post _rows == y
+	    @post _column == x
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	Matrix3D(size_type z, size_type y, size_type x, const T &value, const Alloc &alloc = Alloc()) : _matrix(nullptr), _floors(z), _rows(y), _columns(x), _alloc(alloc) {
+
+		assert(z > 0 && y > 0 && x > 0);
+
+		try {
+			_matrix = _allocate(_cells(z, y, x), value);
+		}
+		catch(...) {
+			clear();
+			throw;
+		}
+
+	}
+
+	/**
+	    @brief Secondary constructor (uninitialized, z, y, x)
+
+	    Constructs a 3D matrix with the given dimensions whose cells are going 
+	    to be overwritten by the caller: Matrix3D<float> B(uninitialized, z, y, x). 
+	    Trivial cells are left indeterminate instead of being set to zero, 
+	    saving a full write of the array; the others are default constructed.
+
+	    @param z number of floors of the 3D matrix to create
+	    @param y number of rows of the 3D matrix to create
+	    @param x number of columns of the 3D matrix to create
+	    @param alloc allocator to use (optional)
+
+	    @pre z!=0 && y!=0 && x!=0
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	Matrix3D(uninitialized_t, size_type z, size_type y, size_type x, const Alloc &alloc = Alloc()) : _matrix(nullptr), _floors(z), _rows(y), _columns(x), _alloc(alloc) {
+
+		assert(z > 0 && y > 0 && x > 0);
+
+		try {
+			_matrix = _allocate_uninitialized(_cells(z, y, x));
+		}
+		catch(...) {
+			clear();
+			throw;
+		}
+
+	}
+
+	/**
+	    @brief Copy Constructor
+
+	    Copy constructor. It is used to create an object as a copy of 
+	    another object. The two objects must be independent.
+	    The allocator is obtained from the one of other, as for the 
+	    standard containers.
+
+	    @param other source Matrix3D to copy
+	    
+	    @post _matrix != nullptr
+	    @post _floors == other._floors
+	    @post _rows == other._rows
+	    @post _column == other._column
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	Matrix3D(const Matrix3D &other) : 
+		Matrix3D(other, alloc_traits::select_on_container_copy_construction(other._alloc), Matrix3DCopyKind::copy_constructor) {}
+
+	/**
+	    @brief Copy Constructor (allocator-extended)
+
+	    Same as the copy constructor, but the array is allocated 
+	    through the passed allocator.
+
+	    @param other source Matrix3D to copy
+	    @param alloc allocator to use
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	Matrix3D(const Matrix3D &other, const Alloc &alloc) : Matrix3D(other, alloc, Matrix3DCopyKind::copy_constructor) {}
+
+	/**
+	    @brief Assignment operator
+
+	    The assignment operator is used to copy the contents of one 
+	    object into another object of the same type. 
+	    The two objects must be independent.
+
+	    @param other source Matrix3D to copy
+
+	    @return a reference to the current object
+
+	    @post _matrix != nullptr
+	    @post _floors == other._floors
+	    @post _rows == other._rows
+	    @post _column == other._column 
+	*/
+	Matrix3D &operator=(const Matrix3D &other) {
+		if(this != &other) {
+			Matrix3D tmp(other, alloc_traits::propagate_on_container_copy_assignment::value ? other._alloc : _alloc, Matrix3DCopyKind::copy_assignment);
+			this->swap(tmp);
+		}
+
+		return *this;
+	}
+
+	/**
+	    @brief Move constructor
+
+	    Move constructor. It is used to create an object by stealing the 
+	    heap-allocated array of a temporary (or explicitly moved) object, 
+	    without allocating or copying any cell. 
+	    The moved-from object is left empty, as after a clear().
+
+	    @param other source Matrix3D to move from
+
+	    @post _floors == old other._floors
+	    @post _rows == old other._rows
+	    @post _column == old other._column
+	    @post other._matrix == nullptr
+	*/
+	Matrix3D(Matrix3D &&other) noexcept : _matrix(other._matrix), _floors(other._floors), _rows(other._rows), _columns(other._columns), 
+		_equals(std::move(other._equals)), _alloc(std::move(other._alloc)) {
+		other._matrix = nullptr;
+		other._floors = 0;
+		other._rows = 0;
+		other._columns = 0;
+	}
+
+	/**
+	    @brief Move assignment operator
+
+	    The move assignment operator takes ownership of the array of the 
+	    passed object, releasing the one previously owned. 
+	    No cell is allocated or copied, unless the allocators are different 
+	    and do not propagate: the array of other could not be released by 
+	    the allocator of this matrix, so its cells are copied instead.
+	    The moved-from object is left empty, as after a clear().
+
+	    @param other source Matrix3D to move from
+
+	    @return a reference to the current object
+
+	    @post other._matrix == nullptr
+	*/
+	Matrix3D &operator=(Matrix3D &&other) noexcept(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value) {
+		if(this != &other) {
+			if(alloc_traits::propagate_on_container_move_assignment::value || _alloc == other._alloc) {
+				Matrix3D tmp(std::move(other));
+				this->swap(tmp);
+			}
+			else {
+				Matrix3D tmp(other, _alloc);
+				this->swap(tmp);
+				other.clear();
+			}
+		}
+
+		return *this;
+	}
+
+	/**
+	    @brief Move conversion constructor
+
+	    Creates a Matrix3D<T, F> by stealing the array of a Matrix3D<T, G>, 
+	    that is a matrix holding the same data type but using a different 
+	    functor for the equality operator. 
+	    The cells do not need any conversion, therefore no copy takes place.
+
+	    @param other the Matrix3D of type <T, G> to move from
+	*/
+	template <typename G>
+	Matrix3D(Matrix3D<T, G, Alloc, Layout> &&other) noexcept : _matrix(other._matrix), _floors(other._floors), _rows(other._rows), _columns(other._columns), 
+		_alloc(std::move(other._alloc)) {
+		other._matrix = nullptr;
+		other._floors = 0;
+		other._rows = 0;
+		other._columns = 0;
+	}
+
+	/**
+	    @brief Access to the number of floors of the 3D matrix
+
+	    Method to obtain the number of floors of the 3D matrix.
+
+    	@return number of floors of the 3D matrix
+	*/
+	size_type getFloors() const {
+		return _floors;
+	}
+
+	/**
+	    @brief Access to the number of rows of the 3D matrix
+
+	    Method to obtain the number of rows of the 3D matrix.
+
+    	@return number of rows of the 3D matrix
+	*/
+	size_type getRows() const {
+		return _rows;
+	}
+
+	/**
+	    @brief Access to the number of columns of the 3D matrix
+
+	    Method to obtain the number of columns of the 3D matrix.
+
+    	@return number of columns of the 3D matrix
+	*/
+	size_type getColumns() const {
+		return _columns;
+	}
+
+	/**
+	    @brief Access to the number of cells of the 3D matrix
+
+	    Method to obtain the total number of cells of the 3D matrix, 
+	    that is the product of its 3 dimensions.
+
+    	@return number of cells of the 3D matrix
+	*/
+	size_type size() const {
+		return _floors * _rows * _columns;
+	}
+
+	/**
+	    @brief Access to the allocator of the 3D matrix
+
+	    @return a copy of the allocator used for the array of cells
+	*/
+	allocator_type get_allocator() const {
+		return _alloc;
+	}
+
+	/**
+	    @brief swap method
+
+	    Function that swaps the contents and dimensions of two 3D matrixes.
+	    The allocators are swapped as well if they propagate on swap, 
+	    otherwise they must be equal.
+
+	    @param other the Matrix3D with which to exchange content
+	*/
+	void swap(Matrix3D &other) noexcept {
+		assert(alloc_traits::propagate_on_container_swap::value || _alloc == other._alloc);
+        std::swap(_matrix, other._matrix);
+        std::swap(_rows, other._rows);
+        std::swap(_columns, other._columns);
+        std::swap(_floors, other._floors);
+        std::swap(_equals, other._equals);
+        if(alloc_traits::propagate_on_container_swap::value)
+        	std::swap(_alloc, other._alloc);
+    }
+
+    /**
+	    @brief swap global function
+
+	    Overload found through ADL, so that std::swap-based code and the 
+	    standard algorithms exchange two Matrix3D in O(1) instead of going 
+	    through a temporary deep copy.
+
+	    @param a first Matrix3D
+	    @param b second Matrix3D
+	*/
+    friend void swap(Matrix3D &a, Matrix3D &b) noexcept {
+    	a.swap(b);
+    }
+
+    /**
+    	@brief Overflow-checked number of cells
+
+    	Computes z * y * x, checking that neither the number of cells nor the 
+    	number of bytes they occupy overflow, so that huge dimensions cannot 
+    	silently wrap around and allocate a smaller array than expected.
+
+    	@param z number of floors
+    	@param y number of rows
+    	@param x number of columns
+
+    	@return number of cells of a z * y * x matrix
+
+    	@throw std::bad_array_new_length if the matrix could not be addressed
+    */
+    static size_type _cells(size_type z, size_type y, size_type x) {
+    	const size_type max_cells = std::numeric_limits<difference_type>::max() / sizeof(T);
+    	if((y != 0 && z > max_cells / y) || (x != 0 && z * y > max_cells / x))
+    		throw std::bad_array_new_length();
+    	return z * y * x;
+    }
+
+    /**
+    	@brief clear method
+
+    	Function that empties the Matrix3D, destroying the cells and giving 
+    	their memory back to the allocator, and bringing member data to a 
+    	coherent state.
+
+    	@post _matrix == nullptr
+	    @post _floors == 0
+	    @post _rows == 0
+	    @post _column == 0
+    */
+
+	void clear() {
+		_deallocate(_matrix, size(), size());
+        _matrix = nullptr;
+        _rows = 0;
+        _columns = 0;
+        _floors = 0;
+    }
+
+    /**
+	    @brief Destructor
+
+	    Class destructor. The destructor must remove all resources used 
+	    by the class. In this case the heap-allocated array must be deallocated 
+	    and the other data members must be returned to a coherent state.
+
+	    @post _matrix == nullptr
+	    @post _floors == 0
+	    @post _rows == 0
+	    @post _column == 0
+	*/
+    ~Matrix3D() {
+        clear();
+    }
+
+	/**
+	    @brief Getter/Setter of the (z, y, x)-th cell
+
+	    Method that allows to read and/or write the (z, y, x)-th cell of the matrix.
+
+	    @param z floor index of the 3D matrix in which the cell is located
+	    @param y row index of the 3D matrix where the cell is located
+	    @param x column index of the 3D matrix where the cell is located
+
+	    @return reference to the (z, y, x)-th cell of the 3D matrix
+
+	    @pre z < _floors && y < _rows && x < _columns
+	*/
+    T& operator()(size_type z, size_type y, size_type x) {
+    	assert(z < _floors && y < _rows && x < _columns);
+    	return _matrix[Layout::offset(z, y, x, _floors, _rows, _columns)];
+    }
+
+    /**
+	    @brief Getter of the (z, y, x)-th cell
+
+	    Method which allows to read the (z, y, x)-th cell of the matrix.
+
+	    @param z floor index of the 3D matrix in which the cell is located
+	    @param y row index of the 3D matrix where the cell is located
+	    @param x column index of the 3D matrix where the cell is located
+
+	    @return reference alla cella (z, y, x)-esima della matrice 3D
+
+	    @pre z < _floors && y < _rows && x < _columns
+	*/
+    const T& operator()(size_type z, size_type y, size_type x) const {
+    	assert(z < _floors && y < _rows && x < _columns);
+    	return _matrix[Layout::offset(z, y, x, _floors, _rows, _columns)];
+    }
+
+    /**
+    @brief slice method
+
+	    Method that returns a sub-Matrix3D containing the values in the coordinate 
+	    intervals z1-z2, y1-y2 and x1-x2.
+	    The returned matrix is an independent copy: to work on the region 
+	    without copying it, use view() instead.
+
+	    @param z1 floor index from which to start the slicing of the original 3D matrix
+	    @param y1 row index from which to start the slicing of the original 3D matrix
+	    @param x1 column index from which to start the slicing of the original 3D matrix
+	    @param z2 floor index from which to end the slicing of the original 3D matrix
+	    @param y2 row index from which to end the slicing of the original 3D matrix
+	    @param x2 column index from which to end the slicing of the original 3D matrix
+
+	    @return sub-Matrix3D containing the values in the specified ranges
+
+	    @pre z1 < _floors && z2 < _floors && y1 < _rows && y2 < _rows && x1 < _columns && x2 < _columns
+	*/
+    Matrix3D slice(size_type z1, size_type z2, size_type y1, size_type y2, size_type x1, size_type x2) const {
+
+    	matrix3d_instrumentation::count_copy(Matrix3DCopyKind::slice, (z2 - z1 + 1) * (y2 - y1 + 1) * (x2 - x1 + 1));
+
+    	if constexpr (Layout::is_row_major && std::is_trivially_copyable<T>::value) {
+    		return view(z1, z2, y1, y2, x1, x2).template materialize<F, Alloc>(alloc_traits::select_on_container_copy_construction(_alloc));
+    	}
+    	else {
+    		assert(z1 < _floors && z2 < _floors && y1 < _rows && y2 < _rows && x1 < _columns && x2 < _columns);
+    		assert(z2 >= z1 && y2 >= y1 && x2 >= x1);
+
+    		// the cells are copy constructed in place
+    		Matrix3D sliced(alloc_traits::select_on_container_copy_construction(_alloc));
+    		sliced._floors = z2 - z1 + 1;
+    		sliced._rows = y2 - y1 + 1;
+    		sliced._columns = x2 - x1 + 1;
+    		sliced._equals = _equals;
+    		try {
+    			sliced._matrix = sliced._allocate_from([&](size_type z, size_type y, size_type x) -> const T & {
+    				return (*this)(z1 + z, y1 + y, x1 + x);
+    			});
+    		}
+    		catch(...) {
+    			sliced._floors = sliced._rows = sliced._columns = 0;
+    			throw;
+    		}
+    		return sliced;
+    	}
+
+    }
+
+    /**
+    @brief view method
+
+	    Method that returns a view on the cells in the coordinate intervals 
+	    z1-z2, y1-y2 and x1-x2, in O(1). 
+	    No cell is copied: the view refers directly to the array of this matrix, 
+	    so it must not outlive it, and writes through it modify this matrix.
+	    Views are strided, so they are only available with the row-major layout.
+
+	    @param z1 floor index from which to start the view
+	    @param z2 floor index at which to end the view
+	    @param y1 row index from which to start the view
+	    @param y2 row index at which to end the view
+	    @param x1 column index from which to start the view
+	    @param x2 column index at which to end the view
+
+	    @return Matrix3DView on the cells in the specified ranges
+
+	    @pre z1 < _floors && z2 < _floors && y1 < _rows && y2 < _rows && x1 < _columns && x2 < _columns
+	*/
+    Matrix3DView<T> view(size_type z1, size_type z2, size_type y1, size_type y2, size_type x1, size_type x2) {
+    	return view().view(z1, z2, y1, y2, x1, x2);
+    }
+
+    /**
+    @brief view method (const)
+
+	    Read-only version of the view method, usable on constant matrixes.
+
+	    @return Matrix3DView on the cells in the specified ranges
+
+	    @pre z1 < _floors && z2 < _floors && y1 < _rows && y2 < _rows && x1 < _columns && x2 < _columns
+	*/
+    Matrix3DView<const T> view(size_type z1, size_type z2, size_type y1, size_type y2, size_type x1, size_type x2) const {
+    	return view().view(z1, z2, y1, y2, x1, x2);
+    }
+
+    // Return a view on the whole matrix
+    Matrix3DView<T> view() {
+    	static_assert(Layout::is_row_major, "views are only available with the row-major layout");
+    	return Matrix3DView<T>(_matrix, _floors, _rows, _columns, difference_type(_rows * _columns), difference_type(_columns));
+    }
+
+    // Return a read-only view on the whole matrix
+    Matrix3DView<const T> view() const {
+    	static_assert(Layout::is_row_major, "views are only available with the row-major layout");
+    	return Matrix3DView<const T>(_matrix, _floors, _rows, _columns, difference_type(_rows * _columns), difference_type(_columns));
+    }
+
+    /**
+	    @brief Content hash
+
+	    Returns a 64-bit hash of the dimensions and of the cells, computed 
+	    in one pass over the array (see matrix3d_hasher) every time it is 
+	    called: the hash is not cached, so writes of any kind are always seen.
+	    Equal matrixes with the default functor have the same hash. 
+	    To keep a matrix as a key with its hash computed once, 
+	    see HashedMatrix3D.
+
+	    @return hash of the content of the matrix
+	*/
+    std::uint64_t hash() const {
+    	static_assert(matrix3d_hashable<T>::value, "the cells must be hashed as raw bytes or have std::hash enabled");
+    	return _content_hash();
+    }
+
+    /**
+	    @brief Equality operator
+
+	    The equality operator is used to check that two Matrices 3D 
+	    are equal and therefore contain the same values in all the corresponding cells.
+		For the comparison, the _equals functor is used, a member functor whose type can be 
+		defined when creating the matrix for greater flexibility.
+		If not defined, the default functor uses the == operator and it is therefore necessary 
+		that any custom data types redefine it in turn.
+		Matrixes with different dimensions are different, without comparing the cells.
+
+	    @param other source Matrix3D to compare
+
+	    @return true if the matrixes are equal, false otherwise
+	*/
+    bool operator==(const Matrix3D &other) const {
+
+    	if(_floors != other._floors || _rows != other._rows || _columns != other._columns)
+    		return false;
+
+        return _first_difference(other) == size();
+        			
+    }
+
+    /**
+	    @brief mismatch method
+
+	    Finds the first cell, in the order of iteration of the matrix data, 
+	    in which two Matrices 3D having the same dimensions differ, according 
+	    to the same comparison used by the equality operator.
+
+	    @param other Matrix3D to compare
+
+	    @return the coordinates of the first different cell, or no value if the matrixes are equal
+
+	    @pre _floors == other._floors && _rows == other._rows && _columns == other._columns
+	*/
+    std::optional<Matrix3DIndex> mismatch(const Matrix3D &other) const {
+
+    	assert(_floors == other._floors && _rows == other._rows && _columns == other._columns);
+
+    	const size_type i = _first_difference(other);
+    	if(i == size())
+    		return std::nullopt;
+
+    	return Layout::index(i, _floors, _rows, _columns);
+    }
+
+    /**
+	    @brief Inequality operator
+
+	    The inequality operator is used to check that two Matrices 3D having the same 
+	    dimensions are different and therefore contain different values even in only 
+	    some corresponding cells.
+		Use the equality operator and return the opposite boolean value.
+
+	    @param other source Matrix3D to compare
+
+	    @return true if the matrixes are equal, false otherwise
+	*/
+    bool operator!=(const Matrix3D &other) const {
+
+        return !((*this) == other);
+        			
+    }
+
+    // Implementation of random access iterators through the pointer trick,
+	// being the internal structure array-based.
+
+    typedef T *iterator;
+
+    // Return the iterator to the start of the data sequence
+	iterator begin() {
+		return _matrix;
+	}
+
+	// Return the iterator at the end of the data sequence
+	iterator end() {
+		return _matrix + size();
+	}
+
+	typedef const T *const_iterator;
+
+	// Return the iterator to the start of the data sequence
+	const_iterator begin() const {
+		return _matrix;
+	}
+	
+	// Return the iterator at the end of the data sequence
+	const_iterator end() const {
+		return _matrix + size();
+	}
+
+	/**
+	    @brief Coordinates of an iterator
+
+	    The iterators walk the array in the order of the layout (brick after 
+	    brick with the bricked layout), which is the fastest order to visit 
+	    all the cells. This method gives the coordinates of the cell an 
+	    iterator points to, for algorithms which need them while walking.
+
+	    @param i iterator to a cell of the matrix
+
+	    @return the coordinates of the cell
+
+	    @pre begin() <= i < end()
+	*/
+	Matrix3DIndex index_of(const_iterator i) const {
+		assert(i >= _matrix && i < _matrix + size());
+		return Layout::index(size_type(i - _matrix), _floors, _rows, _columns);
+	}
+
+	typedef Matrix3DIndexedIterator<T, Layout> indexed_iterator;
+	typedef Matrix3DIndexedIterator<const T, Layout> const_indexed_iterator;
+
+	// Return the indexed iterator to the start of the data sequence
+	indexed_iterator indexed_begin() {
+		return indexed_iterator(_matrix, Matrix3DIndex(), _floors, _rows, _columns);
+	}
+
+	// Return the indexed iterator at the end of the data sequence
+	indexed_iterator indexed_end() {
+		return indexed_iterator(_matrix + size(), Matrix3DIndex(), _floors, _rows, _columns);
+	}
+
+	// Return the indexed iterator to the start of the data sequence
+	const_indexed_iterator indexed_begin() const {
+		return const_indexed_iterator(_matrix, Matrix3DIndex(), _floors, _rows, _columns);
+	}
+
+	// Return the indexed iterator at the end of the data sequence
+	const_indexed_iterator indexed_end() const {
+		return const_indexed_iterator(_matrix + size(), Matrix3DIndex(), _floors, _rows, _columns);
+	}
+
+	/**
+	    @brief fill method
+
+	    Generic method that allows to fill a Matrix3D with values taken 
+	    from a sequence of data identified by generic iterators.
+		Filling takes place in the order of iteration of the matrix data, 
+		and stops in case the matrix to be filled is no longer able to contain 
+		data but the passed sequence is not ended yet.
+		The old values are overwritten.
+		When neither the conversion and assignment of the values nor the 
+		iteration can throw, the cells are written in place, with a single 
+		memmove for a contiguous sequence (see matrix3d_contiguous_iterator) 
+		of trivially copyable cells of the same type. Otherwise a copy of the 
+		matrix is filled and swapped with it, so that the matrix is left 
+		unchanged if an exception is thrown.
+
+	    @param b l'iteratore che indica l'inizio della sequenza di dati
+	    @param b l'iteratore che indica la fine della sequenza di dati
+	*/
+    template<typename Iter>
+    void fill(Iter b, Iter e) {
+
+    	if constexpr (_bulk_fill<Iter>) {
+    		const size_type n = std::min<size_type>(size(), static_cast<size_type>(e - b));
+    		if(n > 0)
+    			std::memmove(static_cast<void *>(_matrix), std::addressof(*b), n * sizeof(T));
+    	}
+    	else if constexpr (_nothrow_fill<Iter>) {
+    		_fill_from(b, e);
+    	}
+    	else {
+    		Matrix3D tmp(*this, alloc_traits::select_on_container_copy_construction(_alloc), Matrix3DCopyKind::fill);
+    		tmp._fill_from(b, e);
+    		this->swap(tmp);
+    	}
+    }
+
+    /**
+	    @brief fill method (parallel)
+
+	    Same as fill(b, e), but the cells are split in contiguous blocks 
+	    filled in parallel by the threads of the passed pool. The sequence 
+	    must be random access, and must not be made of cells of this matrix 
+	    unless it is contiguous (an overlapping contiguous sequence is 
+	    copied sequentially).
+
+	    @param b iterator to the start of the sequence of data
+	    @param e iterator to the end of the sequence of data
+	    @param pool the pool of threads filling the matrix
+	*/
+    template<typename Iter>
+    void fill(Iter b, Iter e, Matrix3DThreadPool &pool) {
+
+    	static_assert(std::is_base_of<std::random_access_iterator_tag, typename std::iterator_traits<Iter>::iterator_category>::value, 
+    		"the parallel fill needs random access iterators");
+
+    	const size_type n = std::min<size_type>(size(), static_cast<size_type>(e - b));
+    	if constexpr (matrix3d_contiguous_iterator<Iter>::value) {
+    		if(n > 0 && _overlaps(std::addressof(*b), n)) {
+    			fill(b, e);
+    			return;
+    		}
+    	}
+
+    	if constexpr (_nothrow_fill<Iter>) {
+    		_parallel_fill_from(b, n, pool);
+    	}
+    	else {
+    		Matrix3D tmp(*this, alloc_traits::select_on_container_copy_construction(_alloc), Matrix3DCopyKind::fill);
+    		tmp._parallel_fill_from(b, n, pool);
+    		this->swap(tmp);
+    	}
+    }
+
+    /**
+	    @brief fill method (value)
+
+	    Assigns the value to all the cells, in place when the assignment of T 
+	    cannot throw; otherwise the matrix is rebuilt with the value and 
+	    swapped, so that it is left unchanged if an exception is thrown.
+
+	    @param value the value to assign to the cells
+	*/
+    void fill(const T &value) {
+
+    	if(size() == 0)
+    		return;
+
+    	if constexpr (std::is_nothrow_copy_assignable<T>::value) {
+    		std::fill(_matrix, _matrix + size(), value);
+    	}
+    	else {
+    		Matrix3D tmp(_floors, _rows, _columns, value, alloc_traits::select_on_container_copy_construction(_alloc));
+    		tmp._equals = _equals;
+    		this->swap(tmp);
+    	}
+    }
+
+    /**
+	    @brief fill method (value, parallel)
+
+	    Same as fill(value), but the cells are split in contiguous blocks 
+	    filled in parallel by the threads of the passed pool.
+
+	    @param value the value to assign to the cells
+	    @param pool the pool of threads filling the matrix
+	*/
+    void fill(const T &value, Matrix3DThreadPool &pool) {
+
+    	if constexpr (std::is_nothrow_copy_assignable<T>::value) {
+    		T *out = _matrix;
+    		pool.parallel_for(0, size(), [out, &value](std::size_t first, std::size_t last) {
+    			std::fill(out + first, out + last, value);
+    		}, trasform_grain);
+    	}
+    	else
+    		fill(value);
+    }
+
+    /**
+	    @brief fill_region method
+
+	    Assigns the value to the cells in the coordinate intervals z1-z2, 
+	    y1-y2 and x1-x2 (bounds included, as in slice()), leaving the others 
+	    unchanged. With the row-major layout each row of the region is filled 
+	    with a single std::fill. The exception guarantee is the same as fill().
+
+	    @param z1 first floor of the region
+	    @param z2 last floor of the region
+	    @param y1 first row of the region
+	    @param y2 last row of the region
+	    @param x1 first column of the region
+	    @param x2 last column of the region
+	    @param value the value to assign to the cells of the region
+
+	    @pre z1 <= z2 < _floors && y1 <= y2 < _rows && x1 <= x2 < _columns
+	*/
+    void fill_region(size_type z1, size_type z2, size_type y1, size_type y2, size_type x1, size_type x2, const T &value) {
+
+    	assert(z1 < _floors && z2 < _floors && y1 < _rows && y2 < _rows && x1 < _columns && x2 < _columns);
+    	assert(z2 >= z1 && y2 >= y1 && x2 >= x1);
+
+    	if constexpr (!std::is_nothrow_copy_assignable<T>::value) {
+    		Matrix3D tmp(*this, alloc_traits::select_on_container_copy_construction(_alloc), Matrix3DCopyKind::fill);
+    		tmp._fill_region(z1, z2, y1, y2, x1, x2, value);
+    		this->swap(tmp);
+    	}
+    	else
+    		_fill_region(z1, z2, y1, y2, x1, x2, value);
+    }
+
+private:
+
+	/// true if fill() can write the values of the sequence in place
+	template <typename Iter>
+	static constexpr bool _nothrow_fill = noexcept(std::declval<T &>() = static_cast<T>(*std::declval<Iter &>())) && 
+		noexcept(++std::declval<Iter &>()) && noexcept(std::declval<Iter &>() != std::declval<Iter &>());
+
+	/// true if fill() can copy the sequence with a memmove
+	template <typename Iter>
+	static constexpr bool _bulk_fill = matrix3d_contiguous_iterator<Iter>::value && 
+		std::is_same<typename std::remove_cv<typename std::iterator_traits<Iter>::value_type>::type, T>::value && std::is_trivially_copyable<T>::value;
+
+	// Return true if the n cells starting from p are inside the array of this matrix
+	bool _overlaps(const void *p, size_type n) const {
+		std::less<const void *> less;
+		return less(p, _matrix + size()) && less(static_cast<const T *>(_matrix), static_cast<const T *>(p) + n);
+	}
+
+	// Assigns the values of the sequence to the cells, in the order of the array
+	template <typename Iter>
+	void _fill_from(Iter b, Iter e) {
+		const size_type cells = size();
+		size_type i = 0;
+		while(b != e && i != cells) { // fills while it can
+			_matrix[i] = static_cast<T>(*b);
+			++b;
+			++i;
+		}
+	}
+
+	// Assigns the first n values of the random access sequence to the cells, in parallel
+	template <typename Iter>
+	void _parallel_fill_from(Iter b, size_type n, Matrix3DThreadPool &pool) {
+		T *out = _matrix;
+		pool.parallel_for(0, n, [out, b](std::size_t first, std::size_t last) {
+			if constexpr (_bulk_fill<Iter>)
+				std::memcpy(static_cast<void *>(out + first), std::addressof(b[first]), (last - first) * sizeof(T));
+			else
+				for(std::size_t i = first; i < last; ++i)
+					out[i] = static_cast<T>(b[i]);
+		}, trasform_grain);
+	}
+
+	// Assigns the value to the cells of the region, in place
+	void _fill_region(size_type z1, size_type z2, size_type y1, size_type y2, size_type x1, size_type x2, const T &value) {
+		for(size_type z = z1; z <= z2; ++z)
+			for(size_type y = y1; y <= y2; ++y) {
+				if constexpr (Layout::is_row_major) {
+					T *row = _matrix + Layout::offset(z, y, 0, _floors, _rows, _columns);
+					std::fill(row + x1, row + x2 + 1, value);
+				}
+				else {
+					for(size_type x = x1; x <= x2; ++x)
+						(*this)(z, y, x) = value;
+				}
+			}
+	}
+
+public:
+
+    /**
+	    @brief Expression constructor
+
+	    Creates a Matrix3D evaluating an elementwise expression (like a*B + C - d), 
+	    built by the arithmetic operators, the comparison operators and where(). 
+	    The whole expression is computed cell by cell in a single pass over 
+	    the arrays of its operands, without allocating any intermediate matrix.
+
+	    @param expression the expression to evaluate
+	    @param alloc allocator to use (optional)
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+    template <typename E, typename = typename std::enable_if<is_matrix3d_expression<E>::value>::type>
+    Matrix3D(const E &expression, const Alloc &alloc = Alloc()) : _matrix(nullptr), 
+    	_floors(expression.getFloors()), _rows(expression.getRows()), _columns(expression.getColumns()), _alloc(alloc) {
+    	try {
+    		_matrix = _allocate_uninitialized(_cells(_floors, _rows, _columns));
+    		_evaluate(expression);
+    	}
+    	catch(...) {
+    		clear();
+    		throw;
+    	}
+    }
+
+    /**
+	    @brief Expression assignment operator
+
+	    Evaluates an elementwise expression into this matrix. If the dimensions 
+	    are the same the cells are overwritten in place, which is safe even 
+	    if this matrix is an operand of the expression (a = a*b + c), since 
+	    every cell only depends on the corresponding cells of the operands; 
+	    otherwise a new array is allocated.
+
+	    @param expression the expression to evaluate
+
+	    @return a reference to the current object
+	*/
+    template <typename E, typename = typename std::enable_if<is_matrix3d_expression<E>::value>::type>
+    Matrix3D &operator=(const E &expression) {
+    	if(_floors == expression.getFloors() && _rows == expression.getRows() && _columns == expression.getColumns()) {
+    		_evaluate(expression);
+    	}
+    	else {
+    		Matrix3D tmp(expression, _alloc);
+    		this->swap(tmp);
+    	}
+
+    	return *this;
+    }
+
+    /**
+	    @brief Compound assignment operators
+
+	    Add, subtract, multiply or divide in place each cell by the corresponding 
+	    cell of a matrix or expression with the same dimensions, or by a scalar.
+
+	    @param other matrix, expression or scalar
+
+	    @return a reference to the current object
+	*/
+    template <typename X>
+    Matrix3D &operator+=(const X &other) {
+    	return _compound(other, std::plus<>());
+    }
+
+    template <typename X>
+    Matrix3D &operator-=(const X &other) {
+    	return _compound(other, std::minus<>());
+    }
+
+    template <typename X>
+    Matrix3D &operator*=(const X &other) {
+    	return _compound(other, std::multiplies<>());
+    }
+
+    template <typename X>
+    Matrix3D &operator/=(const X &other) {
+    	return _compound(other, std::divides<>());
+    }
+
+    /**
+	    @brief Conversion constructor (implicit/explicit)
+
+	    The conversion constructor creates a Matrix3D<T, F> object from a
+		Matrix3D<U, Q, B, M> object.
+		Allows the conversion of a Matrix3D defined on one type to a Matrix3D 
+		defined on a different type (where casting is possible), 
+		and between matrixes with different layouts.
+
+	    @param other the Matrix3D of type <U, Q, B, M> from which to create the new object
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+    template <typename U, typename Q, typename B, typename M>
+	Matrix3D(const Matrix3D<U, Q, B, M> &other) : _matrix(nullptr), _floors(other.getFloors()), _rows(other.getRows()), _columns(other.getColumns()) {
+		try {
+			_matrix = _allocate_from([&other](size_type z, size_type y, size_type x) {
+				return static_cast<T>(static_cast<U>(other(z, y, x)));
+			});
+		}
+		catch(...) {
+			clear();
+			throw;
+		}
+		matrix3d_instrumentation::count_copy(Matrix3DCopyKind::conversion, size());
+	}
+
+    /**
+	    @brief stream operator redefinition
+
+	    Global function that redefines the stream operator to write a Matrix3D 
+	    to an output stream.
+    	The function is declared friend because we access the private data of Matrix3D.
+    	When the cells are arithmetic and the stream is in its default state, 
+    	the text is formatted with std::to_chars in a local buffer and written 
+    	in large blocks; otherwise the cells go through the stream operator of T.
+    	Rows end with '\n' and the stream is never flushed.
+
+	    @param os output stream (left operand)
+	    @param m Matrix3D to write (right operand)
+
+	    @return reference to the output stream
+	*/
+    friend std::ostream &operator<<(std::ostream &os, const Matrix3D &m) {
+
+        if constexpr (matrix3d_fast_text<T>::value) {
+        	if(matrix3d_text_writer::is_plain(os)) {
+        		std::ostream::sentry ok(os);
+        		if(ok)
+        			m._write_text(os);
+        		return os;
+        	}
+        }
+        
+        os << "rows: " << m._rows << '\n';
+        os << "columns: " << m._columns << '\n';
+        os << "floors: " << m._floors << '\n';
+
+        os << "matrix: " << '\n';
+
+        for(size_type z = 0; z < m._floors; ++z) {
+
+        	os << z+1 << "° floor: " << z << '\n';
+
+        	for(size_type y = 0; y < m._rows; ++y) {
+
+        		for(size_type x = 0; x < m._columns; ++x)
+        			os << m(z, y, x) << " ";
+
+        		os << '\n';
+        	}
+
+        	os << '\n';
+
+        }
+
+        return os;
+    }
+
+    /**
+	    @brief stream extraction operator
+
+	    Reads a Matrix3D in the format written by the stream operator. 
+	    Arithmetic cells are parsed with std::from_chars straight from the 
+	    buffer of the stream (when the stream is in its default state), the 
+	    other types with their own extraction operator, which must read back 
+	    what their stream operator writes. Nothing after the last cell is 
+	    consumed. If the text is not a valid matrix, or its dimensions do not 
+	    fit in memory, the failbit of the stream is set and m is left unchanged.
+
+	    @param is input stream (left operand)
+	    @param m Matrix3D to read (right operand)
+
+	    @return reference to the input stream
+	*/
+    friend std::istream &operator>>(std::istream &is, Matrix3D &m) {
+
+        Matrix3D tmp(m._alloc);
+        bool read;
+
+        if constexpr (matrix3d_fast_text<T>::value) {
+        	if(matrix3d_text_writer::is_plain(is)) {
+        		std::istream::sentry ok(is, true);
+        		if(!ok)
+        			return is;
+        		matrix3d_text_reader reader(is.rdbuf());
+        		read = tmp._read_text(reader);
+        	}
+        	else
+        		read = tmp._read_text(is);
+        }
+        else
+        	read = tmp._read_text(is);
+
+        if(!read) {
+        	is.setstate(std::ios_base::failbit);
+        	return is;
+        }
+
+        tmp._equals = m._equals;
+        m.swap(tmp);
+        return is;
+    }
+
+private:
+
+	// Writes the text of the stream operator with a buffered text writer
+	void _write_text(std::ostream &os) const {
+		matrix3d_text_writer w(os);
+
+		w.put("rows: ");
+		w.put_value(_rows);
+		w.put("\ncolumns: ");
+		w.put_value(_columns);
+		w.put("\nfloors: ");
+		w.put_value(_floors);
+		w.put("\nmatrix: \n");
+
+		for(size_type z = 0; z < _floors; ++z) {
+			w.put_value(z + 1);
+			w.put("° floor: ");
+			w.put_value(z);
+			w.put('\n');
+
+			for(size_type y = 0; y < _rows; ++y) {
+				if constexpr (Layout::is_row_major) {
+					const T *row = _matrix + Layout::offset(z, y, 0, _floors, _rows, _columns);
+					for(size_type x = 0; x < _columns; ++x) {
+						w.put_value(row[x]);
+						w.put(' ');
+					}
+				}
+				else {
+					for(size_type x = 0; x < _columns; ++x) {
+						w.put_value((*this)(z, y, x));
+						w.put(' ');
+					}
+				}
+				w.put('\n');
+			}
+
+			w.put('\n');
+		}
+	}
+
+	// Allocates the cells of an empty matrix read from text (all the dimensions zero or none), false if they do not fit in memory
+	bool _resize_text(size_type z, size_type y, size_type x) {
+		if(z == 0 || y == 0 || x == 0)
+			return z == 0 && y == 0 && x == 0;
+		try {
+			Matrix3D sized(uninitialized, z, y, x, _alloc);
+			swap(sized);
+		}
+		catch(const std::bad_alloc &) {
+			return false;
+		}
+		catch(const std::length_error &) {
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	    @brief Parses the text of the stream operator
+
+	    Reads the dimensions, allocates the cells and reads them floor by 
+	    floor from a text reader (arithmetic cells) or an input stream (other 
+	    types), both offering the same three operations.
+
+	    @return false if the text is not a valid matrix
+	*/
+	template <typename Reader>
+	bool _read_text(Reader &r) {
+		size_type rows, columns, floors;
+		if(!(_expect(r, "rows:") && _value(r, rows) && _expect(r, "columns:") && _value(r, columns) &&
+			_expect(r, "floors:") && _value(r, floors) && _expect(r, "matrix:") && _resize_text(floors, rows, columns)))
+			return false;
+
+		for(size_type z = 0; z < _floors; ++z) {
+			size_type label;
+			// the floor label "<z+1>° floor: <z>" is three tokens
+			if(!(_skip(r) && _expect(r, "floor:") && _value(r, label) && label == z))
+				return false;
+
+			for(size_type y = 0; y < _rows; ++y) {
+				if constexpr (Layout::is_row_major) {
+					T *row = _matrix + Layout::offset(z, y, 0, _floors, _rows, _columns);
+					for(size_type x = 0; x < _columns; ++x)
+						if(!_value(r, row[x]))
+							return false;
+				}
+				else {
+					for(size_type x = 0; x < _columns; ++x)
+						if(!_value(r, (*this)(z, y, x)))
+							return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	static bool _expect(matrix3d_text_reader &r, const char *word) {
+		return r.expect(word);
+	}
+
+	static bool _expect(std::istream &is, const char *word) {
+		std::string token;
+		return (is >> token) && token == word;
+	}
+
+	static bool _skip(matrix3d_text_reader &r) {
+		return r.next();
+	}
+
+	static bool _skip(std::istream &is) {
+		std::string token;
+		return bool(is >> token);
+	}
+
+	template <typename V>
+	static bool _value(matrix3d_text_reader &r, V &value) {
+		return r.value(value);
+	}
+
+	template <typename V>
+	static bool _value(std::istream &is, V &value) {
+		return bool(is >> value);
+	}
+
+};
+
+/**
+  @brief Matrix3DView Class
+
+  Template class implementing a non-owning, strided window over the cells 
+  of a 3D matrix. A view stores the address of its first cell (origin), 
+  its extents and the strides of the matrix it has been taken from, so 
+  creating it costs O(1) whatever the size of the selected region.
+  The cells are never copied: writing through a Matrix3DView<T> writes into 
+  the parent matrix, while a Matrix3DView<const T> only allows to read them.
+  A view must not outlive the matrix it refers to.
+*/
+template <typename T>
+class Matrix3DView {
+
+public:
+
+	typedef std::size_t size_type; ///< type of the extents and of the indexes of the cells
+	typedef std::ptrdiff_t difference_type; ///< type of the strides and of the distance between two cells
+
+private:
+
+	T* _origin; ///< pointer to the (0, 0, 0) cell of the view inside the parent array
+
+	size_type _floors; ///< number of floors of the view
+	size_type _rows; ///< number of rows of the view
+	size_type _columns; ///< number of columns of the view
+
+	difference_type _floor_stride; ///< distance in cells between two consecutive floors of the parent
+	difference_type _row_stride; ///< distance in cells between two consecutive rows of the parent
+	difference_type _column_stride; ///< distance in cells between two consecutive columns of the parent
+
+public:
+
+	typedef typename std::remove_const<T>::type value_type;
+
+	/**
+	    @brief Default constructor
+
+	    Creates an empty view, referring to no cell.
+
+	    @post _origin == nullptr
+	    @post _floors == 0
+	    @post _rows == 0
+	    @post _column == 0
+	*/
+	Matrix3DView() : _origin(nullptr), _floors(0), _rows(0), _columns(0), _floor_stride(0), _row_stride(0), _column_stride(0) {}
+
+	/**
+	    @brief Secondary constructor
+
+	    Creates a view given its origin, its extents and the strides 
+	    of the array it refers to.
+
+	    @param origin pointer to the first cell of the view
+	    @param z number of floors of the view
+	    @param y number of rows of the view
+	    @param x number of columns of the view
+	    @param floor_stride distance in cells between two consecutive floors
+	    @param row_stride distance in cells between two consecutive rows
+	    @param column_stride distance in cells between two consecutive columns
+	*/
+	Matrix3DView(T *origin, size_type z, size_type y, size_type x,
+		difference_type floor_stride, difference_type row_stride, difference_type column_stride = 1) :
+		_origin(origin), _floors(z), _rows(y), _columns(x),
+		_floor_stride(floor_stride), _row_stride(row_stride), _column_stride(column_stride) {}
+
+	/**
+	    @brief Conversion to a read-only view
+
+	    Allows to pass a Matrix3DView<T> where a Matrix3DView<const T> is expected.
+	*/
+	operator Matrix3DView<const T>() const {
+		return Matrix3DView<const T>(_origin, _floors, _rows, _columns, _floor_stride, _row_stride, _column_stride);
+	}
+
+	size_type getFloors() const {
+		return _floors;
+	}
+
+	size_type getRows() const {
+		return _rows;
+	}
+
+	size_type getColumns() const {
+		return _columns;
+	}
+
+	difference_type getFloorStride() const {
+		return _floor_stride;
+	}
+
+	difference_type getRowStride() const {
+		return _row_stride;
+	}
+
+	difference_type getColumnStride() const {
+		return _column_stride;
+	}
+
+	/**
+	    @brief Getter/Setter of the (z, y, x)-th cell
+
+	    Method that allows to access the (z, y, x)-th cell of the view, 
+	    that is the cell of the parent matrix at the same offset from the origin.
+
+	    @param z floor index of the view in which the cell is located
+	    @param y row index of the view where the cell is located
+	    @param x column index of the view where the cell is located
+
+	    @return reference to the (z, y, x)-th cell of the view
+
+	    @pre z < _floors && y < _rows && x < _columns
+	*/
+	T& operator()(size_type z, size_type y, size_type x) const {
+		assert(z < _floors && y < _rows && x < _columns);
+		return _origin[(difference_type(z) * _floor_stride) + (difference_type(y) * _row_stride) + (difference_type(x) * _column_stride)];
+	}
+
+	/**
+	    @brief view method
+
+	    Method that returns a view of a sub-region of this view, in O(1).
+
+	    @pre z1 <= z2 < _floors && y1 <= y2 < _rows && x1 <= x2 < _columns
+	*/
+	Matrix3DView view(size_type z1, size_type z2, size_type y1, size_type y2, size_type x1, size_type x2) const {
+		assert(z1 < _floors && z2 < _floors && y1 < _rows && y2 < _rows && x1 < _columns && x2 < _columns);
+		assert(z2 >= z1 && y2 >= y1 && x2 >= x1);
+		return Matrix3DView(&(*this)(z1, y1, x1), z2-z1+1, y2-y1+1, x2-x1+1, _floor_stride, _row_stride, _column_stride);
+	}
+
+	/**
+	    @brief materialize method
+
+	    Copies the cells of the view into a newly allocated, independent Matrix3D. 
+	    This is the only operation of the view which allocates memory.
+
+	    @param alloc allocator of the new matrix (optional)
+
+	    @return a Matrix3D containing a copy of the cells of the view
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	template <typename F = default_functor<value_type>, typename Alloc = std::allocator<value_type>>
+	Matrix3D<value_type, F, Alloc> materialize(const Alloc &alloc = Alloc()) const {
+
+		if(_floors == 0)
+			return Matrix3D<value_type, F, Alloc>(alloc);
+
+		Matrix3D<value_type, F, Alloc> materialized(uninitialized, _floors, _rows, _columns, alloc);
+
+		typename Matrix3D<value_type, F, Alloc>::iterator out = materialized.begin();
+		for(size_type z = 0; z < _floors; ++z)
+			for(size_type y = 0; y < _rows; ++y) {
+				const T *row = _origin + (difference_type(z) * _floor_stride) + (difference_type(y) * _row_stride);
+				if(_column_stride == 1)
+					out = std::copy(row, row + _columns, out);
+				else
+					for(size_type x = 0; x < _columns; ++x, ++out)
+						*out = row[difference_type(x) * _column_stride];
+			}
+
+		return materialized;
+	}
+
+	/**
+	    @brief Equality operator
+
+	    Checks that two views having the same extents refer to cells 
+	    containing the same values, compared through the == operator of T.
+
+	    @param other view to compare
+
+	    @return true if the views are equal, false otherwise
+
+	    @pre _floors == other._floors && _rows == other._rows && _columns == other._columns
+	*/
+	template <typename U>
+	bool operator==(const Matrix3DView<U> &other) const {
+
+		assert(_floors == other.getFloors() && _rows == other.getRows() && _columns == other.getColumns());
+
+		for(size_type z = 0; z < _floors; ++z)
+			for(size_type y = 0; y < _rows; ++y)
+				for(size_type x = 0; x < _columns; ++x)
+					if(!((*this)(z, y, x) == other(z, y, x)))
+						return false;
+
+		return true;
+	}
+
+	template <typename U>
+	bool operator!=(const Matrix3DView<U> &other) const {
+		return !((*this) == other);
+	}
+
+	/**
+	    @brief Iterator on the cells of a view
+
+	    Random access iterator visiting the cells of the view in the same 
+	    (z, y, x) order as the iterators of Matrix3D. 
+	    Incrementing it only adds strides to a pointer; random jumps 
+	    recompute the position from the linear index. 
+	    The iterator keeps a copy of the geometry of the view, so it stays 
+	    valid as long as the parent matrix does.
+	*/
+	class iterator {
+
+	public:
+
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef typename std::remove_const<T>::type value_type;
+		typedef typename Matrix3DView::difference_type difference_type;
+		typedef T* pointer;
+		typedef T& reference;
+
+	private:
+
+		T *_origin;
+		T *_cell;
+		size_type _rows, _columns;
+		difference_type _floor_stride, _row_stride, _column_stride;
+		size_type _y, _x;
+		difference_type _index;
+
+		void _seek(difference_type index) {
+			_index = index;
+			if(_rows == 0 || _columns == 0) {
+				_cell = _origin;
+				_y = _x = 0;
+				return;
+			}
+			const difference_type floor_size = difference_type(_rows * _columns);
+			const difference_type z = index / floor_size;
+			const difference_type rest = index % floor_size;
+			_y = size_type(rest) / _columns;
+			_x = size_type(rest) % _columns;
+			_cell = _origin + (z * _floor_stride) + (difference_type(_y) * _row_stride) + (difference_type(_x) * _column_stride);
+		}
+
+	public:
+
+		iterator() : _origin(nullptr), _cell(nullptr), _rows(0), _columns(0), _floor_stride(0), _row_stride(0), _column_stride(0), _y(0), _x(0), _index(0) {}
+
+		iterator(const Matrix3DView &view, difference_type index) : _origin(view._origin), _cell(nullptr), 
+			_rows(view._rows), _columns(view._columns), 
+			_floor_stride(view._floor_stride), _row_stride(view._row_stride), _column_stride(view._column_stride) {
+			_seek(index);
+		}
+
+		reference operator*() const {
+			return *_cell;
+		}
+
+		pointer operator->() const {
+			return _cell;
+		}
+
+		reference operator[](difference_type n) const {
+			return *(*this + n);
+		}
+
+		iterator &operator++() {
+			++_index;
+			_cell += _column_stride;
+			if(++_x == _columns) {
+				_x = 0;
+				_cell += _row_stride - (difference_type(_columns) * _column_stride);
+				if(++_y == _rows) {
+					_y = 0;
+					_cell += _floor_stride - (difference_type(_rows) * _row_stride);
+				}
+			}
+			return *this;
+		}
+
+		iterator operator++(int) {
+			iterator tmp(*this);
+			++(*this);
+			return tmp;
+		}
+
+		iterator &operator--() {
+			_seek(_index - 1);
+			return *this;
+		}
+
+		iterator operator--(int) {
+			iterator tmp(*this);
+			--(*this);
+			return tmp;
+		}
+
+		iterator &operator+=(difference_type n) {
+			_seek(_index + n);
+			return *this;
+		}
+
+		iterator &operator-=(difference_type n) {
+			_seek(_index - n);
+			return *this;
+		}
+
+		iterator operator+(difference_type n) const {
+			iterator tmp(*this);
+			return tmp += n;
+		}
+
+		friend iterator operator+(difference_type n, const iterator &it) {
+			return it + n;
+		}
+
+		iterator operator-(difference_type n) const {
+			iterator tmp(*this);
+			return tmp -= n;
+		}
+
+		difference_type operator-(const iterator &other) const {
+			return _index - other._index;
+		}
+
+		bool operator==(const iterator &other) const {
+			return _index == other._index;
+		}
+
+		bool operator!=(const iterator &other) const {
+			return _index != other._index;
+		}
+
+		bool operator<(const iterator &other) const {
+			return _index < other._index;
+		}
+
+		bool operator>(const iterator &other) const {
+			return _index > other._index;
+		}
+
+		bool operator<=(const iterator &other) const {
+			return _index <= other._index;
+		}
+
+		bool operator>=(const iterator &other) const {
+			return _index >= other._index;
+		}
+	};
+
+	typedef iterator const_iterator;
+
+	// Return the iterator to the first cell of the view
+	iterator begin() const {
+		return iterator(*this, 0);
+	}
+
+	// Return the iterator following the last cell of the view
+	iterator end() const {
+		return iterator(*this, difference_type(_floors * _rows * _columns));
+	}
+
+	/**
+	    @brief stream operator redefinition
+
+	    Writes the cells of the view to an output stream, 
+	    in the same format used for Matrix3D, and through the same 
+	    buffered writer when the cells are arithmetic and the stream 
+	    is in its default state.
+	*/
+	friend std::ostream &operator<<(std::ostream &os, const Matrix3DView &v) {
+
+		if constexpr (matrix3d_fast_text<typename std::remove_const<T>::type>::value) {
+			if(matrix3d_text_writer::is_plain(os)) {
+				std::ostream::sentry ok(os);
+				if(ok) {
+					matrix3d_text_writer w(os);
+					w.put_matrix(v);
+				}
+				return os;
+			}
+		}
+
+		os << "rows: " << v._rows << '\n';
+		os << "columns: " << v._columns << '\n';
+		os << "floors: " << v._floors << '\n';
+
+		os << "matrix: " << '\n';
+
+		for(size_type z = 0; z < v._floors; ++z) {
+
+			os << z+1 << "° floor: " << z << '\n';
+
+			for(size_type y = 0; y < v._rows; ++y) {
+
+				for(size_type x = 0; x < v._columns; ++x)
+					os << v(z, y, x) << " ";
+
+				os << '\n';
+			}
+
+			os << '\n';
+		}
+
+		return os;
+	}
+
+};
+
+/**
+  @brief Leaf of an expression referring to the cells of a Matrix3D
+
+  Stores the address of the array and the dimensions of a Matrix3D 
+  taking part in an expression, which must therefore outlive it.
+*/
+template <typename T, typename Layout>
+class Matrix3DOperand {
+
+	const T *_cells; ///< pointer to the first cell of the matrix
+	std::size_t _floors; ///< number of floors of the matrix
+	std::size_t _rows; ///< number of rows of the matrix
+	std::size_t _columns; ///< number of columns of the matrix
+
+public:
+
+	typedef T value_type;
+	typedef Layout layout_type;
+	static const bool is_scalar = false;
+
+	template <typename F, typename Alloc>
+	explicit Matrix3DOperand(const Matrix3D<T, F, Alloc, Layout> &m) : 
+		_cells(m.begin()), _floors(m.getFloors()), _rows(m.getRows()), _columns(m.getColumns()) {}
+
+	const T &operator[](std::size_t i) const {
+		return _cells[i];
+	}
+
+	std::size_t getFloors() const {
+		return _floors;
+	}
+
+	std::size_t getRows() const {
+		return _rows;
+	}
+
+	std::size_t getColumns() const {
+		return _columns;
+	}
+};
+
+/**
+  @brief Leaf of an expression broadcasting a scalar
+
+  Behaves as a matrix having the same value in all its cells, 
+  and the dimensions of the other operand.
+*/
+template <typename S>
+class Matrix3DScalar {
+
+	S _value; ///< broadcast value
+
+public:
+
+	typedef S value_type;
+	typedef void layout_type;
+	static const bool is_scalar = true;
+
+	explicit Matrix3DScalar(const S &value) : _value(value) {}
+
+	const S &operator[](std::size_t) const {
+		return _value;
+	}
+
+	std::size_t getFloors() const {
+		return 0;
+	}
+
+	std::size_t getRows() const {
+		return 0;
+	}
+
+	std::size_t getColumns() const {
+		return 0;
+	}
+};
+
+/**
+  @brief Elementwise binary expression
+
+  Node of an expression applying Op to the corresponding cells of its 
+  two operands. No cell is computed until the expression is assigned 
+  to a Matrix3D, which then evaluates the whole tree in a single pass.
+*/
+template <typename Op, typename L, typename R>
+class Matrix3DBinaryExpression {
+
+	L _left; ///< left operand
+	R _right; ///< right operand
+	Op _op; ///< operation applied to the cells
+
+public:
+
+	typedef decltype(std::declval<Op>()(std::declval<typename L::value_type>(), std::declval<typename R::value_type>())) value_type;
+	typedef typename matrix3d_common_layout<typename L::layout_type, typename R::layout_type>::type layout_type;
+	static const bool is_scalar = false;
+
+	Matrix3DBinaryExpression(const L &left, const R &right) : _left(left), _right(right) {
+		assert(L::is_scalar || R::is_scalar || 
+			(left.getFloors() == right.getFloors() && left.getRows() == right.getRows() && left.getColumns() == right.getColumns()));
+	}
+
+	value_type operator[](std::size_t i) const {
+		return _op(_left[i], _right[i]);
+	}
+
+	std::size_t getFloors() const {
+		return L::is_scalar ? _right.getFloors() : _left.getFloors();
+	}
+
+	std::size_t getRows() const {
+		return L::is_scalar ? _right.getRows() : _left.getRows();
+	}
+
+	std::size_t getColumns() const {
+		return L::is_scalar ? _right.getColumns() : _left.getColumns();
+	}
+};
+
+/**
+  @brief Elementwise unary expression
+
+  Node of an expression applying Op to each cell of its operand.
+*/
+template <typename Op, typename E>
+class Matrix3DUnaryExpression {
+
+	E _operand; ///< operand
+	Op _op; ///< operation applied to the cells
+
+public:
+
+	typedef decltype(std::declval<Op>()(std::declval<typename E::value_type>())) value_type;
+	typedef typename E::layout_type layout_type;
+	static const bool is_scalar = false;
+
+	explicit Matrix3DUnaryExpression(const E &operand) : _operand(operand) {}
+
+	value_type operator[](std::size_t i) const {
+		return _op(_operand[i]);
+	}
+
+	std::size_t getFloors() const {
+		return _operand.getFloors();
+	}
+
+	std::size_t getRows() const {
+		return _operand.getRows();
+	}
+
+	std::size_t getColumns() const {
+		return _operand.getColumns();
+	}
+};
+
+/**
+  @brief Elementwise selection expression
+
+  Node of an expression taking, for each cell, the value of the second 
+  operand where the condition holds and the value of the third one elsewhere.
+*/
+template <typename C, typename A, typename B>
+class Matrix3DWhereExpression {
+
+	C _condition; ///< condition
+	A _then; ///< values taken where the condition holds
+	B _else; ///< values taken where the condition does not hold
+
+public:
+
+	typedef typename std::common_type<typename A::value_type, typename B::value_type>::type value_type;
+	typedef typename matrix3d_common_layout<typename C::layout_type, 
+		typename matrix3d_common_layout<typename A::layout_type, typename B::layout_type>::type>::type layout_type;
+	static const bool is_scalar = false;
+
+	Matrix3DWhereExpression(const C &condition, const A &then_values, const B &else_values) : 
+		_condition(condition), _then(then_values), _else(else_values) {
+		assert(A::is_scalar || (then_values.getFloors() == condition.getFloors() && 
+			then_values.getRows() == condition.getRows() && then_values.getColumns() == condition.getColumns()));
+		assert(B::is_scalar || (else_values.getFloors() == condition.getFloors() && 
+			else_values.getRows() == condition.getRows() && else_values.getColumns() == condition.getColumns()));
+	}
+
+	value_type operator[](std::size_t i) const {
+		return _condition[i] ? value_type(_then[i]) : value_type(_else[i]);
+	}
+
+	std::size_t getFloors() const {
+		return _condition.getFloors();
+	}
+
+	std::size_t getRows() const {
+		return _condition.getRows();
+	}
+
+	std::size_t getColumns() const {
+		return _condition.getColumns();
+	}
+};
+
+template <typename Op, typename L, typename R>
+struct is_matrix3d_expression<Matrix3DBinaryExpression<Op, L, R>> : std::true_type {};
+
+template <typename Op, typename E>
+struct is_matrix3d_expression<Matrix3DUnaryExpression<Op, E>> : std::true_type {};
+
+template <typename C, typename A, typename B>
+struct is_matrix3d_expression<Matrix3DWhereExpression<C, A, B>> : std::true_type {};
+
+/**
+  @brief Operand trait
+
+  Maps the type of an argument of the elementwise operators to the type 
+  of the node representing it in the expression: a Matrix3D becomes a 
+  Matrix3DOperand, an arithmetic value a Matrix3DScalar, and an expression 
+  stays itself. Types which cannot take part in an expression have no node.
+*/
+template <typename X, typename>
+struct matrix3d_operand {};
+
+template <typename T, typename F, typename Alloc, typename Layout>
+struct matrix3d_operand<Matrix3D<T, F, Alloc, Layout>> {
+	typedef Matrix3DOperand<T, Layout> type;
+	static const bool is_scalar = false;
+	static type make(const Matrix3D<T, F, Alloc, Layout> &m) {
+		return type(m);
+	}
+};
+
+template <typename E>
+struct matrix3d_operand<E, typename std::enable_if<is_matrix3d_expression<E>::value>::type> {
+	typedef E type;
+	static const bool is_scalar = false;
+	static const type &make(const E &e) {
+		return e;
+	}
+};
+
+template <typename S>
+struct matrix3d_operand<S, typename std::enable_if<std::is_arithmetic<S>::value>::type> {
+	typedef Matrix3DScalar<S> type;
+	static const bool is_scalar = true;
+	static type make(const S &s) {
+		return type(s);
+	}
+};
+
+/**
+  @brief Binary expression type
+
+  Type of the expression applying Op to L and R, defined only when both 
+  can take part in an expression and at least one of them is not a scalar, 
+  so that the elementwise operators do not capture unrelated types.
+*/
+template <typename Op, typename L, typename R, typename = void>
+struct matrix3d_binary {};
+
+template <typename Op, typename L, typename R>
+struct matrix3d_binary<Op, L, R, typename std::enable_if<
+	!(matrix3d_operand<L>::is_scalar && matrix3d_operand<R>::is_scalar)>::type> {
+	typedef Matrix3DBinaryExpression<Op, typename matrix3d_operand<L>::type, typename matrix3d_operand<R>::type> type;
+	static type make(const L &l, const R &r) {
+		return type(matrix3d_operand<L>::make(l), matrix3d_operand<R>::make(r));
+	}
+};
+
+// Elementwise sum
+template <typename L, typename R>
+typename matrix3d_binary<std::plus<>, L, R>::type operator+(const L &l, const R &r) {
+	return matrix3d_binary<std::plus<>, L, R>::make(l, r);
+}
+
+// Elementwise difference
+template <typename L, typename R>
+typename matrix3d_binary<std::minus<>, L, R>::type operator-(const L &l, const R &r) {
+	return matrix3d_binary<std::minus<>, L, R>::make(l, r);
+}
+
+// Elementwise product
+template <typename L, typename R>
+typename matrix3d_binary<std::multiplies<>, L, R>::type operator*(const L &l, const R &r) {
+	return matrix3d_binary<std::multiplies<>, L, R>::make(l, r);
+}
+
+// Elementwise quotient
+template <typename L, typename R>
+typename matrix3d_binary<std::divides<>, L, R>::type operator/(const L &l, const R &r) {
+	return matrix3d_binary<std::divides<>, L, R>::make(l, r);
+}
+
+// Elementwise comparison (<), giving a matrix of bool
+template <typename L, typename R>
+typename matrix3d_binary<std::less<>, L, R>::type operator<(const L &l, const R &r) {
+	return matrix3d_binary<std::less<>, L, R>::make(l, r);
+}
+
+// Elementwise comparison (>), giving a matrix of bool
+template <typename L, typename R>
+typename matrix3d_binary<std::greater<>, L, R>::type operator>(const L &l, const R &r) {
+	return matrix3d_binary<std::greater<>, L, R>::make(l, r);
+}
+
+// Elementwise comparison (<=), giving a matrix of bool
+template <typename L, typename R>
+typename matrix3d_binary<std::less_equal<>, L, R>::type operator<=(const L &l, const R &r) {
+	return matrix3d_binary<std::less_equal<>, L, R>::make(l, r);
+}
+
+// Elementwise comparison (>=), giving a matrix of bool
+template <typename L, typename R>
+typename matrix3d_binary<std::greater_equal<>, L, R>::type operator>=(const L &l, const R &r) {
+	return matrix3d_binary<std::greater_equal<>, L, R>::make(l, r);
+}
+
+/**
+    @brief Elementwise equality
+
+    Since operator== compares two whole matrixes, giving a single bool, 
+    the elementwise equality of cells, giving a matrix of bool, is a 
+    named function.
+*/
+template <typename L, typename R>
+typename matrix3d_binary<std::equal_to<>, L, R>::type elementwise_equal(const L &l, const R &r) {
+	return matrix3d_binary<std::equal_to<>, L, R>::make(l, r);
+}
+
+// Elementwise inequality, giving a matrix of bool (see elementwise_equal)
+template <typename L, typename R>
+typename matrix3d_binary<std::not_equal_to<>, L, R>::type elementwise_not_equal(const L &l, const R &r) {
+	return matrix3d_binary<std::not_equal_to<>, L, R>::make(l, r);
+}
+
+// Elementwise negation
+template <typename E>
+Matrix3DUnaryExpression<std::negate<>, typename matrix3d_operand<E>::type> operator-(const E &e) {
+	return Matrix3DUnaryExpression<std::negate<>, typename matrix3d_operand<E>::type>(matrix3d_operand<E>::make(e));
+}
+
+/**
+    @brief Global function where
+
+    Builds the expression selecting, cell by cell, the value of then_values 
+    where condition holds and the value of else_values elsewhere. 
+    Both then_values and else_values can be matrixes, expressions or scalars.
+
+    @param condition matrix or expression convertible to bool, giving the dimensions
+    @param then_values values taken where the condition holds
+    @param else_values values taken where the condition does not hold
+
+    @return the selection expression
+*/
+template <typename C, typename A, typename B>
+Matrix3DWhereExpression<typename matrix3d_operand<C>::type, typename matrix3d_operand<A>::type, typename matrix3d_operand<B>::type> 
+where(const C &condition, const A &then_values, const B &else_values) {
+	static_assert(!matrix3d_operand<C>::is_scalar, "the condition of where() must be a matrix or an expression");
+	return Matrix3DWhereExpression<typename matrix3d_operand<C>::type, typename matrix3d_operand<A>::type, typename matrix3d_operand<B>::type>(
+		matrix3d_operand<C>::make(condition), matrix3d_operand<A>::make(then_values), matrix3d_operand<B>::make(else_values));
+}
+
+/**
+    @brief Global function transform
+
+    Generic function that allows to obtain, starting from a passed Matrix3D, 
+    a new matrix on whose elements a specific functor, also passed, has been applied. 
+    The type T of the return 3D Matrix, normally the one returned by the passed functor, 
+    must be specified by the caller.
+	It is also possible to specify the type of functor H used for the equality operator 
+	of the return matrix.
+
+    @param A the starting 3D matrix
+    @param functor the functor to apply to the data in the cells of the 3D array
+
+    @return the 3D matrix obtained by applying the functor to the data of the starting matrix, 
+    allocated with the allocator of A rebound to Q
+*/
+template <typename Q, typename F, typename H = default_functor<Q>, typename G, typename T, typename Alloc, typename L>
+Matrix3D<Q, H, typename std::allocator_traits<Alloc>::template rebind_alloc<Q>, L> trasform(const Matrix3D<T, G, Alloc, L> &A) {
+
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Q> B_allocator;
+
+	Matrix3D<Q, H, B_allocator, L> B(uninitialized, A.getFloors(), A.getRows(), A.getColumns(), B_allocator(A.get_allocator()));
+
+	F functor;
+
+	typename Matrix3D<Q, H, B_allocator, L>::iterator out = B.begin();
+	for (typename Matrix3D<T, G, Alloc, L>::const_iterator i = A.begin(); i != A.end(); ++i, ++out)
+		*out = functor(*i);
+
+	return B;
+}
+
+/**
+    @brief Global function transform (parallel)
+
+    Same as the transform function, but the cells are split in contiguous 
+    blocks which are processed in parallel by the threads of the passed pool. 
+    Every block default-constructs its own functor of type F, 
+    so the functor is never shared between threads.
+
+    @param A the starting 3D matrix
+    @param pool the pool of threads running the transformation
+
+    @return the 3D matrix obtained by applying the functor to the data of the starting matrix
+*/
+template <typename Q, typename F, typename H = default_functor<Q>, typename G, typename T, typename Alloc, typename L>
+Matrix3D<Q, H, typename std::allocator_traits<Alloc>::template rebind_alloc<Q>, L> trasform(const Matrix3D<T, G, Alloc, L> &A, Matrix3DThreadPool &pool) {
+
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Q> B_allocator;
+
+	Matrix3D<Q, H, B_allocator, L> B(uninitialized, A.getFloors(), A.getRows(), A.getColumns(), B_allocator(A.get_allocator()));
+
+	const T *in = A.begin();
+	Q *out = B.begin();
+
+	pool.parallel_for(0, A.size(), [in, out](std::size_t first, std::size_t last) {
+		F functor;
+		for (std::size_t i = first; i < last; ++i)
+			out[i] = functor(in[i]);
+	}, trasform_grain);
+
+	return B;
+}
+
+/**
+    @brief Global function transform (functor object)
+
+    Same as the transform function, but the functor is passed as an object 
+    instead of being default-constructed, so that stateful functors and 
+    lambdas can be used. The cells are transformed in order, on the calling thread.
+
+    @param A the starting 3D matrix
+    @param functor the functor to apply to the data in the cells of the 3D array
+
+    @return the 3D matrix obtained by applying the functor to the data of the starting matrix
+*/
+template <typename Q, typename H = default_functor<Q>, typename G, typename T, typename Alloc, typename L, typename Fn, 
+	typename = typename std::enable_if<std::is_invocable<Fn&, const T&>::value>::type>
+Matrix3D<Q, H, typename std::allocator_traits<Alloc>::template rebind_alloc<Q>, L> trasform(const Matrix3D<T, G, Alloc, L> &A, Fn functor) {
+
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Q> B_allocator;
+
+	Matrix3D<Q, H, B_allocator, L> B(uninitialized, A.getFloors(), A.getRows(), A.getColumns(), B_allocator(A.get_allocator()));
+
+	typename Matrix3D<Q, H, B_allocator, L>::iterator out = B.begin();
+	for (typename Matrix3D<T, G, Alloc, L>::const_iterator i = A.begin(); i != A.end(); ++i, ++out)
+		*out = functor(*i);
+
+	return B;
+}
+
+/**
+    @brief Global function transform (functor object, parallel)
+
+    Same as the transform function taking a functor object, but the cells 
+    are split in contiguous blocks processed in parallel by the threads 
+    of the passed pool. Every block works on its own copy of the functor, 
+    so a stateful functor must be copyable, and its state is not shared 
+    between the blocks.
+
+    @param A the starting 3D matrix
+    @param functor the functor to apply to the data in the cells of the 3D array
+    @param pool the pool of threads running the transformation
+
+    @return the 3D matrix obtained by applying the functor to the data of the starting matrix
+*/
+template <typename Q, typename H = default_functor<Q>, typename G, typename T, typename Alloc, typename L, typename Fn, 
+	typename = typename std::enable_if<std::is_invocable<Fn&, const T&>::value>::type>
+Matrix3D<Q, H, typename std::allocator_traits<Alloc>::template rebind_alloc<Q>, L> trasform(const Matrix3D<T, G, Alloc, L> &A, const Fn &functor, Matrix3DThreadPool &pool) {
+
+	typedef typename std::allocator_traits<Alloc>::template rebind_alloc<Q> B_allocator;
+
+	Matrix3D<Q, H, B_allocator, L> B(uninitialized, A.getFloors(), A.getRows(), A.getColumns(), B_allocator(A.get_allocator()));
+
+	const T *in = A.begin();
+	Q *out = B.begin();
+
+	pool.parallel_for(0, A.size(), [in, out, &functor](std::size_t first, std::size_t last) {
+		Fn block_functor(functor);
+		for (std::size_t i = first; i < last; ++i)
+			out[i] = block_functor(in[i]);
+	}, trasform_grain);
+
+	return B;
+}
+
+/**
+    @brief Global function transform (view)
+
+    Same as the transform function on a Matrix3D, but applied to the cells 
+    of a Matrix3DView. Only the returned matrix is allocated.
+
+    @param A the view on the starting cells
+    @param functor the functor to apply to the data in the cells of the view
+
+    @return the 3D matrix obtained by applying the functor to the data of the view
+*/
+template <typename Q, typename F, typename H = default_functor<Q>, typename T>
+Matrix3D<Q, H> trasform(const Matrix3DView<T> &A) {
+
+	if(A.getFloors() == 0)
+		return Matrix3D<Q, H>();
+
+	Matrix3D<Q, H> B(uninitialized, A.getFloors(), A.getRows(), A.getColumns());
+
+	F functor;
+
+	typename Matrix3D<Q, H>::iterator out = B.begin();
+	for (typename Matrix3DView<T>::iterator i = A.begin(); i != A.end(); ++i, ++out)
+		*out = functor(*i);
+
+	return B;
+}
+
+/**
+    @brief Block of a zip transform
+
+    Computes out[i] = functor(in[i]...) for i in [first, last), walking the 
+    arrays of the output and of the inputs in a single linear pass that the 
+    compiler can vectorize. The output may be one of the inputs.
+
+    @param out array of the output cells
+    @param first first index of the block
+    @param last index following the last one of the block
+    @param functor the functor combining the cells of the inputs
+    @param in arrays of the input cells
+*/
+template <typename Q, typename Fn, typename... Ts>
+void zip_transform_block(Q *out, std::size_t first, std::size_t last, Fn &functor, const Ts *... in) {
+	for (std::size_t i = first; i < last; ++i)
+		out[i] = functor(in[i]...);
+}
+
+/**
+    @brief Global function zip transform
+
+    Computes, into the caller-provided matrix out, the cell by cell 
+    combination of one or more input matrixes with the same dimensions: 
+    out(z, y, x) = functor(A(z, y, x), B(z, y, x), ...), as in 
+    zip_transform(out, [](float a, float b, bool m) { return m ? a + b : 0.f; }, A, B, mask). 
+    Nothing is allocated. When the inputs have the layout of out, the arrays 
+    are walked in a single linear pass; otherwise the cells are visited 
+    through their coordinates. out may also be one of the inputs.
+
+    @param out the matrix receiving the results
+    @param functor the functor combining the cells of the inputs
+    @param inputs the input matrixes
+
+    @pre all the inputs have the dimensions of out
+*/
+template <typename Q, typename H, typename B, typename L, typename Fn, typename... Ms>
+void zip_transform(Matrix3D<Q, H, B, L> &out, Fn functor, const Ms &... inputs) {
+
+	static_assert(sizeof...(Ms) > 0, "zip_transform needs at least an input matrix");
+	assert(((inputs.getFloors() == out.getFloors() && inputs.getRows() == out.getRows() && inputs.getColumns() == out.getColumns()) && ...));
+
+	if constexpr ((std::is_same<typename Ms::layout_type, L>::value && ...)) {
+		zip_transform_block(out.begin(), 0, out.size(), functor, inputs.begin()...);
+	}
+	else {
+		for (std::size_t z = 0; z < out.getFloors(); ++z)
+			for (std::size_t y = 0; y < out.getRows(); ++y)
+				for (std::size_t x = 0; x < out.getColumns(); ++x)
+					out(z, y, x) = functor(inputs(z, y, x)...);
+	}
+}
+
+/**
+    @brief Global function zip transform (parallel)
+
+    Same as the zip transform function, but the cells are split in blocks 
+    processed in parallel by the threads of the passed pool (the pool comes 
+    first, since the inputs are last). Every block copies its own functor, 
+    as in the parallel transform.
+
+    @param pool the pool of threads running the transformation
+    @param out the matrix receiving the results
+    @param functor the functor combining the cells of the inputs
+    @param inputs the input matrixes
+
+    @pre all the inputs have the dimensions of out
+*/
+template <typename Q, typename H, typename B, typename L, typename Fn, typename... Ms>
+void zip_transform(Matrix3DThreadPool &pool, Matrix3D<Q, H, B, L> &out, const Fn &functor, const Ms &... inputs) {
+
+	static_assert(sizeof...(Ms) > 0, "zip_transform needs at least an input matrix");
+	assert(((inputs.getFloors() == out.getFloors() && inputs.getRows() == out.getRows() && inputs.getColumns() == out.getColumns()) && ...));
+
+	if constexpr ((std::is_same<typename Ms::layout_type, L>::value && ...)) {
+		Q *cells = out.begin();
+		pool.parallel_for(0, out.size(), [cells, &functor, &inputs...](std::size_t first, std::size_t last) {
+			Fn block_functor(functor);
+			zip_transform_block(cells, first, last, block_functor, inputs.begin()...);
+		}, trasform_grain);
+	}
+	else {
+		const std::size_t rows = out.getRows(), columns = out.getColumns();
+		pool.parallel_for(0, out.getFloors() * rows, [&out, &functor, &inputs..., rows, columns](std::size_t first, std::size_t last) {
+			Fn block_functor(functor);
+			for (std::size_t row = first; row < last; ++row)
+				for (std::size_t x = 0; x < columns; ++x)
+					out(row / rows, row % rows, x) = block_functor(inputs(row / rows, row % rows, x)...);
+		}, std::max<std::size_t>(1, trasform_grain / std::max<std::size_t>(columns, 1)));
+	}
+}
+
+/**
+    @brief Global function transform in place
+
+    Replaces each cell of A with the result of the functor applied to it, 
+    A(z, y, x) = functor(A(z, y, x)), in a single linear pass over the array 
+    and without allocating.
+
+    @param A the matrix to transform
+    @param functor the functor to apply to the data in the cells
+*/
+template <typename T, typename G, typename Alloc, typename L, typename Fn>
+void transform_inplace(Matrix3D<T, G, Alloc, L> &A, Fn functor) {
+	zip_transform(A, functor, A);
+}
+
+/**
+    @brief Global function transform in place (parallel)
+
+    Same as the transform in place function, on the threads of the passed pool.
+
+    @param A the matrix to transform
+    @param functor the functor to apply to the data in the cells
+    @param pool the pool of threads running the transformation
+*/
+template <typename T, typename G, typename Alloc, typename L, typename Fn>
+void transform_inplace(Matrix3D<T, G, Alloc, L> &A, const Fn &functor, Matrix3DThreadPool &pool) {
+	zip_transform(pool, A, functor, A);
+}
+
+
+/**
+  @brief Axis of a 3D matrix
+
+  Selects the dimension along which reduce() combines the cells, or 
+  the order of the dimensions given to permute_axes(): z runs over the 
+  floors, y over the rows and x over the columns.
+*/
+enum class Matrix3DAxis { z, y, x };
+
+/**
+  @brief Compensated sum
+
+  Running sum of a sequence of values which, for floating point types, 
+  keeps the rounding error of each addition in a separate term (Kahan 
+  summation), so that the error of the result does not grow with the number 
+  of values summed. Other types are summed with a plain operator+.
+  The compensation is removed by compilers allowed to reorder floating point 
+  operations (like with -ffast-math), which must not be used with it.
+*/
+template <typename S>
+struct kahan_sum {
+
+	static const std::size_t lanes = 8; ///< number of independent sums in add_run()
+
+	S sum; ///< sum of the values added, plus the compensation
+	S compensation; ///< rounding error accumulated in sum
+
+	kahan_sum() : sum(), compensation() {}
+
+	// Adds a value to the sum
+	void add(const S &value) {
+		if constexpr (std::is_floating_point<S>::value) {
+			const S y = value - compensation;
+			const S t = sum + y;
+			compensation = (t - sum) - y;
+			sum = t;
+		}
+		else
+			sum = sum + value;
+	}
+
+	/**
+	    @brief Sum of a contiguous run
+
+	    Adds n contiguous values. Floating point values are summed in lanes 
+	    independent sums, each one compensated, which the compiler can keep 
+	    in the lanes of a SIMD register, and which are added to the total 
+	    at the end of the run.
+
+	    @param first pointer to the first value
+	    @param n number of values
+	*/
+	template <typename T>
+	void add_run(const T *first, std::size_t n) {
+		std::size_t i = 0;
+		if constexpr (std::is_floating_point<S>::value) {
+			S s[lanes] = {}, c[lanes] = {};
+			for(; i + lanes <= n; i += lanes) {
+				for(std::size_t l = 0; l < lanes; ++l) {
+					const S y = static_cast<S>(first[i + l]) - c[l];
+					const S t = s[l] + y;
+					c[l] = (t - s[l]) - y;
+					s[l] = t;
+				}
+			}
+			for(std::size_t l = 0; l < lanes; ++l) {
+				add(s[l]);
+				add(-c[l]);
+			}
+		}
+		for(; i < n; ++i)
+			add(static_cast<S>(first[i]));
+	}
+
+	// Adds the values summed by another kahan_sum
+	void merge(const kahan_sum &other) {
+		add(other.sum);
+		if constexpr (std::is_floating_point<S>::value)
+			add(-other.compensation);
+	}
+
+	// Return the sum
+	S value() const {
+		if constexpr (std::is_floating_point<S>::value)
+			return sum - compensation;
+		else
+			return sum;
+	}
+};
+
+/**
+  @brief Reductions
+
+  Each type describes one of the reductions computed by reduce() and 
+  reduce_all(), through a nested accumulator<T> class which combines the 
+  cells of type T one at a time (add) or in contiguous runs (add_run), 
+  merges with the accumulator of another part of the matrix (merge) and 
+  gives the result (result). The position passed with the cells is their 
+  offset along the reduction, used by argmax_reduction.
+
+  Custom reductions can be passed to reduce() and reduce_all() by writing 
+  a type with the same interface.
+*/
+struct sum_reduction {
+	template <typename T>
+	class accumulator {
+	public:
+		/// sums of integers are done on 64 bits, floating points keep their type
+		typedef typename std::conditional<std::is_integral<T>::value, 
+			typename std::conditional<std::is_signed<T>::value, long long, unsigned long long>::type, T>::type result_type;
+
+		void add(const T &value, std::size_t) {
+			_sum.add(static_cast<result_type>(value));
+		}
+
+		void add_run(const T *first, std::size_t n, std::size_t) {
+			_sum.add_run(first, n);
+		}
+
+		void merge(const accumulator &other) {
+			_sum.merge(other._sum);
+		}
+
+		result_type result() const {
+			return _sum.value();
+		}
+
+	private:
+		kahan_sum<result_type> _sum;
+	};
+};
+
+struct min_reduction {
+	template <typename T>
+	class accumulator {
+	public:
+		typedef T result_type;
+
+		accumulator() : _min(), _empty(true) {}
+
+		void add(const T &value, std::size_t) {
+			if(_empty || value < _min)
+				_min = value;
+			_empty = false;
+		}
+
+		void add_run(const T *first, std::size_t n, std::size_t) {
+			if(n == 0)
+				return;
+			T m = _empty ? first[0] : _min;
+			for(std::size_t i = 0; i < n; ++i)
+				m = first[i] < m ? first[i] : m;
+			_min = m;
+			_empty = false;
+		}
+
+		void merge(const accumulator &other) {
+			if(!other._empty)
+				add(other._min, 0);
+		}
+
+		result_type result() const {
+			return _min;
+		}
+
+	private:
+		T _min;
+		bool _empty;
+	};
+};
+
+struct max_reduction {
+	template <typename T>
+	class accumulator {
+	public:
+		typedef T result_type;
+
+		accumulator() : _max(), _empty(true) {}
+
+		void add(const T &value, std::size_t) {
+			if(_empty || _max < value)
+				_max = value;
+			_empty = false;
+		}
+
+		void add_run(const T *first, std::size_t n, std::size_t) {
+			if(n == 0)
+				return;
+			T m = _empty ? first[0] : _max;
+			for(std::size_t i = 0; i < n; ++i)
+				m = m < first[i] ? first[i] : m;
+			_max = m;
+			_empty = false;
+		}
+
+		void merge(const accumulator &other) {
+			if(!other._empty)
+				add(other._max, 0);
+		}
+
+		result_type result() const {
+			return _max;
+		}
+
+	private:
+		T _max;
+		bool _empty;
+	};
+};
+
+struct mean_reduction {
+	template <typename T>
+	class accumulator {
+	public:
+		/// means of integers are computed as doubles, floating points keep their type
+		typedef typename std::conditional<std::is_floating_point<T>::value, T, double>::type result_type;
+
+		accumulator() : _count(0) {}
+
+		void add(const T &value, std::size_t) {
+			_sum.add(static_cast<result_type>(value));
+			++_count;
+		}
+
+		void add_run(const T *first, std::size_t n, std::size_t) {
+			_sum.add_run(first, n);
+			_count += n;
+		}
+
+		void merge(const accumulator &other) {
+			_sum.merge(other._sum);
+			_count += other._count;
+		}
+
+		result_type result() const {
+			return _sum.value() / static_cast<result_type>(_count);
+		}
+
+	private:
+		kahan_sum<result_type> _sum;
+		std::size_t _count;
+	};
+};
+
+/**
+    Population variance (the mean of the squared differences from the mean), 
+    computed with two passes over each contiguous run, and combining the 
+    runs with the parallel formula of Chan et al., which is stable 
+    even when the mean is much larger than the spread of the values.
+*/
+struct variance_reduction {
+	template <typename T>
+	class accumulator {
+	public:
+		/// variances of integers are computed as doubles, floating points keep their type
+		typedef typename std::conditional<std::is_floating_point<T>::value, T, double>::type result_type;
+
+		accumulator() : _count(0), _mean(), _m2() {}
+
+		void add(const T &value, std::size_t) {
+			const result_type v = static_cast<result_type>(value);
+			++_count;
+			const result_type delta = v - _mean;
+			_mean += delta / static_cast<result_type>(_count);
+			_m2 += delta * (v - _mean);
+		}
 
-    /**
-	    @brief Equality operator
+		void add_run(const T *first, std::size_t n, std::size_t) {
+			if(n == 0)
+				return;
+
+			kahan_sum<result_type> sum;
+			sum.add_run(first, n);
+			const result_type mean = sum.value() / static_cast<result_type>(n);
+
+			const std::size_t lanes = kahan_sum<result_type>::lanes;
+			result_type squares[lanes] = {};
+			std::size_t i = 0;
+			for(; i + lanes <= n; i += lanes) {
+				for(std::size_t l = 0; l < lanes; ++l) {
+					const result_type d = static_cast<result_type>(first[i + l]) - mean;
+					squares[l] += d * d;
+				}
+			}
+			result_type m2 = result_type();
+			for(std::size_t l = 0; l < lanes; ++l)
+				m2 += squares[l];
+			for(; i < n; ++i) {
+				const result_type d = static_cast<result_type>(first[i]) - mean;
+				m2 += d * d;
+			}
+
+			_combine(n, mean, m2);
+		}
 
-	    The equality operator is used to check that two Matrices 3D having the same dimensions 
-	    are equal and therefore contain the same values in all the corresponding cells.
-		For the comparison, the _equals functor is used, a member functor whose type can be 
-		defined when creating the matrix for greater flexibility.
-		If not defined, the default functor uses the == operator and it is therefore necessary 
-		that any custom data types redefine it in turn.
+		void merge(const accumulator &other) {
+			if(other._count > 0)
+				_combine(other._count, other._mean, other._m2);
+		}
 
-	    @param other source Matrix3D to compare
+		result_type result() const {
+			return _m2 / static_cast<result_type>(_count);
+		}
 
-	    @return true if the matrixes are equal, false otherwise
+	private:
+		std::size_t _count;
+		result_type _mean;
+		result_type _m2; ///< sum of the squared differences from the mean
+
+		// Adds the statistics of n values with the given mean and m2
+		void _combine(std::size_t n, result_type mean, result_type m2) {
+			const std::size_t count = _count + n;
+			const result_type delta = mean - _mean;
+			const result_type weight = static_cast<result_type>(n) / static_cast<result_type>(count);
+			_mean += delta * weight;
+			_m2 += m2 + delta * delta * static_cast<result_type>(_count) * weight;
+			_count = count;
+		}
+	};
+};
 
-	    @pre _floors == other._floors && _rows == other._rows && _columns == other._columns
-	*/
-    bool operator==(const Matrix3D &other) const {
+/**
+    Position of the largest value; when the largest value appears more 
+    than once, the first position is returned.
+*/
+struct argmax_reduction {
+	template <typename T>
+	class accumulator {
+	public:
+		typedef std::size_t result_type;
+
+		accumulator() : _max(), _position(0), _empty(true) {}
+
+		void add(const T &value, std::size_t position) {
+			if(_empty || _max < value || (!(value < _max) && position < _position)) {
+				_max = value;
+				_position = position;
+			}
+			_empty = false;
+		}
 
-    	assert(_floors == other._floors && _rows == other._rows && _columns == other._columns);
+		void add_run(const T *first, std::size_t n, std::size_t position) {
+			if(n == 0)
+				return;
+			std::size_t best = 0;
+			for(std::size_t i = 1; i < n; ++i)
+				if(first[best] < first[i])
+					best = i;
+			add(first[best], position + best);
+		}
 
-    	if(this != &other) {
-    		for(unsigned int z = 0; z < _floors; ++z)
-	        	for(unsigned int y = 0; y < _rows; ++y) 
-	        		for(unsigned int x = 0; x < _columns; ++x)
-	        			if(!(_equals(other(z, y, x), (*this)(z, y, x))))
-	        				return false;
-    	}    	
+		void merge(const accumulator &other) {
+			if(!other._empty)
+				add(other._max, other._position);
+		}
 
-        return true;
-        			
-    }
+		result_type result() const {
+			return _position;
+		}
 
-    /**
-	    @brief Inequality operator
+	private:
+		T _max;
+		std::size_t _position;
+		bool _empty;
+	};
+};
 
-	    The inequality operator is used to check that two Matrices 3D having the same 
-	    dimensions are different and therefore contain different values even in only 
-	    some corresponding cells.
-		Use the equality operator and return the opposite boolean value.
+/**
+    Number of cells reduced by each partial accumulator of reduce_all(). 
+    It does not depend on the number of threads, so that the sequential and 
+    parallel reductions add the same values in the same order, and return 
+    exactly the same result.
+*/
+const std::size_t reduction_block = 16384;
 
-	    @param other source Matrix3D to compare
+/**
+    @brief Full reduction (implementation)
 
-	    @return true if the matrixes are equal, false otherwise
-	*/
-    bool operator!=(const Matrix3D &other) const {
+    Reduces the array of A in blocks of reduction_block cells, each one into 
+    its own accumulator, running them on the threads of pool if not null, 
+    and merges the accumulators in order.
+*/
+template <typename Op, typename T, typename G, typename Alloc, typename L>
+typename Op::template accumulator<T> reduce_all_blocks(const Matrix3D<T, G, Alloc, L> &A, Matrix3DThreadPool *pool) {
 
-        return !((*this) == other);
-        			
-    }
+	typedef typename Op::template accumulator<T> accumulator;
 
-    // Implementation of random access iterators through the pointer trick,
-	// being the internal structure array-based.
+	const T *in = A.begin();
+	const std::size_t cells = A.size();
+	const std::size_t blocks = (cells + reduction_block - 1) / reduction_block;
 
-    typedef T *iterator;
+	std::vector<accumulator> partial(blocks);
 
-    // Return the iterator to the start of the data sequence
-	iterator begin() {
-		return _matrix;
-	}
+	auto reduce_blocks = [in, cells, &partial](std::size_t first, std::size_t last) {
+		for(std::size_t b = first; b < last; ++b) {
+			const std::size_t offset = b * reduction_block;
+			partial[b].add_run(in + offset, std::min(reduction_block, cells - offset), offset);
+		}
+	};
 
-	// Return the iterator at the end of the data sequence
-	iterator end() {
-		return _matrix + (_rows * _columns * _floors);
+	if(pool)
+		pool->parallel_for(0, blocks, reduce_blocks);
+	else
+		reduce_blocks(0, blocks);
+
+	accumulator total;
+	for(std::size_t b = 0; b < blocks; ++b)
+		total.merge(partial[b]);
+
+	return total;
+}
+
+/**
+    Type returned by reduce_all<Op>() on cells of type T: the result of the 
+    accumulator, but for argmax_reduction, which returns the position as 
+    a Matrix3DIndex.
+*/
+template <typename Op, typename T>
+using reduce_all_result = typename std::conditional<std::is_same<Op, argmax_reduction>::value, 
+	Matrix3DIndex, typename Op::template accumulator<T>::result_type>::type;
+
+template <typename Op, typename T, typename G, typename Alloc, typename L>
+reduce_all_result<Op, T> reduce_all_finish(const Matrix3D<T, G, Alloc, L> &A, const typename Op::template accumulator<T> &total) {
+	if constexpr (std::is_same<Op, argmax_reduction>::value) {
+		return L::index(total.result(), A.getFloors(), A.getRows(), A.getColumns());
 	}
+	else
+		return total.result();
+}
 
-	typedef const T *const_iterator;
+/**
+    @brief Global function reduce_all
 
-	// Return the iterator to the start of the data sequence
-	const_iterator begin() const {
-		return _matrix;
+    Combines all the cells of a 3D matrix with the reduction Op (sum_reduction, 
+    min_reduction, max_reduction, mean_reduction, variance_reduction or 
+    argmax_reduction), scanning the array as contiguous runs which are 
+    reduced with vectorizable loops. Floating point sums are compensated.
+    The matrix must not be empty for min, max and argmax.
+
+    @param A the 3D matrix to reduce
+
+    @return the result of the reduction; for argmax_reduction, the index 
+    of the first cell (in the order of iteration) holding the largest value
+*/
+template <typename Op, typename T, typename G, typename Alloc, typename L>
+reduce_all_result<Op, T> reduce_all(const Matrix3D<T, G, Alloc, L> &A) {
+	return reduce_all_finish<Op>(A, reduce_all_blocks<Op>(A, nullptr));
+}
+
+/**
+    @brief Global function reduce_all (parallel)
+
+    Same as the reduce_all function, but the blocks of the array are reduced 
+    in parallel by the threads of the passed pool. The result is exactly the 
+    same as the one of the sequential function, whatever the number of threads.
+
+    @param A the 3D matrix to reduce
+    @param pool the pool of threads running the reduction
+
+    @return the result of the reduction
+*/
+template <typename Op, typename T, typename G, typename Alloc, typename L>
+reduce_all_result<Op, T> reduce_all(const Matrix3D<T, G, Alloc, L> &A, Matrix3DThreadPool &pool) {
+	return reduce_all_finish<Op>(A, reduce_all_blocks<Op>(A, &pool));
+}
+
+/**
+    Type returned by reduce<Op>() on a matrix of cells of type T allocated by Alloc, with layout L
+*/
+template <typename Op, typename T, typename Alloc, typename L>
+using reduce_result = Matrix3D<typename Op::template accumulator<T>::result_type, 
+	default_functor<typename Op::template accumulator<T>::result_type>, 
+	typename std::allocator_traits<Alloc>::template rebind_alloc<typename Op::template accumulator<T>::result_type>, L>;
+
+/**
+    @brief Axis reduction (implementation)
+
+    Reduces A along axis, running the independent parts on the threads of 
+    pool if not null. With the row-major layout the rows are always read 
+    contiguously: along x each row is a run, along y and z the cells of a row 
+    are added to a row of accumulators, one per column. The work is split 
+    by floors, or by rows when reducing along z.
+*/
+template <typename Op, typename T, typename G, typename Alloc, typename L>
+reduce_result<Op, T, Alloc, L> reduce_axis(const Matrix3D<T, G, Alloc, L> &A, Matrix3DAxis axis, Matrix3DThreadPool *pool) {
+
+	typedef typename Op::template accumulator<T> accumulator;
+	typedef reduce_result<Op, T, Alloc, L> result_matrix;
+	typedef typename result_matrix::allocator_type R_allocator;
+
+	const std::size_t floors = A.getFloors(), rows = A.getRows(), columns = A.getColumns();
+
+	if(A.size() == 0)
+		return result_matrix(R_allocator(A.get_allocator()));
+
+	result_matrix B(axis == Matrix3DAxis::z ? 1 : floors, axis == Matrix3DAxis::y ? 1 : rows, 
+		axis == Matrix3DAxis::x ? 1 : columns, R_allocator(A.get_allocator()));
+
+	const T *in = A.begin();
+	result_matrix *out = &B;
+
+	// cell (z, y, x) of A
+	auto cell = [in, floors, rows, columns](std::size_t z, std::size_t y, std::size_t x) -> const T & {
+		return in[L::offset(z, y, x, floors, rows, columns)];
+	};
+
+	std::size_t units, unit_cells;
+	std::function<void(std::size_t, std::size_t)> reduce_units;
+
+	switch(axis) {
+	case Matrix3DAxis::x:
+		units = floors;
+		unit_cells = rows * columns;
+		reduce_units = [=](std::size_t first, std::size_t last) {
+			for(std::size_t z = first; z < last; ++z)
+				for(std::size_t y = 0; y < rows; ++y) {
+					accumulator acc;
+					if constexpr (L::is_row_major)
+						acc.add_run(&cell(z, y, 0), columns, 0);
+					else
+						for(std::size_t x = 0; x < columns; ++x)
+							acc.add(cell(z, y, x), x);
+					(*out)(z, y, 0) = acc.result();
+				}
+		};
+		break;
+	case Matrix3DAxis::y:
+		units = floors;
+		unit_cells = rows * columns;
+		reduce_units = [=](std::size_t first, std::size_t last) {
+			std::vector<accumulator> acc(columns);
+			for(std::size_t z = first; z < last; ++z) {
+				std::fill(acc.begin(), acc.end(), accumulator());
+				for(std::size_t y = 0; y < rows; ++y)
+					for(std::size_t x = 0; x < columns; ++x)
+						acc[x].add(cell(z, y, x), y);
+				for(std::size_t x = 0; x < columns; ++x)
+					(*out)(z, 0, x) = acc[x].result();
+			}
+		};
+		break;
+	default:
+		units = rows;
+		unit_cells = floors * columns;
+		reduce_units = [=](std::size_t first, std::size_t last) {
+			std::vector<accumulator> acc(columns);
+			for(std::size_t y = first; y < last; ++y) {
+				std::fill(acc.begin(), acc.end(), accumulator());
+				for(std::size_t z = 0; z < floors; ++z)
+					for(std::size_t x = 0; x < columns; ++x)
+						acc[x].add(cell(z, y, x), z);
+				for(std::size_t x = 0; x < columns; ++x)
+					(*out)(0, y, x) = acc[x].result();
+			}
+		};
 	}
-	
-	// Return the iterator at the end of the data sequence
-	const_iterator end() const {
-		return _matrix + (_rows * _columns * _floors);
+
+	if(pool)
+		pool->parallel_for(0, units, reduce_units, std::max<std::size_t>(1, trasform_grain / unit_cells));
+	else
+		reduce_units(0, units);
+
+	return B;
+}
+
+/**
+    @brief Global function reduce
+
+    Combines the cells of a 3D matrix along one axis with the reduction Op 
+    (see reduce_all), giving a matrix whose dimension along that axis is 1: 
+    reducing along z gives a plane of rows x columns cells, along x a plane 
+    of floors x rows cells. A 1D vector is obtained by reducing the result 
+    again along another axis (with an associative reduction like sum, min 
+    or max). For argmax_reduction, each cell holds the position along axis 
+    of the largest value.
+
+    @param A the 3D matrix to reduce
+    @param axis the axis along which the cells are combined
+
+    @return the 3D matrix of the results, allocated with the allocator of A 
+    rebound to the type of the results
+*/
+template <typename Op, typename T, typename G, typename Alloc, typename L>
+reduce_result<Op, T, Alloc, L> reduce(const Matrix3D<T, G, Alloc, L> &A, Matrix3DAxis axis) {
+	return reduce_axis<Op>(A, axis, nullptr);
+}
+
+/**
+    @brief Global function reduce (parallel)
+
+    Same as the reduce function, but the floors (or the rows, when reducing 
+    along z) are processed in parallel by the threads of the passed pool.
+
+    @param A the 3D matrix to reduce
+    @param axis the axis along which the cells are combined
+    @param pool the pool of threads running the reduction
+
+    @return the 3D matrix of the results
+*/
+template <typename Op, typename T, typename G, typename Alloc, typename L>
+reduce_result<Op, T, Alloc, L> reduce(const Matrix3D<T, G, Alloc, L> &A, Matrix3DAxis axis, Matrix3DThreadPool &pool) {
+	return reduce_axis<Op>(A, axis, &pool);
+}
+
+/**
+  @brief Boundary conditions of the stencils
+
+  How apply_stencil reads the cells falling outside the matrix: clamp 
+  reads the nearest cell on the edge, wrap the cell on the opposite side 
+  (periodic boundaries), and zero reads them as zero.
+*/
+enum class Matrix3DBoundary { clamp, wrap, zero };
+
+/**
+  @brief Tap of a stencil
+
+  Weight of the cell at offset (dz, dy, dx) from the one being computed.
+*/
+template <typename W>
+struct stencil_tap {
+	std::ptrdiff_t dz; ///< offset along z
+	std::ptrdiff_t dy; ///< offset along y
+	std::ptrdiff_t dx; ///< offset along x
+	W weight; ///< weight of the cell
+};
+
+/**
+  @brief Stencil kernel
+
+  List of the taps of a stencil: the value computed for a cell is the sum 
+  of the cells at the offsets of the taps, multiplied by their weights.
+  Besides adding arbitrary taps, kernels can be built for the usual 
+  7-point and 27-point stencils and from a matrix of weights.
+*/
+template <typename W>
+class stencil_kernel {
+
+	std::vector<stencil_tap<W>> _taps; ///< taps, one per offset
+
+public:
+
+	// Return the taps of the kernel
+	const std::vector<stencil_tap<W>> &taps() const {
+		return _taps;
 	}
 
 	/**
-	    @brief fill method
+	    @brief Adds a tap
 
-	    Generic method that allows to fill a Matrix3D with values taken 
-	    from a sequence of data identified by generic iterators.
-		Filling takes place in the order of iteration of the matrix data, 
-		and stops in case the matrix to be filled is no longer able to contain 
-		data but the passed sequence is not ended yet.
-		The old values are overwritten.
+	    Adds a weight to the cell at the given offset; the weights added 
+	    twice to the same offset are summed.
 
-	    @param b l'iteratore che indica l'inizio della sequenza di dati
-	    @param b l'iteratore che indica la fine della sequenza di dati
+	    @param dz offset along z
+	    @param dy offset along y
+	    @param dx offset along x
+	    @param weight weight of the cell
 	*/
-    template<typename Iter>
-    void fill(Iter b, Iter e) {
+	void add(std::ptrdiff_t dz, std::ptrdiff_t dy, std::ptrdiff_t dx, const W &weight) {
+		for(std::size_t i = 0; i < _taps.size(); ++i)
+			if(_taps[i].dz == dz && _taps[i].dy == dy && _taps[i].dx == dx) {
+				_taps[i].weight = _taps[i].weight + weight;
+				return;
+			}
+		_taps.push_back(stencil_tap<W>{dz, dy, dx, weight});
+	}
 
-    	Matrix3D tmp(*this);
+	// Return the 7-point stencil: the cell and its 6 neighbours sharing a face
+	static stencil_kernel seven_point(const W &center, const W &neighbour) {
+		stencil_kernel k;
+		k.add(0, 0, 0, center);
+		k.add(-1, 0, 0, neighbour);
+		k.add(1, 0, 0, neighbour);
+		k.add(0, -1, 0, neighbour);
+		k.add(0, 1, 0, neighbour);
+		k.add(0, 0, -1, neighbour);
+		k.add(0, 0, 1, neighbour);
+		return k;
+	}
 
-    	int i = 0;
-    	while(b != e && i != _floors * _rows * _columns){ // fills while it can
-    		tmp._matrix[i] = static_cast<T>(*b);
-    		++b;
-    		++i;
-    	}
+	// Return the 27-point stencil: the cell and its neighbours sharing a face, an edge or a corner
+	static stencil_kernel twenty_seven_point(const W &center, const W &face, const W &edge, const W &corner) {
+		stencil_kernel k;
+		for(std::ptrdiff_t dz = -1; dz <= 1; ++dz)
+			for(std::ptrdiff_t dy = -1; dy <= 1; ++dy)
+				for(std::ptrdiff_t dx = -1; dx <= 1; ++dx) {
+					const int distance = (dz != 0) + (dy != 0) + (dx != 0);
+					k.add(dz, dy, dx, distance == 0 ? center : distance == 1 ? face : distance == 2 ? edge : corner);
+				}
+		return k;
+	}
 
-    	*this = tmp;
-    }
+	/**
+	    @brief Kernel from a matrix of weights
 
-    /**
-	    @brief Conversion constructor (implicit/explicit)
+	    Builds the kernel of a convolution whose weights are the cells of 
+	    the passed matrix, centered on the cell being computed: the 
+	    dimensions must be odd. As usual with stencils the weights are 
+	    not flipped, cell (0, 0, 0) being the weight of the cell at offset 
+	    (-floors/2, -rows/2, -columns/2).
 
-	    The conversion constructor creates a Matrix3D<T, F> object from a
-		Matrix3D<U, Q> object.
-		Allows the conversion of a Matrix3D defined on one type to a Matrix3D 
-		defined on a different type (where casting is possible).
+	    @param weights the matrix of the weights
+	*/
+	template <typename G, typename Alloc, typename L>
+	static stencil_kernel from_matrix(const Matrix3D<W, G, Alloc, L> &weights) {
+		assert(weights.getFloors() % 2 == 1 && weights.getRows() % 2 == 1 && weights.getColumns() % 2 == 1);
+		const std::ptrdiff_t rz = weights.getFloors() / 2, ry = weights.getRows() / 2, rx = weights.getColumns() / 2;
+		stencil_kernel k;
+		for(std::ptrdiff_t z = -rz; z <= rz; ++z)
+			for(std::ptrdiff_t y = -ry; y <= ry; ++y)
+				for(std::ptrdiff_t x = -rx; x <= rx; ++x)
+					k.add(z, y, x, weights(z + rz, y + ry, x + rx));
+		return k;
+	}
+};
+
+/**
+    Maps the coordinate i along an axis of n cells according to the boundary 
+    condition, returning -1 for the cells which read as zero.
+*/
+inline std::ptrdiff_t stencil_coordinate(std::ptrdiff_t i, std::ptrdiff_t n, Matrix3DBoundary boundary) {
+	if(i >= 0 && i < n)
+		return i;
+	switch(boundary) {
+		case Matrix3DBoundary::clamp:
+			return i < 0 ? 0 : n - 1;
+		case Matrix3DBoundary::wrap:
+			return (i % n + n) % n;
+		default:
+			return -1;
+	}
+}
 
-	    @param other the Matrix3D of type <U, Q> from which to create the new object
+// Dimensions of the blocks of cells computed by a thread at a time
+const std::size_t stencil_block_floors = 4;
+const std::size_t stencil_block_rows = 16;
+const std::size_t stencil_block_columns = 512;
 
-	    @throw std::bad_alloc possible allocation exception
-	*/
-    template <typename U, typename Q>
-	Matrix3D(const Matrix3D<U, Q> &other) : _matrix(nullptr), _floors(other.getFloors()), _rows(other.getRows()), _columns(other.getColumns()) {
-		try {
-			_matrix = new T[other.getFloors() * other.getRows() * other.getColumns()];
-			for (unsigned int z = 0; z < _floors; ++z)
-				for (unsigned int y = 0; y < _rows; ++y)
-					for (unsigned int x = 0; x < _columns; ++x)
-						(*this)(z, y, x) = static_cast<U>(other(z, y, x));
-		}
-		catch(...) {
-			clear();
-			throw;
+/**
+    @brief Stencil (implementation)
+
+    Splits the cells of out in blocks of stencil_block_floors x 
+    stencil_block_rows x stencil_block_columns cells, small enough for the 
+    cells of A they read to stay in the cache, and computes them on the 
+    threads of pool if not null. With two row-major matrixes every tap 
+    is applied to a whole run of a row at a time, with a vectorizable loop, 
+    only the cells reading outside the matrix going through the boundary 
+    condition.
+*/
+template <typename Q, typename H, typename B, typename L2, typename T, typename G, typename Alloc, typename L, typename W>
+void apply_stencil_blocks(const Matrix3D<T, G, Alloc, L> &A, const stencil_kernel<W> &kernel, Matrix3DBoundary boundary, 
+	Matrix3D<Q, H, B, L2> &out, Matrix3DThreadPool *pool) {
+
+	assert(A.getFloors() == out.getFloors() && A.getRows() == out.getRows() && A.getColumns() == out.getColumns());
+	assert(static_cast<const void *>(A.begin()) != static_cast<const void *>(out.begin()) || A.size() == 0);
+
+	const std::ptrdiff_t floors = A.getFloors(), rows = A.getRows(), columns = A.getColumns();
+	const std::size_t blocks_z = (A.getFloors() + stencil_block_floors - 1) / stencil_block_floors;
+	const std::size_t blocks_y = (A.getRows() + stencil_block_rows - 1) / stencil_block_rows;
+	const std::size_t blocks_x = (A.getColumns() + stencil_block_columns - 1) / stencil_block_columns;
+	const std::vector<stencil_tap<W>> &taps = kernel.taps();
+
+	auto compute_blocks = [&](std::size_t first, std::size_t last) {
+		for(std::size_t b = first; b < last; ++b) {
+			const std::ptrdiff_t z1 = (b / (blocks_y * blocks_x)) * stencil_block_floors;
+			const std::ptrdiff_t y1 = (b / blocks_x % blocks_y) * stencil_block_rows;
+			const std::ptrdiff_t x1 = (b % blocks_x) * stencil_block_columns;
+			const std::ptrdiff_t z2 = std::min<std::ptrdiff_t>(z1 + stencil_block_floors, floors);
+			const std::ptrdiff_t y2 = std::min<std::ptrdiff_t>(y1 + stencil_block_rows, rows);
+			const std::ptrdiff_t x2 = std::min<std::ptrdiff_t>(x1 + stencil_block_columns, columns);
+
+			if constexpr (L::is_row_major && L2::is_row_major) {
+				for(std::ptrdiff_t z = z1; z < z2; ++z)
+					for(std::ptrdiff_t y = y1; y < y2; ++y) {
+						Q *o = out.begin() + (z * rows + y) * columns;
+						std::fill(o + x1, o + x2, Q());
+						for(std::size_t t = 0; t < taps.size(); ++t) {
+							const std::ptrdiff_t sz = stencil_coordinate(z + taps[t].dz, floors, boundary);
+							const std::ptrdiff_t sy = stencil_coordinate(y + taps[t].dy, rows, boundary);
+							if(sz < 0 || sy < 0)
+								continue;
+							const T *row = A.begin() + (sz * rows + sy) * columns;
+							const std::ptrdiff_t dx = taps[t].dx;
+							const W weight = taps[t].weight;
+
+							// cells reading inside the row
+							const std::ptrdiff_t lo = std::min(std::max(x1, -dx), x2);
+							const std::ptrdiff_t hi = std::max(std::min(x2, columns - dx), lo);
+							for(std::ptrdiff_t x = lo; x < hi; ++x)
+								o[x] += weight * row[x + dx];
+
+							// cells reading outside the row
+							for(std::ptrdiff_t x = x1; x < lo; ++x) {
+								const std::ptrdiff_t sx = stencil_coordinate(x + dx, columns, boundary);
+								if(sx >= 0)
+									o[x] += weight * row[sx];
+							}
+							for(std::ptrdiff_t x = hi; x < x2; ++x) {
+								const std::ptrdiff_t sx = stencil_coordinate(x + dx, columns, boundary);
+								if(sx >= 0)
+									o[x] += weight * row[sx];
+							}
+						}
+					}
+			}
+			else {
+				for(std::ptrdiff_t z = z1; z < z2; ++z)
+					for(std::ptrdiff_t y = y1; y < y2; ++y)
+						for(std::ptrdiff_t x = x1; x < x2; ++x) {
+							Q value = Q();
+							for(std::size_t t = 0; t < taps.size(); ++t) {
+								const std::ptrdiff_t sz = stencil_coordinate(z + taps[t].dz, floors, boundary);
+								const std::ptrdiff_t sy = stencil_coordinate(y + taps[t].dy, rows, boundary);
+								const std::ptrdiff_t sx = stencil_coordinate(x + taps[t].dx, columns, boundary);
+								if(sz >= 0 && sy >= 0 && sx >= 0)
+									value += taps[t].weight * A(sz, sy, sx);
+							}
+							out(z, y, x) = value;
+						}
+			}
 		}
-		
+	};
+
+	const std::size_t blocks = blocks_z * blocks_y * blocks_x;
+	if(pool)
+		pool->parallel_for(0, blocks, compute_blocks);
+	else
+		compute_blocks(0, blocks);
+}
+
+/**
+    @brief Global function apply_stencil
+
+    Applies a stencil (or small convolution) kernel to the cells of a 3D 
+    matrix: each cell of out becomes the sum of the cells of A at the 
+    offsets of the taps of the kernel, multiplied by their weights, the 
+    cells outside A being read according to the boundary condition.
+    The cells are computed in cache-sized blocks; with row-major matrixes 
+    each tap is applied to runs of a row with a vectorizable loop.
+
+    @param A the 3D matrix to read
+    @param kernel the taps of the stencil
+    @param boundary how the cells outside A are read
+    @param out the preallocated 3D matrix receiving the result, with the 
+    dimensions of A; it must not be A
+*/
+template <typename Q, typename H, typename B, typename L2, typename T, typename G, typename Alloc, typename L, typename W>
+void apply_stencil(const Matrix3D<T, G, Alloc, L> &A, const stencil_kernel<W> &kernel, Matrix3DBoundary boundary, Matrix3D<Q, H, B, L2> &out) {
+	apply_stencil_blocks(A, kernel, boundary, out, nullptr);
+}
+
+/**
+    @brief Global function apply_stencil (parallel)
+
+    Same as the apply_stencil function, but the blocks of cells are 
+    computed in parallel by the threads of the passed pool.
+
+    @param A the 3D matrix to read
+    @param kernel the taps of the stencil
+    @param boundary how the cells outside A are read
+    @param out the preallocated 3D matrix receiving the result
+    @param pool the pool of threads computing the blocks
+*/
+template <typename Q, typename H, typename B, typename L2, typename T, typename G, typename Alloc, typename L, typename W>
+void apply_stencil(const Matrix3D<T, G, Alloc, L> &A, const stencil_kernel<W> &kernel, Matrix3DBoundary boundary, 
+	Matrix3D<Q, H, B, L2> &out, Matrix3DThreadPool &pool) {
+	apply_stencil_blocks(A, kernel, boundary, out, &pool);
+}
+
+/**
+    @brief Transposition of a small tile
+
+    Writes dst[c * dst_stride + r] = src[r * src_stride + c] for the 
+    rows x columns cells of a tile small enough to stay in the cache. 
+    Trivially copyable cells of 4 or 8 bytes are moved through SSE2 
+    registers, 4x4 or 2x2 cells at a time, when the target supports it.
+*/
+template <typename T>
+void transpose_tile(const T *src, std::size_t src_stride, T *dst, std::size_t dst_stride, std::size_t rows, std::size_t columns) {
+
+	std::size_t r0 = 0, c0 = 0; // cells transposed through registers: [0, r0) x [0, c0)
+
+#if defined(__SSE2__)
+	if constexpr (std::is_trivially_copyable<T>::value && sizeof(T) == 4) {
+		r0 = rows & ~std::size_t(3);
+		c0 = columns & ~std::size_t(3);
+		for(std::size_t r = 0; r < r0; r += 4)
+			for(std::size_t c = 0; c < c0; c += 4) {
+				const T *s = src + r * src_stride + c;
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + src_stride));
+				const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 2 * src_stride));
+				const __m128i f = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 3 * src_stride));
+				const __m128i ab_low = _mm_unpacklo_epi32(a, b), ab_high = _mm_unpackhi_epi32(a, b);
+				const __m128i ef_low = _mm_unpacklo_epi32(e, f), ef_high = _mm_unpackhi_epi32(e, f);
+				T *d = dst + c * dst_stride + r;
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_unpacklo_epi64(ab_low, ef_low));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d + dst_stride), _mm_unpackhi_epi64(ab_low, ef_low));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 2 * dst_stride), _mm_unpacklo_epi64(ab_high, ef_high));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 3 * dst_stride), _mm_unpackhi_epi64(ab_high, ef_high));
+			}
 	}
+	else if constexpr (std::is_trivially_copyable<T>::value && sizeof(T) == 8) {
+		r0 = rows & ~std::size_t(1);
+		c0 = columns & ~std::size_t(1);
+		for(std::size_t r = 0; r < r0; r += 2)
+			for(std::size_t c = 0; c < c0; c += 2) {
+				const T *s = src + r * src_stride + c;
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + src_stride));
+				T *d = dst + c * dst_stride + r;
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_unpacklo_epi64(a, b));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d + dst_stride), _mm_unpackhi_epi64(a, b));
+			}
+	}
+#endif
 
-    /**
-	    @brief stream operator redefinition
+	// cells left over by the registers
+	for(std::size_t r = 0; r < rows; ++r)
+		for(std::size_t c = (r < r0 ? c0 : 0); c < columns; ++c)
+			dst[c * dst_stride + r] = src[r * src_stride + c];
+}
 
-	    Global function that redefines the stream operator to write a Matrix3D 
-	    to an output stream.
-    	The function is declared friend because we access the private data of Matrix3D.
+// Side of the tiles transposed by transpose_tile
+const std::size_t transpose_tile_side = 32;
 
-	    @param os output stream (left operand)
-	    @param m Matrix3D to write (right operand)
+/**
+    @brief Cache-oblivious transposition
 
-	    @return reference to the output stream
-	*/
-    friend std::ostream &operator<<(std::ostream &os, const Matrix3D &m) {
-        
-        os << "rows: " << m._rows << std::endl;
-        os << "columns: " << m._columns << std::endl;
-        os << "floors: " << m._floors << std::endl;
+    Same as transpose_tile on a rows x columns block of any size, which is 
+    recursively split in halves along its longest side until the pieces 
+    are tiles: at every level of the memory hierarchy, some level of the 
+    recursion works on pieces fitting in it.
+*/
+template <typename T>
+void transpose_recursive(const T *src, std::size_t src_stride, T *dst, std::size_t dst_stride, std::size_t rows, std::size_t columns) {
+	if(rows <= transpose_tile_side && columns <= transpose_tile_side)
+		transpose_tile(src, src_stride, dst, dst_stride, rows, columns);
+	else if(rows >= columns) {
+		const std::size_t half = rows / 2;
+		transpose_recursive(src, src_stride, dst, dst_stride, half, columns);
+		transpose_recursive(src + half * src_stride, src_stride, dst + half, dst_stride, rows - half, columns);
+	}
+	else {
+		const std::size_t half = columns / 2;
+		transpose_recursive(src, src_stride, dst, dst_stride, rows, half);
+		transpose_recursive(src + half, src_stride, dst + half * dst_stride, dst_stride, rows, columns - half);
+	}
+}
 
-        os << "matrix: " << std::endl;
+/**
+    @brief Batch of transpositions
 
-        for(unsigned int z = 0; z < m._floors; ++z) {
+    Transposes batch rows x columns blocks, the i-th one starting at 
+    src + i * src_batch and dst + i * dst_batch, splitting each block in 
+    strips of rows which run on the threads of pool if not null.
+*/
+template <typename T>
+void transpose_batch(const T *src, std::size_t src_stride, std::size_t src_batch, T *dst, std::size_t dst_stride, std::size_t dst_batch, 
+	std::size_t rows, std::size_t columns, std::size_t batch, Matrix3DThreadPool *pool) {
+
+	const std::size_t strip = std::max<std::size_t>(transpose_tile_side, (trasform_grain / std::max<std::size_t>(columns, 1) + transpose_tile_side - 1) / transpose_tile_side * transpose_tile_side);
+	const std::size_t strips = (rows + strip - 1) / strip;
+
+	auto transpose_strips = [=](std::size_t first, std::size_t last) {
+		for(std::size_t u = first; u < last; ++u) {
+			const std::size_t b = u / strips, r = u % strips * strip;
+			transpose_recursive(src + b * src_batch + r * src_stride, src_stride, dst + b * dst_batch + r, dst_stride, 
+				std::min(strip, rows - r), columns);
+		}
+	};
 
-        	os << z+1 << "° floor: " << z << std::endl;
+	if(pool)
+		pool->parallel_for(0, batch * strips, transpose_strips);
+	else
+		transpose_strips(0, batch * strips);
+}
 
-        	for(unsigned int y = 0; y < m._rows; ++y) {
+/**
+    @brief Axis permutation (implementation)
 
-        		for(unsigned int x = 0; x < m._columns; ++x)
-        			os << m(z, y, x) << " ";
+    Computes the matrix B with B(i0, i1, i2) = A(z, y, x) where the 
+    coordinate of A along the axis Ak is ik. With the row-major layout 
+    every permutation is a batch of 2D transpositions (or of row copies 
+    when x stays last), run on the threads of pool if not null.
+*/
+template <Matrix3DAxis A0, Matrix3DAxis A1, Matrix3DAxis A2, typename T, typename G, typename Alloc, typename L>
+Matrix3D<T, G, Alloc, L> permute_axes_copy(const Matrix3D<T, G, Alloc, L> &A, Matrix3DThreadPool *pool) {
+
+	static_assert(A0 != A1 && A0 != A2 && A1 != A2, "the axes must be a permutation of z, y and x");
+
+	const std::size_t dims[3] = { A.getFloors(), A.getRows(), A.getColumns() };
+	const std::size_t F = dims[0], R = dims[1], C = dims[2];
+
+	Matrix3D<T, G, Alloc, L> B(uninitialized, dims[int(A0)], dims[int(A1)], dims[int(A2)], A.get_allocator());
+	if(B.size() == 0)
+		return B;
+
+	const T *in = A.begin();
+	T *out = B.begin();
+
+	if constexpr (L::is_row_major) {
+		if constexpr (A0 == Matrix3DAxis::z && A1 == Matrix3DAxis::y) // (z, y, x): copy
+			std::copy(in, in + A.size(), out);
+		else if constexpr (A0 == Matrix3DAxis::z) // (z, x, y): transpose every floor
+			transpose_batch(in, C, R * C, out, R, R * C, R, C, F, pool);
+		else if constexpr (A0 == Matrix3DAxis::y && A1 == Matrix3DAxis::z) { // (y, z, x): move whole rows
+			auto copy_rows = [=](std::size_t first, std::size_t last) {
+				for(std::size_t u = first; u < last; ++u) {
+					const std::size_t y = u / F, z = u % F;
+					std::copy(in + (z * R + y) * C, in + (z * R + y + 1) * C, out + u * C);
+				}
+			};
+			if(pool)
+				pool->parallel_for(0, F * R, copy_rows, std::max<std::size_t>(1, trasform_grain / C));
+			else
+				copy_rows(0, F * R);
+		}
+		else if constexpr (A0 == Matrix3DAxis::y) // (y, x, z): the floors become the columns
+			transpose_batch(in, R * C, 0, out, F, 0, F, R * C, 1, pool);
+		else if constexpr (A1 == Matrix3DAxis::z) // (x, z, y): the columns become the floors
+			transpose_batch(in, C, 0, out, F * R, 0, F * R, C, 1, pool);
+		else // (x, y, z): transpose the plane of every row index
+			transpose_batch(in, R * C, C, out, R * F, F, F, C, R, pool);
+	}
+	else {
+		auto copy_floors = [&](std::size_t first, std::size_t last) {
+			std::size_t i[3];
+			for(i[0] = first; i[0] < last; ++i[0])
+				for(i[1] = 0; i[1] < B.getRows(); ++i[1])
+					for(i[2] = 0; i[2] < B.getColumns(); ++i[2]) {
+						std::size_t a[3];
+						a[int(A0)] = i[0];
+						a[int(A1)] = i[1];
+						a[int(A2)] = i[2];
+						B(i[0], i[1], i[2]) = A(a[0], a[1], a[2]);
+					}
+		};
+		if(pool)
+			pool->parallel_for(0, B.getFloors(), copy_floors);
+		else
+			copy_floors(0, B.getFloors());
+	}
 
-        		os << std::endl;
-        	}
+	return B;
+}
 
-        	os << std::endl;
+/**
+    @brief Global function permute_axes
 
-        }
+    Reorders the axes of a 3D matrix: the floors, rows and columns of the 
+    result run along the axes A0, A1 and A2 of A, so that for example 
+    permute_axes<Matrix3DAxis::x, Matrix3DAxis::y, Matrix3DAxis::z>(A) 
+    gives a matrix B with B(x, y, z) == A(z, y, x), whose contiguous axis 
+    is the z of A. All the 6 permutations are supported; with the row-major 
+    layout they are computed as cache-oblivious 2D transpositions.
 
-        return os;
-    }
+    @param A the starting 3D matrix
 
-};
+    @return the permuted matrix, allocated with the allocator of A
+*/
+template <Matrix3DAxis A0, Matrix3DAxis A1, Matrix3DAxis A2, typename T, typename G, typename Alloc, typename L>
+Matrix3D<T, G, Alloc, L> permute_axes(const Matrix3D<T, G, Alloc, L> &A) {
+	return permute_axes_copy<A0, A1, A2>(A, nullptr);
+}
 
 /**
-    @brief Global function transform
+    @brief Global function permute_axes (parallel)
 
-    Generic function that allows to obtain, starting from a passed Matrix3D, 
-    a new matrix on whose elements a specific functor, also passed, has been applied. 
-    The type T of the return 3D Matrix, normally the one returned by the passed functor, 
-    must be specified by the caller.
-	It is also possible to specify the type of functor H used for the equality operator 
-	of the return matrix.
+    Same as the permute_axes function, but the work is split among the 
+    threads of the passed pool.
 
     @param A the starting 3D matrix
-    @param functor the functor to apply to the data in the cells of the 3D array
+    @param pool the pool of threads running the permutation
 
-    @return the 3D matrix obtained by applying the functor to the data of the starting matrix
+    @return the permuted matrix, allocated with the allocator of A
+*/
+template <Matrix3DAxis A0, Matrix3DAxis A1, Matrix3DAxis A2, typename T, typename G, typename Alloc, typename L>
+Matrix3D<T, G, Alloc, L> permute_axes(const Matrix3D<T, G, Alloc, L> &A, Matrix3DThreadPool &pool) {
+	return permute_axes_copy<A0, A1, A2>(A, &pool);
+}
+
+/**
+    @brief In-place axis permutation (implementation)
+
+    When the permutation leaves the dimensions unchanged (the axes it 
+    exchanges have the same size), moves every cell along its cycle, 
+    which is at most 3 cells long, the cycles being processed by the 
+    thread owning the floor of their first cell, block by block to keep 
+    the cells of the cycles in the cache. Otherwise, replaces A with 
+    the permuted copy.
 */
-template <typename Q, typename F, typename H = default_functor<Q>, typename G, typename T>
-Matrix3D<Q> trasform(const Matrix3D<T, G> &A) {
+template <Matrix3DAxis A0, Matrix3DAxis A1, Matrix3DAxis A2, typename T, typename G, typename Alloc, typename L>
+void permute_axes_swap(Matrix3D<T, G, Alloc, L> &A, Matrix3DThreadPool *pool) {
 
-	Matrix3D<Q, H> B(A.getFloors(), A.getRows(), A.getColumns());
+	static_assert(A0 != A1 && A0 != A2 && A1 != A2, "the axes must be a permutation of z, y and x");
 
-	F functor;
+	const std::size_t dims[3] = { A.getFloors(), A.getRows(), A.getColumns() };
+	if(dims[int(A0)] != dims[0] || dims[int(A1)] != dims[1] || dims[int(A2)] != dims[2]) {
+		A = permute_axes_copy<A0, A1, A2>(A, pool);
+		return;
+	}
+	if(A0 == Matrix3DAxis::z && A1 == Matrix3DAxis::y)
+		return;
+
+	const std::size_t block = 16;
+	const std::size_t blocks_y = (dims[1] + block - 1) / block, blocks_x = (dims[2] + block - 1) / block;
+
+	// position whose cell moves to i: the coordinate along the axis Ak is ik
+	auto source = [](const std::size_t *i, std::size_t *a) {
+		a[int(A0)] = i[0];
+		a[int(A1)] = i[1];
+		a[int(A2)] = i[2];
+	};
+	auto offset = [&](const std::size_t *i) {
+		return L::offset(i[0], i[1], i[2], dims[0], dims[1], dims[2]);
+	};
+
+	auto permute_blocks = [&](std::size_t first, std::size_t last) {
+		for(std::size_t b = first; b < last; ++b) {
+			const std::size_t z1 = b / (blocks_y * blocks_x) * block, y1 = b / blocks_x % blocks_y * block, x1 = b % blocks_x * block;
+			std::size_t i[3];
+			for(i[0] = z1; i[0] < std::min(z1 + block, dims[0]); ++i[0])
+				for(i[1] = y1; i[1] < std::min(y1 + block, dims[1]); ++i[1])
+					for(i[2] = x1; i[2] < std::min(x1 + block, dims[2]); ++i[2]) {
+						std::size_t a[3], c[3];
+						source(i, a);
+						const std::size_t first_cell = offset(i), second_cell = offset(a);
+						if(second_cell <= first_cell)
+							continue; // fixed point, or cycle processed from another cell
+						source(a, c);
+						const std::size_t third_cell = offset(c);
+						T *cells = A.begin();
+						if(third_cell == first_cell) // cycle of 2 cells
+							std::swap(cells[first_cell], cells[second_cell]);
+						else if(third_cell > first_cell) { // cycle of 3 cells, i being the first one
+							T tmp(std::move(cells[first_cell]));
+							cells[first_cell] = std::move(cells[second_cell]);
+							cells[second_cell] = std::move(cells[third_cell]);
+							cells[third_cell] = std::move(tmp);
+						}
+					}
+		}
+	};
 
-	for (unsigned int z = 0; z < A.getFloors(); ++z)
-		for (unsigned int y = 0; y < A.getRows(); ++y)
-			for (unsigned int x = 0; x < A.getColumns(); ++x)
-				B(z, y, x) = functor(A(z, y, x));
+	const std::size_t blocks = ((dims[0] + block - 1) / block) * blocks_y * blocks_x;
+	if(pool)
+		pool->parallel_for(0, blocks, permute_blocks);
+	else
+		permute_blocks(0, blocks);
+}
 
-	return B;
+/**
+    @brief Global function permute_axes_in_place
+
+    Same as the permute_axes function, but the result replaces A. When the 
+    dimensions allow it, that is when the axes exchanged have the same size 
+    (square floors for (z, x, y), a cube for the cyclic permutations), the 
+    cells are moved in place without allocating; otherwise A is replaced 
+    with a permuted copy.
+
+    @param A the 3D matrix to permute
+*/
+template <Matrix3DAxis A0, Matrix3DAxis A1, Matrix3DAxis A2, typename T, typename G, typename Alloc, typename L>
+void permute_axes_in_place(Matrix3D<T, G, Alloc, L> &A) {
+	permute_axes_swap<A0, A1, A2>(A, nullptr);
+}
+
+/**
+    @brief Global function permute_axes_in_place (parallel)
+
+    Same as the permute_axes_in_place function, but the work is split among 
+    the threads of the passed pool.
+
+    @param A the 3D matrix to permute
+    @param pool the pool of threads running the permutation
+*/
+template <Matrix3DAxis A0, Matrix3DAxis A1, Matrix3DAxis A2, typename T, typename G, typename Alloc, typename L>
+void permute_axes_in_place(Matrix3D<T, G, Alloc, L> &A, Matrix3DThreadPool &pool) {
+	permute_axes_swap<A0, A1, A2>(A, &pool);
 }
 
+/**
+  @brief Hash functor of Matrix3D
+
+  Returns Matrix3D::hash(), so that a Matrix3D can be the key of the 
+  unordered containers. The hash is computed at every call: keys looked 
+  up often are better kept as HashedMatrix3D. It is disabled (as std::hash of the types without 
+  a hash) when equal matrixes could have different hashes, that is with 
+  an equality functor other than the default one (see matrix3d_hash_consistent).
+*/
+template <typename M, bool Enabled>
+struct matrix3d_std_hash {
+	std::size_t operator()(const M &m) const {
+		return static_cast<std::size_t>(m.hash());
+	}
+};
+
+template <typename M>
+struct matrix3d_std_hash<M, false> {
+	matrix3d_std_hash() = delete;
+	matrix3d_std_hash(const matrix3d_std_hash &) = delete;
+	matrix3d_std_hash &operator=(const matrix3d_std_hash &) = delete;
+};
+
+namespace std {
+
+template <typename T, typename F, typename Alloc, typename Layout>
+struct hash<Matrix3D<T, F, Alloc, Layout>> : 
+	matrix3d_std_hash<Matrix3D<T, F, Alloc, Layout>, matrix3d_hash_consistent<T, F>::value> {};
+
+}
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,519 @@
+#ifndef MAT3D_FILE_H
+#define MAT3D_FILE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory> //shared_ptr, allocator
+#include <cstdint> //uint8_t, uint16_t, uint32_t, uint64_t
+#include <cstring> //memcpy
+#include <limits> //numeric_limits
+#include <algorithm> //reverse
+#include <type_traits> //is_trivially_copyable
+#include <stdexcept> //runtime_error
+#include <system_error> //system_error
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAT3D_HAS_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include "Matrix3D.h"
+
+/**
+  @brief Binary file format
+
+  A 3D matrix is stored as a header of matrix3d_binary_header::size bytes
+  followed by its array of cells, exactly as they are in memory (floors,
+  then rows, then columns, with the columns contiguous). The header holds:
+  - the magic string "M3DB" and the version of the format;
+  - an endianness marker, the number 0x01020304 written in the byte order
+    of the machine which wrote the file;
+  - the kind of the cells (signed or unsigned integer, floating point, bool
+    or other trivially copyable type);
+  - the layout of the array (row-major);
+  - the number of floors, rows and columns, as 64-bit integers;
+  - the size of the cells in bytes, as a 64-bit integer;
+  - the offset of the first cell from the beginning of the file,
+    a multiple of 64 so that a mapped array is aligned to a cache line.
+*/
+struct matrix3d_binary_header {
+
+	static const std::size_t size = 64; ///< size of the header in bytes
+	static const std::uint16_t current_version = 1; ///< version written by save_binary
+	static const std::uint32_t endianness_marker = 0x01020304;
+
+	/// kinds of cells
+	enum kind_type : std::uint8_t { other = 0, signed_integer = 1, unsigned_integer = 2, floating_point = 3, boolean = 4 };
+
+	/// layouts of the array
+	enum layout_type : std::uint8_t { row_major = 0 };
+
+	char magic[4];
+	std::uint16_t version;
+	std::uint8_t kind;
+	std::uint8_t layout;
+	std::uint32_t endianness;
+	std::uint8_t reserved_bytes[4];
+	std::uint64_t floors;
+	std::uint64_t rows;
+	std::uint64_t columns;
+	std::uint64_t element_bytes; ///< size of the cells
+	std::uint64_t data_offset;
+	std::uint64_t reserved;
+
+	// Return the kind of the cells of type T
+	template <typename T>
+	static kind_type kind_of() {
+		if(std::is_same<T, bool>::value)
+			return boolean;
+		if(std::is_integral<T>::value)
+			return std::is_signed<T>::value ? signed_integer : unsigned_integer;
+		if(std::is_floating_point<T>::value)
+			return floating_point;
+		return other;
+	}
+
+	// Return the header describing a matrix of the given dimensions with cells of type T
+	template <typename T>
+	static matrix3d_binary_header describe(std::uint64_t z, std::uint64_t y, std::uint64_t x) {
+		matrix3d_binary_header header = matrix3d_binary_header();
+		std::memcpy(header.magic, "M3DB", 4);
+		header.version = current_version;
+		header.kind = kind_of<T>();
+		header.endianness = endianness_marker;
+		header.layout = row_major;
+		header.floors = z;
+		header.rows = y;
+		header.columns = x;
+		header.element_bytes = sizeof(T);
+		header.data_offset = size;
+		return header;
+	}
+
+	// Return true if the file was written on a machine with the other byte order
+	bool swapped() const {
+		return endianness != endianness_marker;
+	}
+
+	// Reverses the byte order of all the fields
+	void swap_bytes() {
+		_swap(version);
+		_swap(endianness);
+		_swap(floors);
+		_swap(rows);
+		_swap(columns);
+		_swap(element_bytes);
+		_swap(data_offset);
+	}
+
+	/**
+	    @brief Header check
+
+	    Checks that the header describes a matrix with cells of type T
+	    which can be read by this version of the library, with its
+	    fields in the byte order of the machine.
+
+	    @return the number of cells of the matrix
+
+	    @throw std::runtime_error if the header cannot be read as a matrix of T
+	*/
+	template <typename T>
+	std::uint64_t validate() const {
+		if(std::memcmp(magic, "M3DB", 4) != 0)
+			throw std::runtime_error("Matrix3D binary: not a Matrix3D file");
+		if(version > current_version)
+			throw std::runtime_error("Matrix3D binary: unsupported version");
+		if(kind != kind_of<T>() || element_bytes != sizeof(T))
+			throw std::runtime_error("Matrix3D binary: element type mismatch");
+		if(endianness != endianness_marker)
+			throw std::runtime_error("Matrix3D binary: corrupted header");
+		if(layout != row_major)
+			throw std::runtime_error("Matrix3D binary: unsupported layout");
+		if(data_offset < size || data_offset % 64 != 0)
+			throw std::runtime_error("Matrix3D binary: corrupted header");
+		if((floors == 0 || rows == 0 || columns == 0) && floors + rows + columns != 0)
+			throw std::runtime_error("Matrix3D binary: corrupted header");
+
+		const std::uint64_t limit = std::numeric_limits<std::uint64_t>::max() / sizeof(T);
+		if(floors != 0 && (rows > limit / floors || columns > limit / (floors * rows)))
+			throw std::runtime_error("Matrix3D binary: corrupted header");
+		return floors * rows * columns;
+	}
+
+private:
+
+	template <typename U>
+	static void _swap(U &value) {
+		unsigned char *bytes = reinterpret_cast<unsigned char*>(&value);
+		std::reverse(bytes, bytes + sizeof(U));
+	}
+};
+
+static_assert(sizeof(matrix3d_binary_header) == matrix3d_binary_header::size, "the binary header must be 64 bytes long");
+
+/**
+    @brief Global function save_binary (stream)
+
+    Writes a 3D matrix to a binary stream in the format described by
+    matrix3d_binary_header: the header and then the whole array with
+    a single write, without any formatting or conversion. The cells of 
+    matrixes with other layouts are written row by row in row-major order, 
+    so the files do not depend on the layout.
+
+    @param A the 3D matrix to write
+    @param os the stream to write to, opened in binary mode
+
+    @throw std::runtime_error if the stream fails
+*/
+template <typename T, typename F, typename Alloc, typename L>
+void save_binary(const Matrix3D<T, F, Alloc, L> &A, std::ostream &os) {
+
+	static_assert(std::is_trivially_copyable<T>::value, "only matrixes of trivially copyable types can be saved in binary form");
+
+	const matrix3d_binary_header header = matrix3d_binary_header::describe<T>(A.getFloors(), A.getRows(), A.getColumns());
+	os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	if constexpr (L::is_row_major) {
+		os.write(reinterpret_cast<const char*>(A.begin()), static_cast<std::streamsize>(A.size() * sizeof(T)));
+	}
+	else {
+		std::vector<T> row(A.getColumns());
+		for(std::size_t z = 0; z < A.getFloors(); ++z)
+			for(std::size_t y = 0; y < A.getRows(); ++y) {
+				for(std::size_t x = 0; x < A.getColumns(); ++x)
+					row[x] = A(z, y, x);
+				os.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size() * sizeof(T)));
+			}
+	}
+
+	if(!os)
+		throw std::runtime_error("Matrix3D binary: write failed");
+}
+
+/**
+    @brief Global function save_binary (file)
+
+    Writes a 3D matrix to a file in binary form, replacing its contents.
+
+    @param A the 3D matrix to write
+    @param path path of the file
+
+    @throw std::runtime_error if the file cannot be written
+*/
+template <typename T, typename F, typename Alloc, typename L>
+void save_binary(const Matrix3D<T, F, Alloc, L> &A, const std::string &path) {
+	std::ofstream os(path, std::ios::binary | std::ios::trunc);
+	if(!os)
+		throw std::runtime_error("Matrix3D binary: cannot open " + path);
+	save_binary(A, os);
+	os.close();
+	if(!os)
+		throw std::runtime_error("Matrix3D binary: write failed on " + path);
+}
+
+/**
+    @brief Global function load_binary (stream)
+
+    Reads a 3D matrix written by save_binary into a new array, converting
+    the byte order if the file was written by a machine with the other one. 
+    Matrixes with layouts other than the row-major one are read row by row.
+
+    @param is the stream to read from, opened in binary mode
+    @param alloc the allocator of the returned matrix (optional)
+
+    @return the 3D matrix read
+
+    @throw std::runtime_error if the stream does not hold a valid matrix of T
+    @throw std::bad_alloc possible allocation exception
+*/
+template <typename T, typename F = default_functor<T>, typename Alloc = std::allocator<T>, typename L = row_major_layout>
+Matrix3D<T, F, Alloc, L> load_binary(std::istream &is, const Alloc &alloc = Alloc()) {
+
+	static_assert(std::is_trivially_copyable<T>::value, "only matrixes of trivially copyable types can be loaded from binary form");
+
+	matrix3d_binary_header header;
+	if(!is.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		throw std::runtime_error("Matrix3D binary: truncated header");
+	const bool swapped = header.swapped();
+	if(swapped)
+		header.swap_bytes();
+	const std::uint64_t cells = header.validate<T>();
+
+	if(!is.ignore(static_cast<std::streamsize>(header.data_offset - sizeof(header))))
+		throw std::runtime_error("Matrix3D binary: truncated file");
+
+	if(cells == 0)
+		return Matrix3D<T, F, Alloc, L>(alloc);
+
+	Matrix3D<T, F, Alloc, L> A(uninitialized, header.floors, header.rows, header.columns, alloc);
+
+	// reads n cells into cells, in the byte order of the machine
+	auto read_cells = [&is, swapped](T *cells, std::uint64_t n) {
+		if(!is.read(reinterpret_cast<char*>(cells), static_cast<std::streamsize>(n * sizeof(T))))
+			throw std::runtime_error("Matrix3D binary: truncated file");
+		if(swapped) {
+			unsigned char *bytes = reinterpret_cast<unsigned char*>(cells);
+			for(std::uint64_t i = 0; i < n; ++i)
+				std::reverse(bytes + i * sizeof(T), bytes + (i + 1) * sizeof(T));
+		}
+	};
+
+	if constexpr (L::is_row_major) {
+		read_cells(A.begin(), cells);
+	}
+	else {
+		std::vector<T> row(A.getColumns());
+		for(std::size_t z = 0; z < A.getFloors(); ++z)
+			for(std::size_t y = 0; y < A.getRows(); ++y) {
+				read_cells(row.data(), row.size());
+				for(std::size_t x = 0; x < A.getColumns(); ++x)
+					A(z, y, x) = row[x];
+			}
+	}
+
+	return A;
+}
+
+/**
+    @brief Global function load_binary (file)
+
+    Reads a 3D matrix from a file written by save_binary into a new array.
+
+    @param path path of the file
+    @param alloc the allocator of the returned matrix (optional)
+
+    @return the 3D matrix read
+
+    @throw std::runtime_error if the file cannot be read or does not hold a valid matrix of T
+*/
+template <typename T, typename F = default_functor<T>, typename Alloc = std::allocator<T>, typename L = row_major_layout>
+Matrix3D<T, F, Alloc, L> load_binary(const std::string &path, const Alloc &alloc = Alloc()) {
+	std::ifstream is(path, std::ios::binary);
+	if(!is)
+		throw std::runtime_error("Matrix3D binary: cannot open " + path);
+	return load_binary<T, F, Alloc, L>(is, alloc);
+}
+
+/**
+  @brief Mapping modes
+
+  read_only maps the file shared and read-only: writing a cell of the matrix 
+  is not allowed (and crashes the program). copy_on_write maps it private 
+  and writable: the pages written are copied by the operating system the 
+  first time, and the changes are never written back to the file.
+*/
+enum class Matrix3DMapping { read_only, copy_on_write };
+
+/**
+  @brief File mapping
+
+  Region of memory where a file is mapped, unmapped when destroyed. 
+  Where memory mapping is not available, the file is read into an 
+  ordinary buffer instead.
+*/
+class matrix_mapping {
+
+	void *_address; ///< beginning of the mapped region
+	std::size_t _length; ///< length of the mapped region in bytes
+
+public:
+
+	/**
+	    @brief Constructor
+
+	    Maps a whole file in memory.
+
+	    @param path path of the file
+	    @param mode how the file is mapped
+
+	    @throw std::system_error if the file cannot be opened or mapped
+	*/
+	matrix_mapping(const std::string &path, Matrix3DMapping mode) : _address(nullptr), _length(0) {
+#ifdef MAT3D_HAS_MMAP
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0)
+			throw std::system_error(errno, std::generic_category(), "Matrix3D binary: cannot open " + path);
+
+		struct stat info;
+		if(::fstat(fd, &info) != 0) {
+			const int error = errno;
+			::close(fd);
+			throw std::system_error(error, std::generic_category(), "Matrix3D binary: cannot stat " + path);
+		}
+		_length = static_cast<std::size_t>(info.st_size);
+
+		if(_length > 0) {
+			const bool shared = (mode == Matrix3DMapping::read_only);
+			void *address = ::mmap(nullptr, _length, shared ? PROT_READ : PROT_READ | PROT_WRITE, 
+				shared ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+			if(address == MAP_FAILED) {
+				const int error = errno;
+				::close(fd);
+				throw std::system_error(error, std::generic_category(), "Matrix3D binary: cannot map " + path);
+			}
+			_address = address;
+		}
+		::close(fd);
+#else
+		(void)mode;
+		std::ifstream is(path, std::ios::binary | std::ios::ate);
+		if(!is)
+			throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "Matrix3D binary: cannot open " + path);
+		_length = static_cast<std::size_t>(is.tellg());
+		_address = ::operator new(_length, std::align_val_t(64));
+		is.seekg(0);
+		if(!is.read(static_cast<char*>(_address), static_cast<std::streamsize>(_length))) {
+			::operator delete(_address, std::align_val_t(64));
+			throw std::system_error(std::make_error_code(std::errc::io_error), "Matrix3D binary: cannot read " + path);
+		}
+#endif
+	}
+
+	matrix_mapping(const matrix_mapping &) = delete;
+	matrix_mapping &operator=(const matrix_mapping &) = delete;
+
+	~matrix_mapping() {
+		if(_address == nullptr)
+			return;
+#ifdef MAT3D_HAS_MMAP
+		::munmap(_address, _length);
+#else
+		::operator delete(_address, std::align_val_t(64));
+#endif
+	}
+
+	// Return the beginning of the mapped region
+	void *address() const {
+		return _address;
+	}
+
+	// Return the length of the mapped region in bytes
+	std::size_t length() const {
+		return _length;
+	}
+
+	// Return true if p points inside the mapped region
+	bool contains(const void *p) const {
+		const char *c = static_cast<const char*>(p);
+		const char *begin = static_cast<const char*>(_address);
+		return _address != nullptr && c >= begin && c < begin + _length;
+	}
+};
+
+/**
+  @brief Mapped allocator
+
+  Allocator of the matrixes returned by map_binary, which share the 
+  ownership of the mapping of their file: the file stays mapped as long 
+  as a matrix (or a copy of the allocator) refers to it. The array inside 
+  the mapping is never deallocated; any other array, like the one of a 
+  matrix assigned a different size, is allocated on the heap as with 
+  std::allocator. Copies of a mapped matrix are ordinary heap matrixes.
+*/
+template <typename T>
+class mapped_allocator {
+
+	template <typename U>
+	friend class mapped_allocator;
+
+	std::shared_ptr<const matrix_mapping> _mapping; ///< mapping owned, if any
+
+public:
+
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+	typedef std::false_type is_always_equal;
+
+	mapped_allocator() noexcept {}
+
+	explicit mapped_allocator(std::shared_ptr<const matrix_mapping> mapping) noexcept : _mapping(std::move(mapping)) {}
+
+	template <typename U>
+	mapped_allocator(const mapped_allocator<U> &other) noexcept : _mapping(other._mapping) {}
+
+	T *allocate(std::size_t n) {
+		return std::allocator<T>().allocate(n);
+	}
+
+	void deallocate(T *p, std::size_t n) noexcept {
+		if(_mapping && _mapping->contains(p))
+			return;
+		std::allocator<T>().deallocate(p, n);
+	}
+
+	// Copies of a mapped matrix do not keep the file mapped
+	mapped_allocator select_on_container_copy_construction() const noexcept {
+		return mapped_allocator();
+	}
+
+	// Return the mapping owned, nullptr if none
+	const matrix_mapping *mapping() const noexcept {
+		return _mapping.get();
+	}
+
+	template <typename U>
+	bool operator==(const mapped_allocator<U> &other) const noexcept {
+		return _mapping == other._mapping;
+	}
+
+	template <typename U>
+	bool operator!=(const mapped_allocator<U> &other) const noexcept {
+		return !(*this == other);
+	}
+};
+
+/**
+    @brief Global function map_binary
+
+    Maps a file written by save_binary in memory and returns a 3D matrix 
+    whose cells are the ones in the file, without reading or copying them: 
+    the pages of the file are loaded by the operating system the first 
+    time they are accessed, so opening a volume of any size takes the same 
+    (very short) time. The file must have been written by a machine with 
+    the same byte order.
+
+    @param path path of the file
+    @param mode Matrix3DMapping::read_only (default) or Matrix3DMapping::copy_on_write
+
+    @return the 3D matrix whose array is inside the mapping of the file
+
+    @throw std::runtime_error if the file does not hold a valid matrix of T
+    @throw std::system_error if the file cannot be opened or mapped
+*/
+template <typename T, typename F = default_functor<T>>
+Matrix3D<T, F, mapped_allocator<T>> map_binary(const std::string &path, Matrix3DMapping mode = Matrix3DMapping::read_only) {
+
+	static_assert(std::is_trivially_copyable<T>::value, "only matrixes of trivially copyable types can be mapped from binary form");
+	static_assert(alignof(T) <= 64, "the cells in a mapped file are aligned to 64 bytes");
+
+	std::shared_ptr<const matrix_mapping> mapping = std::make_shared<const matrix_mapping>(path, mode);
+
+	if(mapping->length() < sizeof(matrix3d_binary_header))
+		throw std::runtime_error("Matrix3D binary: truncated header");
+
+	matrix3d_binary_header header;
+	std::memcpy(&header, mapping->address(), sizeof(header));
+	if(header.swapped())
+		throw std::runtime_error("Matrix3D binary: the file has the other byte order and must be read with load_binary");
+	const std::uint64_t cells = header.validate<T>();
+
+	if(mapping->length() < header.data_offset || (mapping->length() - header.data_offset) / sizeof(T) < cells)
+		throw std::runtime_error("Matrix3D binary: truncated file");
+
+	if(cells == 0)
+		return Matrix3D<T, F, mapped_allocator<T>>(mapped_allocator<T>());
+
+	T *data = reinterpret_cast<T*>(static_cast<char*>(mapping->address()) + header.data_offset);
+
+	return Matrix3D<T, F, mapped_allocator<T>>(adopt_buffer, data, header.floors, header.rows, header.columns, 
+		mapped_allocator<T>(mapping));
+}
+
+#endif
@@ -0,0 +1,239 @@
+#ifndef MAT3D_THREADPOOL_H
+#define MAT3D_THREADPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <exception>
+#include <algorithm> //min, max
+#include <cstddef> //size_t
+
+/**
+  @brief Matrix3DThreadPool Class
+
+  Pool of worker threads used by the parallel algorithms on 3D matrixes
+  (trasform and the others taking a Matrix3DThreadPool& parameter).
+  The threads are created once, when the pool is constructed, and wait
+  for work, so that running a parallel loop only costs a wake-up.
+
+  The work of a parallel loop is cut into chunks which the workers
+  (and the calling thread, which takes part too) grab dynamically
+  from a shared counter: a chunk taking longer than the others, because
+  of an expensive functor or of a busy core, does not stall the whole loop.
+*/
+class Matrix3DThreadPool {
+
+	std::vector<std::thread> _workers; ///< worker threads
+
+	std::mutex _mutex; ///< mutex protecting the state of the current job
+	std::condition_variable _wake; ///< signals the workers that a job is available
+	std::condition_variable _done; ///< signals the calling thread that the workers are done
+	std::mutex _submit; ///< serializes the jobs submitted by different threads
+
+	const std::function<void()> *_job; ///< job currently running, run by every worker
+	std::size_t _generation; ///< incremented at each job, to wake up the workers only once
+	std::size_t _running; ///< number of workers still running the current job
+	bool _stop; ///< true when the workers must terminate
+
+	// Return a reference to a flag telling if the current thread is a worker of some pool
+	static bool &_inside_worker() {
+		thread_local bool inside = false;
+		return inside;
+	}
+
+	// Loop run by each worker thread
+	void _work() {
+		_inside_worker() = true;
+		std::size_t seen = 0;
+		for(;;) {
+			const std::function<void()> *job;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_wake.wait(lock, [&] { return _stop || _generation != seen; });
+				if(_stop)
+					return;
+				seen = _generation;
+				job = _job;
+			}
+
+			(*job)();
+
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				if(--_running == 0)
+					_done.notify_one();
+			}
+		}
+	}
+
+	/**
+	    @brief Execution of a job
+
+	    Runs the job on every worker and on the calling thread, and waits for
+	    all of them to be done.
+
+	    @param job function run by every thread; it must take care by itself
+	    of splitting the work, and must not throw
+	*/
+	void _run(const std::function<void()> &job) {
+		std::lock_guard<std::mutex> submit(_submit);
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_job = &job;
+			_running = _workers.size();
+			++_generation;
+		}
+		_wake.notify_all();
+
+		bool &inside = _inside_worker();
+		const bool was_inside = inside;
+		inside = true;
+		job();
+		inside = was_inside;
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_done.wait(lock, [&] { return _running == 0; });
+		_job = nullptr;
+	}
+
+public:
+
+	/**
+	    @brief Constructor
+
+	    Creates a pool whose parallel loops run on the given number of threads,
+	    counting the one calling them: threads - 1 workers are started.
+
+	    @param threads number of threads running the parallel loops
+	    (by default the number of hardware threads)
+
+	    @throw std::system_error if a thread cannot be started
+	*/
+	explicit Matrix3DThreadPool(unsigned int threads = std::thread::hardware_concurrency()) :
+		_job(nullptr), _generation(0), _running(0), _stop(false) {
+
+		threads = std::max(threads, 1u);
+
+		try {
+			for(unsigned int i = 1; i < threads; ++i)
+				_workers.push_back(std::thread(&Matrix3DThreadPool::_work, this));
+		}
+		catch(...) {
+			shutdown();
+			throw;
+		}
+	}
+
+	Matrix3DThreadPool(const Matrix3DThreadPool &) = delete;
+	Matrix3DThreadPool &operator=(const Matrix3DThreadPool &) = delete;
+
+	/**
+	    @brief Destructor
+
+	    Stops and joins all the workers.
+	*/
+	~Matrix3DThreadPool() {
+		shutdown();
+	}
+
+	// Stops and joins all the workers: the following loops run on the calling thread only
+	void shutdown() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_wake.notify_all();
+		for(std::size_t i = 0; i < _workers.size(); ++i)
+			if(_workers[i].joinable())
+				_workers[i].join();
+		_workers.clear();
+	}
+
+	// Return the number of threads running the parallel loops, the calling one included
+	unsigned int size() const {
+		return static_cast<unsigned int>(_workers.size()) + 1;
+	}
+
+	/**
+	    @brief Parallel loop
+
+	    Calls fn(first_i, last_i) on disjoint chunks [first_i, last_i) covering
+	    the range [first, last), running them in parallel on the threads of the pool,
+	    and returns when all of them have been processed.
+	    The chunks are at least grain indexes long (but the last one), and there
+	    are a few of them per thread, so that the load is balanced dynamically.
+	    If some calls throw, the remaining chunks are skipped and the first
+	    exception is rethrown to the caller.
+	    Loops started from inside a worker (of any pool) run on the calling
+	    thread only, instead of waiting for workers which may be busy with
+	    the outer loop.
+
+	    @param first first index of the range
+	    @param last index following the last one of the range
+	    @param fn function called on each chunk
+	    @param grain minimum number of indexes of a chunk
+	*/
+	template <typename Fn>
+	void parallel_for(std::size_t first, std::size_t last, Fn fn, std::size_t grain = 1) {
+
+		if(first >= last)
+			return;
+
+		const std::size_t n = last - first;
+		grain = std::max<std::size_t>(grain, 1);
+
+		if(_workers.empty() || _inside_worker() || n <= grain) {
+			fn(first, last);
+			return;
+		}
+
+		const std::size_t chunks = std::min<std::size_t>((n + grain - 1) / grain, std::size_t(size()) * 8);
+		const std::size_t chunk_size = (n + chunks - 1) / chunks;
+
+		std::atomic<std::size_t> next(0);
+		std::atomic<bool> failed(false);
+		std::exception_ptr error;
+		std::mutex error_mutex;
+
+		std::function<void()> job = [&] {
+			for(;;) {
+				const std::size_t chunk = next.fetch_add(1, std::memory_order_relaxed);
+				if(chunk >= chunks || failed.load(std::memory_order_relaxed))
+					return;
+				const std::size_t chunk_first = first + chunk * chunk_size;
+				const std::size_t chunk_last = std::min(chunk_first + chunk_size, last);
+				if(chunk_first >= chunk_last)
+					return;
+				try {
+					fn(chunk_first, chunk_last);
+				}
+				catch(...) {
+					std::lock_guard<std::mutex> lock(error_mutex);
+					if(!failed.exchange(true))
+						error = std::current_exception();
+				}
+			}
+		};
+
+		_run(job);
+
+		if(error)
+			std::rethrow_exception(error);
+	}
+
+	/**
+	    @brief Shared pool
+
+	    Return the pool shared by the whole program, with one thread per
+	    hardware thread, created the first time it is requested.
+	*/
+	static Matrix3DThreadPool &shared() {
+		static Matrix3DThreadPool pool;
+		return pool;
+	}
+};
+
+#endif
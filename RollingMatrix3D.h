@@ -0,0 +1,475 @@
+#ifndef ROLLING_MAT3D_H
+#define ROLLING_MAT3D_H
+
+#include <iostream>
+#include <iterator> //random_access_iterator_tag
+#include <algorithm> //copy, min
+#include <memory> //allocator
+#include <type_traits> //is_const, enable_if
+#include <cstddef> //size_t, ptrdiff_t
+#include <cassert>
+
+#include "Matrix3D.h"
+
+/**
+  @brief Iterator of a RollingMatrix3D
+
+  Random access iterator visiting the cells of a RollingMatrix3D in the
+  order of its logical floors (oldest first), and in row-major order inside
+  each floor. The cells live in a ring of floors, so the position of the
+  iterator is kept as a logical index, which is mapped to the array by
+  wrapping it around at the end of the ring.
+
+  @param V type of the data in the cells (const for the constant iterator)
+*/
+template <typename V>
+class RollingMatrix3DIterator {
+
+	template <typename W>
+	friend class RollingMatrix3DIterator;
+
+public:
+
+	typedef std::random_access_iterator_tag iterator_category;
+	typedef typename std::remove_const<V>::type value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef V *pointer;
+	typedef V &reference;
+
+private:
+
+	V *_cells; ///< array of the ring
+	std::size_t _start; ///< position in the array of the first cell of the oldest floor
+	std::size_t _ring; ///< number of cells of the ring
+	std::size_t _index; ///< logical index of the cell
+
+	V *_address(std::size_t index) const {
+		const std::size_t i = _start + index;
+		return _cells + (i < _ring ? i : i - _ring);
+	}
+
+public:
+
+	RollingMatrix3DIterator() : _cells(nullptr), _start(0), _ring(0), _index(0) {}
+
+	RollingMatrix3DIterator(V *cells, std::size_t start, std::size_t ring, std::size_t index) :
+		_cells(cells), _start(start), _ring(ring), _index(index) {}
+
+	// Conversion from the iterator to the constant iterator
+	template <typename W, typename = typename std::enable_if<std::is_same<const W, V>::value>::type>
+	RollingMatrix3DIterator(const RollingMatrix3DIterator<W> &other) :
+		_cells(other._cells), _start(other._start), _ring(other._ring), _index(other._index) {}
+
+	reference operator*() const {
+		return *_address(_index);
+	}
+
+	pointer operator->() const {
+		return _address(_index);
+	}
+
+	reference operator[](difference_type n) const {
+		return *_address(_index + n);
+	}
+
+	RollingMatrix3DIterator &operator++() {
+		++_index;
+		return *this;
+	}
+
+	RollingMatrix3DIterator operator++(int) {
+		RollingMatrix3DIterator old(*this);
+		++_index;
+		return old;
+	}
+
+	RollingMatrix3DIterator &operator--() {
+		--_index;
+		return *this;
+	}
+
+	RollingMatrix3DIterator operator--(int) {
+		RollingMatrix3DIterator old(*this);
+		--_index;
+		return old;
+	}
+
+	RollingMatrix3DIterator &operator+=(difference_type n) {
+		_index += n;
+		return *this;
+	}
+
+	RollingMatrix3DIterator &operator-=(difference_type n) {
+		_index -= n;
+		return *this;
+	}
+
+	RollingMatrix3DIterator operator+(difference_type n) const {
+		return RollingMatrix3DIterator(_cells, _start, _ring, _index + n);
+	}
+
+	friend RollingMatrix3DIterator operator+(difference_type n, const RollingMatrix3DIterator &i) {
+		return i + n;
+	}
+
+	RollingMatrix3DIterator operator-(difference_type n) const {
+		return RollingMatrix3DIterator(_cells, _start, _ring, _index - n);
+	}
+
+	difference_type operator-(const RollingMatrix3DIterator &other) const {
+		return difference_type(_index) - difference_type(other._index);
+	}
+
+	bool operator==(const RollingMatrix3DIterator &other) const {
+		return _index == other._index && _cells == other._cells;
+	}
+
+	bool operator!=(const RollingMatrix3DIterator &other) const {
+		return !(*this == other);
+	}
+
+	bool operator<(const RollingMatrix3DIterator &other) const {
+		return _index < other._index;
+	}
+
+	bool operator>(const RollingMatrix3DIterator &other) const {
+		return _index > other._index;
+	}
+
+	bool operator<=(const RollingMatrix3DIterator &other) const {
+		return _index <= other._index;
+	}
+
+	bool operator>=(const RollingMatrix3DIterator &other) const {
+		return _index >= other._index;
+	}
+};
+
+/**
+  @brief RollingMatrix3D Class
+
+  Window on the last floors of a stream of 2D frames, such as the last N
+  acquisitions of a detector. The floors are kept in a ring of capacity
+  floors allocated once: push_floor() copies a new frame over the oldest
+  floor and moves the start of the ring, in O(rows x columns), instead of
+  building a new Matrix3D and copying the N-1 floors kept.
+
+  The floors are indexed logically, from the oldest (0) to the newest
+  (getFloors() - 1), by operator()(z, y, x) and by the iterators, which
+  wrap around the end of the ring. Every floor is contiguous in memory
+  (see plane()), while the whole window is not: contiguous() materializes
+  it as a Matrix3D. The window grows with the first pushes until it holds
+  capacity floors.
+
+  @param T type of the data in the cells
+  @param F type of the functor used for the equality of the cells
+  @param Alloc type of the allocator of the ring
+*/
+template <typename T, typename F = default_functor<T>, typename Alloc = std::allocator<T>>
+class RollingMatrix3D {
+
+public:
+
+	typedef std::size_t size_type; ///< type of the dimensions and indexes
+	typedef T value_type; ///< type of the data in the cells
+	typedef RollingMatrix3DIterator<T> iterator; ///< iterator on the cells, oldest floor first
+	typedef RollingMatrix3DIterator<const T> const_iterator; ///< constant iterator on the cells, oldest floor first
+
+private:
+
+	Matrix3D<T, F, Alloc> _ring; ///< capacity floors, in the order of the array
+	size_type _head; ///< floor of the ring holding the oldest logical floor
+	size_type _floors; ///< number of floors in the window
+	F _equals; ///< functor comparing the cells
+
+	// Return the floor of the ring holding the logical floor z
+	size_type _physical(size_type z) const {
+		const size_type p = _head + z;
+		return p < capacity() ? p : p - capacity();
+	}
+
+	// Return the cells of one floor
+	size_type _floor_cells() const {
+		return _ring.getRows() * _ring.getColumns();
+	}
+
+public:
+
+	/**
+	    @brief Secondary constructor (capacity, y, x)
+
+	    Creates an empty window which will keep the last capacity floors
+	    of y rows and x columns pushed. The ring is allocated at once.
+
+	    @param capacity maximum number of floors of the window
+	    @param y number of rows of the floors
+	    @param x number of columns of the floors
+	    @param alloc allocator of the ring (optional)
+
+	    @pre capacity != 0 && y != 0 && x != 0
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	RollingMatrix3D(size_type capacity, size_type y, size_type x, const Alloc &alloc = Alloc()) :
+		_ring(capacity, y, x, alloc), _head(0), _floors(0) {}
+
+	// Return the number of floors in the window
+	size_type getFloors() const {
+		return _floors;
+	}
+
+	// Return the number of rows
+	size_type getRows() const {
+		return _ring.getRows();
+	}
+
+	// Return the number of columns
+	size_type getColumns() const {
+		return _ring.getColumns();
+	}
+
+	// Return the number of cells in the window
+	size_type size() const {
+		return _floors * _floor_cells();
+	}
+
+	// Return the maximum number of floors of the window
+	size_type capacity() const {
+		return _ring.getFloors();
+	}
+
+	// Return true if the window holds capacity floors
+	bool full() const {
+		return _floors == capacity();
+	}
+
+	/**
+	    @brief Getter of data in a cell
+
+	    @pre z < getFloors() && y < getRows() && x < getColumns()
+	*/
+	const T &operator()(size_type z, size_type y, size_type x) const {
+		assert(z < _floors);
+		return _ring(_physical(z), y, x);
+	}
+
+	/**
+	    @brief Getter/setter of data in a cell
+
+	    @pre z < getFloors() && y < getRows() && x < getColumns()
+	*/
+	T &operator()(size_type z, size_type y, size_type x) {
+		assert(z < _floors);
+		return _ring(_physical(z), y, x);
+	}
+
+	/**
+	    @brief Plane of a floor
+
+	    Return the pointer to the rows x columns cells of the logical floor z,
+	    which are contiguous and row-major.
+
+	    @pre z < getFloors()
+	*/
+	T *plane(size_type z) {
+		assert(z < _floors);
+		return _ring.begin() + _physical(z) * _floor_cells();
+	}
+
+	// Return the pointer to the cells of the logical floor z (const)
+	const T *plane(size_type z) const {
+		assert(z < _floors);
+		return _ring.begin() + _physical(z) * _floor_cells();
+	}
+
+	/**
+	    @brief Push of a floor
+
+	    Appends a floor to the window, as the newest one. When the window is
+	    full, the oldest floor is dropped, and its cells are the ones reused.
+	    The window is updated only once the whole floor has been copied, but
+	    if the copy of a cell throws, the dropped floor may have been partly
+	    overwritten.
+
+	    @param plane the rows x columns cells of the new floor, row-major
+	*/
+	void push_floor(const T *plane) {
+		const size_type slot = full() ? _head : _physical(_floors);
+		std::copy(plane, plane + _floor_cells(), _ring.begin() + slot * _floor_cells());
+		if(full())
+			_head = (_head + 1 == capacity()) ? 0 : _head + 1;
+		else
+			++_floors;
+	}
+
+	/**
+	    @brief Push of a floor (in place)
+
+	    Appends a floor to the window, as push_floor(plane) does, and returns
+	    the pointer to its cells, which the caller overwrites directly (for
+	    example receiving a frame into it). They still hold the values of the
+	    dropped floor, or of an unused floor of the ring.
+
+	    @return the pointer to the rows x columns cells of the new floor
+	*/
+	T *push_floor() {
+		const size_type slot = full() ? _head : _physical(_floors);
+		if(full())
+			_head = (_head + 1 == capacity()) ? 0 : _head + 1;
+		else
+			++_floors;
+		return _ring.begin() + slot * _floor_cells();
+	}
+
+	// Empties the window, keeping the ring allocated
+	void clear() {
+		_head = 0;
+		_floors = 0;
+	}
+
+	/**
+	    @brief Materialization of the window
+
+	    Return a Matrix3D with the floors of the window, from the oldest
+	    to the newest, copied with at most two copies of contiguous runs.
+	    An empty window gives an empty matrix.
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	Matrix3D<T, F, Alloc> contiguous() const {
+		if(_floors == 0)
+			return Matrix3D<T, F, Alloc>(_ring.get_allocator());
+
+		Matrix3D<T, F, Alloc> A(uninitialized, _floors, getRows(), getColumns(), _ring.get_allocator());
+		const size_type first_run = std::min(_floors, capacity() - _head);
+		T *out = std::copy(plane(0), plane(0) + first_run * _floor_cells(), A.begin());
+		if(first_run < _floors)
+			std::copy(_ring.begin(), _ring.begin() + (_floors - first_run) * _floor_cells(), out);
+		return A;
+	}
+
+	/**
+	    @brief Equality operator
+
+	    Two windows are equal if they have the same dimensions and their
+	    logical floors are equal according to the functor F, wherever the
+	    floors are in their rings.
+	*/
+	bool operator==(const RollingMatrix3D &other) const {
+		if(_floors != other._floors || getRows() != other.getRows() || getColumns() != other.getColumns())
+			return false;
+		for(size_type z = 0; z < _floors; ++z) {
+			const T *a = plane(z), *b = other.plane(z);
+			for(size_type i = 0; i < _floor_cells(); ++i)
+				if(!_equals(a[i], b[i]))
+					return false;
+		}
+		return true;
+	}
+
+	bool operator!=(const RollingMatrix3D &other) const {
+		return !(*this == other);
+	}
+
+	// Return the iterator to the first cell of the oldest floor
+	iterator begin() {
+		return iterator(_ring.begin(), _head * _floor_cells(), _ring.size(), 0);
+	}
+
+	// Return the iterator after the last cell of the newest floor
+	iterator end() {
+		return iterator(_ring.begin(), _head * _floor_cells(), _ring.size(), size());
+	}
+
+	// Return the constant iterator to the first cell of the oldest floor
+	const_iterator begin() const {
+		return const_iterator(_ring.begin(), _head * _floor_cells(), _ring.size(), 0);
+	}
+
+	// Return the constant iterator after the last cell of the newest floor
+	const_iterator end() const {
+		return const_iterator(_ring.begin(), _head * _floor_cells(), _ring.size(), size());
+	}
+
+	/**
+	    @brief Stream operator
+
+	    Prints the dimensions and each logical floor of the window, in the
+	    format of the stream operator of Matrix3D.
+	*/
+	friend std::ostream &operator<<(std::ostream &os, const RollingMatrix3D &m) {
+
+		os << "rows: " << m.getRows() << '\n';
+		os << "columns: " << m.getColumns() << '\n';
+		os << "floors: " << m.getFloors() << '\n';
+
+		os << "matrix: " << '\n';
+
+		for(size_type z = 0; z < m.getFloors(); ++z) {
+
+			os << z+1 << "° floor: " << z << '\n';
+
+			for(size_type y = 0; y < m.getRows(); ++y) {
+
+				for(size_type x = 0; x < m.getColumns(); ++x)
+					os << m(z, y, x) << " ";
+
+				os << '\n';
+			}
+
+			os << '\n';
+		}
+
+		return os;
+	}
+};
+
+/**
+    @brief Global function transform (rolling window)
+
+    Same as the transform function taking a functor object, on the floors
+    of a RollingMatrix3D: return the Matrix3D of the transformed cells,
+    from the oldest floor to the newest.
+
+    @param A the window on the starting cells
+    @param functor the functor to apply to the data in the cells
+
+    @return the 3D matrix obtained by applying the functor to the cells of the window
+*/
+template <typename Q, typename H = default_functor<Q>, typename T, typename G, typename Alloc, typename Fn,
+	typename = typename std::enable_if<std::is_invocable<Fn&, const T&>::value>::type>
+Matrix3D<Q, H> trasform(const RollingMatrix3D<T, G, Alloc> &A, Fn functor) {
+
+	if(A.getFloors() == 0)
+		return Matrix3D<Q, H>();
+
+	Matrix3D<Q, H> B(uninitialized, A.getFloors(), A.getRows(), A.getColumns());
+	const std::size_t floor_cells = A.getRows() * A.getColumns();
+
+	Q *out = B.begin();
+	for(std::size_t z = 0; z < A.getFloors(); ++z) {
+		const T *in = A.plane(z);
+		for(std::size_t i = 0; i < floor_cells; ++i)
+			out[i] = functor(in[i]);
+		out += floor_cells;
+	}
+
+	return B;
+}
+
+/**
+    @brief Global function transform (rolling window)
+
+    Same as the transform function on a Matrix3D, on the floors of a
+    RollingMatrix3D, with a default-constructed functor of type F.
+
+    @param A the window on the starting cells
+
+    @return the 3D matrix obtained by applying the functor to the cells of the window
+*/
+template <typename Q, typename F, typename H = default_functor<Q>, typename T, typename G, typename Alloc>
+Matrix3D<Q, H> trasform(const RollingMatrix3D<T, G, Alloc> &A) {
+	return trasform<Q, H>(A, F());
+}
+
+#endif
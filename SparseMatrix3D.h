@@ -0,0 +1,436 @@
+#ifndef SPARSE_MAT3D_H
+#define SPARSE_MAT3D_H
+
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <iterator> //forward_iterator_tag
+#include <algorithm> //sort, fill
+#include <utility> //swap
+#include <cstdint> //uint64_t
+#include <cstddef> //size_t, ptrdiff_t
+#include <cassert>
+
+#include "Matrix3D.h"
+
+/**
+  @brief SparseMatrix3D Class
+
+  Counterpart of Matrix3D for mostly empty volumes, where almost all the
+  cells hold the same background value. The volume is cut in bricks of
+  8x8x8 cells, and only the bricks holding at least a cell different from
+  the background are allocated, in a hash map indexed by the position of
+  the brick: the memory used grows with the number of such cells (and
+  with how scattered they are), not with the size of the volume, and
+  creating a matrix of any size costs nothing.
+
+  The cells are read with operator()(z, y, x), as with Matrix3D, and written
+  with set() and reset(); each brick keeps a bitmask of its non-empty cells
+  (the ones different from the background, according to the functor F),
+  which the iterators walk, so that iterating, comparing and printing only
+  touch the non-empty cells. A brick is freed when its last non-empty
+  cell is reset. Matrixes convert to and from a dense Matrix3D.
+
+  @param T type of the data in the cells
+  @param F type of the functor used to compare the cells with the background and between matrixes
+*/
+template <typename T, typename F = default_functor<T>>
+class SparseMatrix3D {
+
+public:
+
+	typedef std::size_t size_type; ///< type of the dimensions and indexes
+	typedef T value_type; ///< type of the data in the cells
+
+	static const unsigned int brick_shift = 3; ///< log2 of the side of a brick
+	static const size_type brick_side = size_type(1) << brick_shift; ///< cells per side of a brick
+	static const size_type brick_cells = brick_side * brick_side * brick_side; ///< cells of a brick
+
+private:
+
+	/// brick holding at least a non-empty cell
+	struct brick {
+		T cells[brick_cells]; ///< cells of the brick, row-major
+		std::uint64_t occupied[brick_cells / 64]; ///< bitmask of the non-empty cells
+		size_type count; ///< number of non-empty cells
+
+		explicit brick(const T &background) : count(0) {
+			std::fill(cells, cells + brick_cells, background);
+			std::fill(occupied, occupied + brick_cells / 64, std::uint64_t(0));
+		}
+	};
+
+	typedef std::unordered_map<size_type, brick> brick_map;
+
+	brick_map _bricks; ///< allocated bricks, indexed by brick position
+	size_type _floors; ///< number of floors
+	size_type _rows; ///< number of rows
+	size_type _columns; ///< number of columns
+	size_type _bricks_y, _bricks_x; ///< number of bricks along y and x
+	size_type _non_empty; ///< number of non-empty cells
+	T _background; ///< value of the empty cells
+	F _equals; ///< functor comparing the cells
+
+	// Return the index of the brick holding a cell
+	size_type _brick_index(size_type z, size_type y, size_type x) const {
+		return (((z >> brick_shift) * _bricks_y) + (y >> brick_shift)) * _bricks_x + (x >> brick_shift);
+	}
+
+	// Return the position of a cell inside its brick
+	static size_type _cell_index(size_type z, size_type y, size_type x) {
+		const size_type mask = brick_side - 1;
+		return (((z & mask) << brick_shift) + (y & mask)) << brick_shift | (x & mask);
+	}
+
+	// Return the coordinates of the cell at a position of a brick
+	Matrix3DIndex _index(size_type brick_index, size_type cell) const {
+		Matrix3DIndex i;
+		i.z = (brick_index / (_bricks_y * _bricks_x) << brick_shift) + (cell >> (2 * brick_shift));
+		i.y = (brick_index / _bricks_x % _bricks_y << brick_shift) + ((cell >> brick_shift) & (brick_side - 1));
+		i.x = (brick_index % _bricks_x << brick_shift) + (cell & (brick_side - 1));
+		return i;
+	}
+
+public:
+
+	/**
+	  @brief Iterator on the non-empty cells
+
+	  Forward iterator on the non-empty cells of a SparseMatrix3D, in no
+	  particular order: dereferencing it gives the value of the cell,
+	  index() its coordinates. Set or reset cells invalidate the iterators.
+	*/
+	class const_iterator {
+
+		friend class SparseMatrix3D;
+
+		const SparseMatrix3D *_matrix; ///< matrix iterated
+		typename brick_map::const_iterator _brick; ///< current brick
+		size_type _cell; ///< position of the current cell in the brick
+
+		const_iterator(const SparseMatrix3D *matrix, typename brick_map::const_iterator b) : _matrix(matrix), _brick(b), _cell(0) {
+			if(_brick != _matrix->_bricks.end())
+				_seek(0);
+		}
+
+		// Moves to the first non-empty cell from the position from, going to the next bricks if needed
+		void _seek(size_type from) {
+			for(;;) {
+				for(size_type word = from / 64; word < brick_cells / 64; ++word) {
+					std::uint64_t bits = _brick->second.occupied[word];
+					if(word == from / 64)
+						bits &= ~std::uint64_t(0) << (from % 64);
+					if(bits) {
+						_cell = word * 64 + __builtin_ctzll(bits);
+						return;
+					}
+				}
+				if(++_brick == _matrix->_bricks.end()) {
+					_cell = 0;
+					return;
+				}
+				from = 0;
+			}
+		}
+
+	public:
+
+		typedef std::forward_iterator_tag iterator_category;
+		typedef T value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const T *pointer;
+		typedef const T &reference;
+
+		const_iterator() : _matrix(nullptr), _brick(), _cell(0) {}
+
+		reference operator*() const {
+			return _brick->second.cells[_cell];
+		}
+
+		pointer operator->() const {
+			return &_brick->second.cells[_cell];
+		}
+
+		// Return the coordinates of the current cell
+		Matrix3DIndex index() const {
+			return _matrix->_index(_brick->first, _cell);
+		}
+
+		const_iterator &operator++() {
+			if(_cell + 1 < brick_cells)
+				_seek(_cell + 1);
+			else if(++_brick != _matrix->_bricks.end())
+				_seek(0);
+			else
+				_cell = 0;
+			return *this;
+		}
+
+		const_iterator operator++(int) {
+			const_iterator tmp(*this);
+			++(*this);
+			return tmp;
+		}
+
+		bool operator==(const const_iterator &other) const {
+			return _brick == other._brick && _cell == other._cell;
+		}
+
+		bool operator!=(const const_iterator &other) const {
+			return !(*this == other);
+		}
+	};
+
+	/**
+	    @brief Default constructor
+
+	    Initializes an empty 0x0x0 matrix.
+	*/
+	SparseMatrix3D() : _floors(0), _rows(0), _columns(0), _bricks_y(0), _bricks_x(0), _non_empty(0), _background() {}
+
+	/**
+	    @brief Secondary constructor
+
+	    Creates a z * y * x matrix whose cells all hold the background value,
+	    without allocating any brick.
+
+	    @param z number of floors
+	    @param y number of rows
+	    @param x number of columns
+	    @param background value of the empty cells
+	*/
+	SparseMatrix3D(size_type z, size_type y, size_type x, const T &background = T()) :
+		_floors(z), _rows(y), _columns(x),
+		_bricks_y((y + brick_side - 1) >> brick_shift), _bricks_x((x + brick_side - 1) >> brick_shift),
+		_non_empty(0), _background(background) {}
+
+	/**
+	    @brief Conversion from a dense matrix
+
+	    Creates a sparse matrix with the cells of a Matrix3D, allocating the
+	    bricks holding the cells which are different from the background.
+
+	    @param dense the matrix to convert
+	    @param background value of the empty cells
+	*/
+	template <typename G, typename Alloc, typename L>
+	explicit SparseMatrix3D(const Matrix3D<T, G, Alloc, L> &dense, const T &background = T()) :
+		SparseMatrix3D(dense.getFloors(), dense.getRows(), dense.getColumns(), background) {
+		for(typename Matrix3D<T, G, Alloc, L>::const_indexed_iterator i = dense.indexed_begin(); i != dense.indexed_end(); ++i)
+			if(!_equals(*i, _background))
+				set(i.index().z, i.index().y, i.index().x, *i);
+	}
+
+	// Return the number of floors
+	size_type getFloors() const {
+		return _floors;
+	}
+
+	// Return the number of rows
+	size_type getRows() const {
+		return _rows;
+	}
+
+	// Return the number of columns
+	size_type getColumns() const {
+		return _columns;
+	}
+
+	// Return the number of cells of the volume, empty or not
+	size_type size() const {
+		return _floors * _rows * _columns;
+	}
+
+	// Return the value of the empty cells
+	const T &background() const {
+		return _background;
+	}
+
+	// Return the number of non-empty cells
+	size_type non_empty() const {
+		return _non_empty;
+	}
+
+	// Return the number of allocated bricks
+	size_type bricks() const {
+		return _bricks.size();
+	}
+
+	// Return the number of bytes taken by the allocated bricks
+	std::size_t memory_usage() const {
+		return _bricks.size() * sizeof(brick);
+	}
+
+	/**
+	    @brief Getter of data in a cell
+
+	    Return a constant reference to the data in the cell identified by the
+	    given coordinates, which is the background if its brick is not allocated.
+
+	    @pre z < _floors && y < _rows && x < _columns
+	*/
+	const T &operator()(size_type z, size_type y, size_type x) const {
+		assert(z < _floors && y < _rows && x < _columns);
+		typename brick_map::const_iterator b = _bricks.find(_brick_index(z, y, x));
+		if(b == _bricks.end())
+			return _background;
+		return b->second.cells[_cell_index(z, y, x)];
+	}
+
+	/**
+	    @brief Setter of data in a cell
+
+	    Writes a value in a cell, allocating its brick if needed. Writing the
+	    background resets the cell.
+
+	    @pre z < _floors && y < _rows && x < _columns
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	void set(size_type z, size_type y, size_type x, const T &value) {
+		assert(z < _floors && y < _rows && x < _columns);
+		if(_equals(value, _background)) {
+			reset(z, y, x);
+			return;
+		}
+		brick &b = _bricks.try_emplace(_brick_index(z, y, x), _background).first->second;
+		const size_type cell = _cell_index(z, y, x);
+		b.cells[cell] = value;
+		std::uint64_t &word = b.occupied[cell / 64];
+		const std::uint64_t bit = std::uint64_t(1) << (cell % 64);
+		if(!(word & bit)) {
+			word |= bit;
+			++b.count;
+			++_non_empty;
+		}
+	}
+
+	/**
+	    @brief Reset of a cell
+
+	    Gives back the background value to a cell, freeing its brick if
+	    it was the last non-empty cell of it.
+
+	    @pre z < _floors && y < _rows && x < _columns
+	*/
+	void reset(size_type z, size_type y, size_type x) {
+		assert(z < _floors && y < _rows && x < _columns);
+		typename brick_map::iterator b = _bricks.find(_brick_index(z, y, x));
+		if(b == _bricks.end())
+			return;
+		const size_type cell = _cell_index(z, y, x);
+		std::uint64_t &word = b->second.occupied[cell / 64];
+		const std::uint64_t bit = std::uint64_t(1) << (cell % 64);
+		if(!(word & bit))
+			return;
+		word &= ~bit;
+		b->second.cells[cell] = _background;
+		--_non_empty;
+		if(--b->second.count == 0)
+			_bricks.erase(b);
+	}
+
+	// Resets all the cells, freeing all the bricks
+	void clear() {
+		_bricks.clear();
+		_non_empty = 0;
+	}
+
+	// Swaps the contents of two sparse matrixes
+	void swap(SparseMatrix3D &other) {
+		std::swap(_bricks, other._bricks);
+		std::swap(_floors, other._floors);
+		std::swap(_rows, other._rows);
+		std::swap(_columns, other._columns);
+		std::swap(_bricks_y, other._bricks_y);
+		std::swap(_bricks_x, other._bricks_x);
+		std::swap(_non_empty, other._non_empty);
+		std::swap(_background, other._background);
+		std::swap(_equals, other._equals);
+	}
+
+	// Return the iterator to the first non-empty cell
+	const_iterator begin() const {
+		return const_iterator(this, _bricks.begin());
+	}
+
+	// Return the iterator following the last non-empty cell
+	const_iterator end() const {
+		return const_iterator(this, _bricks.end());
+	}
+
+	/**
+	    @brief Conversion to a dense matrix
+
+	    Return a Matrix3D with the cells of the sparse matrix: the whole
+	    volume is allocated and filled with the background, then the non-empty
+	    cells are copied.
+
+	    @param alloc the allocator of the returned matrix
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	template <typename Alloc = std::allocator<T>, typename L = row_major_layout>
+	Matrix3D<T, F, Alloc, L> to_dense(const Alloc &alloc = Alloc()) const {
+		Matrix3D<T, F, Alloc, L> dense(_floors, _rows, _columns, _background, alloc);
+		for(const_iterator i = begin(); i != end(); ++i) {
+			const Matrix3DIndex c = i.index();
+			dense(c.z, c.y, c.x) = *i;
+		}
+		return dense;
+	}
+
+	/**
+	    @brief Equality operator
+
+	    Two sparse matrixes are equal if they have the same dimensions, the
+	    same background and the same non-empty cells: only the non-empty
+	    cells are compared.
+	*/
+	bool operator==(const SparseMatrix3D &other) const {
+		if(_floors != other._floors || _rows != other._rows || _columns != other._columns ||
+			_non_empty != other._non_empty || !_equals(_background, other._background))
+			return false;
+		for(const_iterator i = begin(); i != end(); ++i) {
+			const Matrix3DIndex c = i.index();
+			if(!_equals(*i, other(c.z, c.y, c.x)))
+				return false;
+		}
+		return true;
+	}
+
+	bool operator!=(const SparseMatrix3D &other) const {
+		return !(*this == other);
+	}
+
+	/**
+	    @brief Stream operator
+
+	    Prints the dimensions and the background of the matrix, then only
+	    its non-empty cells with their coordinates, in row-major order.
+	*/
+	friend std::ostream &operator<<(std::ostream &os, const SparseMatrix3D &m) {
+
+		os << "rows: " << m._rows << '\n';
+		os << "columns: " << m._columns << '\n';
+		os << "floors: " << m._floors << '\n';
+		os << "background: " << m._background << '\n';
+		os << "non-empty cells: " << m._non_empty << '\n';
+
+		std::vector<const_iterator> cells;
+		cells.reserve(m._non_empty);
+		for(const_iterator i = m.begin(); i != m.end(); ++i)
+			cells.push_back(i);
+		std::sort(cells.begin(), cells.end(), [](const const_iterator &a, const const_iterator &b) {
+			const Matrix3DIndex ia = a.index(), ib = b.index();
+			return ia.z != ib.z ? ia.z < ib.z : ia.y != ib.y ? ia.y < ib.y : ia.x < ib.x;
+		});
+
+		for(std::size_t i = 0; i < cells.size(); ++i) {
+			const Matrix3DIndex c = cells[i].index();
+			os << "(" << c.z << ", " << c.y << ", " << c.x << "): " << *cells[i] << '\n';
+		}
+
+		return os;
+	}
+};
+
+#endif
@@ -0,0 +1,802 @@
+#ifndef TILED_MAT3D_H
+#define TILED_MAT3D_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory> //unique_ptr
+#include <utility> //swap, move
+#include <algorithm> //min, copy
+#include <cstdint> //uint32_t, uint64_t
+#include <cstring> //memcpy, memcmp
+#include <stdexcept> //runtime_error
+#include <system_error> //system_error
+#include <new> //bad_array_new_length
+#include <type_traits> //is_trivially_copyable, is_invocable
+#include <cassert>
+
+#include "Matrix3D.h"
+#include "Matrix3DFile.h"
+
+/**
+  @brief Tiled file format
+
+  A TiledMatrix3D is stored as a header of 64 bytes followed by its bricks,
+  the blocks of brick_floors x brick_rows x brick_columns cells the volume
+  is cut in. The bricks are stored in row-major order of their coordinates
+  (so all the bricks covering the same floors are contiguous), each one as
+  a row-major array of cells; the bricks on the far edges of the volume are
+  stored at full size, with their cells beyond the volume unused.
+*/
+struct tiled_matrix3d_header {
+
+	static const std::size_t size = 64; ///< size of the header in bytes
+	static const std::uint16_t current_version = 1; ///< version written by TiledMatrix3D
+
+	char magic[4];
+	std::uint16_t version;
+	std::uint8_t kind;
+	std::uint8_t reserved_byte;
+	std::uint32_t endianness;
+	std::uint32_t element_bytes; ///< size of the cells
+	std::uint64_t floors;
+	std::uint64_t rows;
+	std::uint64_t columns;
+	std::uint32_t brick_floors;
+	std::uint32_t brick_rows;
+	std::uint32_t brick_columns;
+	std::uint32_t reserved_brick;
+	std::uint64_t data_offset;
+};
+
+static_assert(sizeof(tiled_matrix3d_header) == tiled_matrix3d_header::size, "the tiled header must be 64 bytes long");
+
+/**
+  @brief Brick file
+
+  File holding the bricks of a TiledMatrix3D, read and written at given
+  offsets. Where POSIX is available the reads and writes are done with
+  pread/pwrite, and the bricks about to be scanned are announced to the
+  operating system with posix_fadvise, which reads them ahead in the
+  background; elsewhere a std::fstream is used and the hints are ignored.
+*/
+class tiled_file {
+
+#ifdef MAT3D_HAS_MMAP
+	int _fd; ///< descriptor of the file
+#else
+	std::fstream _stream; ///< stream on the file
+#endif
+	std::string _path; ///< path of the file, for the error messages
+
+	void _fail(const char *what) const {
+#ifdef MAT3D_HAS_MMAP
+		throw std::system_error(errno, std::generic_category(), std::string("TiledMatrix3D: ") + what + " " + _path);
+#else
+		throw std::runtime_error(std::string("TiledMatrix3D: ") + what + " " + _path);
+#endif
+	}
+
+public:
+
+	/**
+	    @brief Constructor
+
+	    Opens a file for reading and writing.
+
+	    @param path path of the file
+	    @param create if true the file is created, or emptied if it exists
+
+	    @throw std::system_error if the file cannot be opened
+	*/
+	tiled_file(const std::string &path, bool create) : _path(path) {
+#ifdef MAT3D_HAS_MMAP
+		_fd = ::open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+		if(_fd < 0)
+			_fail("cannot open");
+#else
+		_stream.open(path, std::ios::in | std::ios::out | std::ios::binary | (create ? std::ios::trunc : std::ios::openmode()));
+		if(!_stream)
+			_fail("cannot open");
+#endif
+	}
+
+	tiled_file(const tiled_file &) = delete;
+	tiled_file &operator=(const tiled_file &) = delete;
+
+	~tiled_file() {
+#ifdef MAT3D_HAS_MMAP
+		::close(_fd);
+#endif
+	}
+
+	// Reads n bytes at offset into buffer
+	void read(std::uint64_t offset, void *buffer, std::size_t n) {
+#ifdef MAT3D_HAS_MMAP
+		char *out = static_cast<char*>(buffer);
+		while(n > 0) {
+			const ssize_t got = ::pread(_fd, out, n, static_cast<off_t>(offset));
+			if(got < 0 && errno == EINTR)
+				continue;
+			if(got < 0)
+				_fail("cannot read");
+			if(got == 0) { // beyond the end of the file: never written, so zero
+				std::memset(out, 0, n);
+				return;
+			}
+			out += got;
+			offset += static_cast<std::uint64_t>(got);
+			n -= static_cast<std::size_t>(got);
+		}
+#else
+		_stream.clear();
+		_stream.seekg(static_cast<std::streamoff>(offset));
+		_stream.read(static_cast<char*>(buffer), static_cast<std::streamsize>(n));
+		if(_stream.gcount() < static_cast<std::streamsize>(n))
+			std::memset(static_cast<char*>(buffer) + _stream.gcount(), 0, n - static_cast<std::size_t>(_stream.gcount()));
+#endif
+	}
+
+	// Writes n bytes from buffer at offset
+	void write(std::uint64_t offset, const void *buffer, std::size_t n) {
+#ifdef MAT3D_HAS_MMAP
+		const char *in = static_cast<const char*>(buffer);
+		while(n > 0) {
+			const ssize_t put = ::pwrite(_fd, in, n, static_cast<off_t>(offset));
+			if(put < 0 && errno == EINTR)
+				continue;
+			if(put <= 0)
+				_fail("cannot write");
+			in += put;
+			offset += static_cast<std::uint64_t>(put);
+			n -= static_cast<std::size_t>(put);
+		}
+#else
+		_stream.clear();
+		_stream.seekp(static_cast<std::streamoff>(offset));
+		if(!_stream.write(static_cast<const char*>(buffer), static_cast<std::streamsize>(n)))
+			_fail("cannot write");
+#endif
+	}
+
+	// Sets the size of the file; the bytes added read as zero
+	void resize(std::uint64_t bytes) {
+#ifdef MAT3D_HAS_MMAP
+		if(::ftruncate(_fd, static_cast<off_t>(bytes)) != 0)
+			_fail("cannot resize");
+#else
+		(void)bytes; // the reads beyond the end of the file give zeros
+#endif
+	}
+
+	// Tells the operating system that n bytes at offset will be read soon
+	void will_need(std::uint64_t offset, std::uint64_t n) {
+#if defined(MAT3D_HAS_MMAP) && defined(POSIX_FADV_WILLNEED)
+		::posix_fadvise(_fd, static_cast<off_t>(offset), static_cast<off_t>(n), POSIX_FADV_WILLNEED);
+#else
+		(void)offset;
+		(void)n;
+#endif
+	}
+};
+
+/**
+    Default memory budget of the brick cache of a TiledMatrix3D, in bytes
+*/
+const std::size_t tiled_default_budget = std::size_t(256) << 20;
+
+/**
+  @brief TiledMatrix3D Class
+
+  Out-of-core 3D matrix, for volumes larger than the memory: the cells live
+  in a file, cut in bricks of brick_floors x brick_rows x brick_columns cells
+  (powers of 2), and only the bricks recently accessed are kept in memory,
+  in a cache whose size is bounded by a memory budget. When the cache is full
+  the least recently used brick is evicted, and written back to the file
+  if it was modified. The cells can only be of trivially copyable types.
+
+  The class offers the same access as Matrix3D: operator()(z, y, x),
+  slice() (which returns an in-memory Matrix3D) and trasform() (which writes
+  its result to a new file brick by brick). The reference returned by
+  operator() is valid until another brick is loaded, that is until the next
+  access to a cell in a different brick. Accessing a cell through a non-const
+  object marks its brick as modified.
+
+  When a scan moves from the bricks of a group of floors to the ones of
+  the next group, the group following that one is announced to the operating
+  system, which reads it in the background: sequential floor by floor scans
+  find their bricks already read. For the best performance, the budget
+  should hold all the bricks covering brick_floors floors.
+
+  A TiledMatrix3D can be moved but not copied, and is not thread-safe.
+
+  @param T type of the data in the cells
+  @param F type of the functor used for the equality of the matrixes returned by slice()
+*/
+template <typename T, typename F = default_functor<T>>
+class TiledMatrix3D {
+
+	static_assert(std::is_trivially_copyable<T>::value, "the cells of a TiledMatrix3D must be trivially copyable");
+
+public:
+
+	typedef std::size_t size_type; ///< type of the dimensions and indexes
+	typedef T value_type; ///< type of the data in the cells
+
+private:
+
+	/// brick resident in memory
+	struct brick {
+		std::vector<T> cells; ///< cells of the brick
+		bool dirty; ///< true if the cells were modified after being read
+		std::list<size_type>::iterator lru; ///< position in the list of the recently used bricks
+	};
+
+	std::unique_ptr<tiled_file> _file; ///< file holding the bricks
+
+	size_type _floors, _rows, _columns; ///< dimensions of the volume
+	unsigned int _shift_z, _shift_y, _shift_x; ///< log2 of the dimensions of a brick
+	size_type _bricks_y, _bricks_x; ///< number of bricks along y and x
+	size_type _bricks; ///< total number of bricks
+	std::size_t _budget; ///< memory budget of the cache, in bytes
+
+	mutable std::unordered_map<size_type, brick> _resident; ///< bricks in memory
+	mutable std::list<size_type> _lru; ///< indexes of the resident bricks, most recently used first
+	mutable size_type _last_index; ///< index of the brick accessed last
+	mutable brick *_last; ///< brick accessed last, nullptr if none
+	mutable size_type _last_layer; ///< group of floors of the brick loaded last
+	mutable std::size_t _loads; ///< number of bricks read from the file
+	mutable std::size_t _writebacks; ///< number of bricks written to the file
+
+	// Return log2 of n, which must be a power of 2
+	static unsigned int _log2(size_type n) {
+		assert(n > 0 && (n & (n - 1)) == 0);
+		unsigned int shift = 0;
+		while((size_type(1) << shift) < n)
+			++shift;
+		return shift;
+	}
+
+	// Return the number of cells of a brick
+	size_type _brick_cells() const {
+		return size_type(1) << (_shift_z + _shift_y + _shift_x);
+	}
+
+	// Return the offset in the file of a brick
+	std::uint64_t _brick_offset(size_type index) const {
+		return tiled_matrix3d_header::size + std::uint64_t(index) * _brick_cells() * sizeof(T);
+	}
+
+	// Return the index of the brick holding a cell
+	size_type _brick_index(size_type z, size_type y, size_type x) const {
+		return (((z >> _shift_z) * _bricks_y) + (y >> _shift_y)) * _bricks_x + (x >> _shift_x);
+	}
+
+	// Return the position of a cell inside its brick
+	size_type _cell_index(size_type z, size_type y, size_type x) const {
+		const size_type bz = z & ((size_type(1) << _shift_z) - 1);
+		const size_type by = y & ((size_type(1) << _shift_y) - 1);
+		const size_type bx = x & ((size_type(1) << _shift_x) - 1);
+		return (((bz << _shift_y) + by) << _shift_x) + bx;
+	}
+
+	// Return the maximum number of resident bricks allowed by the budget (at least 1)
+	std::size_t _capacity() const {
+		return std::max<std::size_t>(1, _budget / (_brick_cells() * sizeof(T)));
+	}
+
+	// Writes a brick back to the file if modified
+	void _write_back(size_type index, brick &b) const {
+		if(!b.dirty)
+			return;
+		_file->write(_brick_offset(index), b.cells.data(), b.cells.size() * sizeof(T));
+		b.dirty = false;
+		++_writebacks;
+	}
+
+	// Evicts the least recently used bricks until at most n are resident
+	void _evict(std::size_t n) const {
+		while(_resident.size() > n) {
+			const size_type victim = _lru.back();
+			typename std::unordered_map<size_type, brick>::iterator i = _resident.find(victim);
+			_write_back(victim, i->second);
+			if(_last == &i->second)
+				_last = nullptr;
+			_lru.pop_back();
+			_resident.erase(i);
+		}
+	}
+
+	// Announces the next group of floors when the loads move to a new one
+	void _prefetch_after(size_type index) const {
+		const size_type layer = index / (_bricks_y * _bricks_x);
+		if(layer == _last_layer)
+			return;
+		if(layer == _last_layer + 1 && layer + 1 < (_bricks / (_bricks_y * _bricks_x)))
+			prefetch((layer + 1) << _shift_z, std::min(_floors, (layer + 2) << _shift_z) - 1);
+		_last_layer = layer;
+	}
+
+	/**
+	    @brief Brick access
+
+	    Return the brick with the given index, reading it from the file
+	    (and evicting the least recently used one if the cache is full)
+	    if it is not resident.
+	*/
+	brick *_brick(size_type index) const {
+		if(_last != nullptr && _last_index == index)
+			return _last;
+
+		typename std::unordered_map<size_type, brick>::iterator i = _resident.find(index);
+		if(i != _resident.end()) {
+			_lru.splice(_lru.begin(), _lru, i->second.lru);
+		}
+		else {
+			_evict(_capacity() - 1);
+
+			brick loaded;
+			loaded.cells.resize(_brick_cells());
+			loaded.dirty = false;
+			_file->read(_brick_offset(index), loaded.cells.data(), loaded.cells.size() * sizeof(T));
+			++_loads;
+
+			_lru.push_front(index);
+			try {
+				i = _resident.emplace(index, std::move(loaded)).first;
+			}
+			catch(...) {
+				_lru.pop_front();
+				throw;
+			}
+			i->second.lru = _lru.begin();
+			_prefetch_after(index);
+		}
+
+		_last_index = index;
+		_last = &i->second;
+		return _last;
+	}
+
+	// Writes the header describing the volume at the beginning of the file
+	void _write_header() {
+		tiled_matrix3d_header header = tiled_matrix3d_header();
+		std::memcpy(header.magic, "M3DT", 4);
+		header.version = tiled_matrix3d_header::current_version;
+		header.kind = matrix3d_binary_header::kind_of<T>();
+		header.element_bytes = static_cast<std::uint32_t>(sizeof(T));
+		header.endianness = matrix3d_binary_header::endianness_marker;
+		header.floors = _floors;
+		header.rows = _rows;
+		header.columns = _columns;
+		header.brick_floors = std::uint32_t(1) << _shift_z;
+		header.brick_rows = std::uint32_t(1) << _shift_y;
+		header.brick_columns = std::uint32_t(1) << _shift_x;
+		header.data_offset = tiled_matrix3d_header::size;
+		_file->write(0, &header, sizeof(header));
+	}
+
+	// Sets the dimensions of the volume and of the bricks
+	void _shape(size_type z, size_type y, size_type x, size_type brick_floors, size_type brick_rows, size_type brick_columns) {
+		_floors = z;
+		_rows = y;
+		_columns = x;
+		_shift_z = _log2(brick_floors);
+		_shift_y = _log2(brick_rows);
+		_shift_x = _log2(brick_columns);
+		const size_type bricks_z = (z + brick_floors - 1) >> _shift_z;
+		_bricks_y = (y + brick_rows - 1) >> _shift_y;
+		_bricks_x = (x + brick_columns - 1) >> _shift_x;
+		_bricks = bricks_z * _bricks_y * _bricks_x;
+	}
+
+public:
+
+	/**
+	    @brief Constructor (new file)
+
+	    Creates a volume of the given dimensions in a new file (replacing
+	    the file if it exists). The file is created sparse, so no space is
+	    written until the bricks are modified, and all the cells read as zero bytes.
+
+	    @param path path of the file
+	    @param z number of floors
+	    @param y number of rows
+	    @param x number of columns
+	    @param memory_budget maximum size of the bricks kept in memory, in bytes (optional)
+	    @param brick_floors number of floors of a brick, a power of 2 (optional)
+	    @param brick_rows number of rows of a brick, a power of 2 (optional)
+	    @param brick_columns number of columns of a brick, a power of 2 (optional)
+
+	    @pre z!=0 && y!=0 && x!=0
+
+	    @throw std::system_error if the file cannot be created
+	*/
+	TiledMatrix3D(const std::string &path, size_type z, size_type y, size_type x, std::size_t memory_budget = tiled_default_budget,
+		size_type brick_floors = 32, size_type brick_rows = 32, size_type brick_columns = 32) :
+		_file(new tiled_file(path, true)), _budget(memory_budget), _last_index(0), _last(nullptr),
+		_last_layer(0), _loads(0), _writebacks(0) {
+
+		assert(z > 0 && y > 0 && x > 0);
+
+		_shape(z, y, x, brick_floors, brick_rows, brick_columns);
+		Matrix3D<T>::_cells(_bricks, 1, _brick_cells()); // overflow check
+		_write_header();
+		_file->resize(_brick_offset(_bricks));
+	}
+
+	/**
+	    @brief Constructor (existing file)
+
+	    Opens a volume previously created by a TiledMatrix3D.
+
+	    @param path path of the file
+	    @param memory_budget maximum size of the bricks kept in memory, in bytes (optional)
+
+	    @throw std::system_error if the file cannot be opened
+	    @throw std::runtime_error if the file does not hold a volume of cells of type T, 
+	    or its header is corrupted
+	*/
+	explicit TiledMatrix3D(const std::string &path, std::size_t memory_budget = tiled_default_budget) :
+		_file(new tiled_file(path, false)), _budget(memory_budget), _last_index(0), _last(nullptr),
+		_last_layer(0), _loads(0), _writebacks(0) {
+
+		tiled_matrix3d_header header;
+		std::memset(&header, 0, sizeof(header));
+		_file->read(0, &header, sizeof(header));
+
+		if(std::memcmp(header.magic, "M3DT", 4) != 0)
+			throw std::runtime_error("TiledMatrix3D: not a tiled file " + path);
+		if(header.version > tiled_matrix3d_header::current_version || header.endianness != matrix3d_binary_header::endianness_marker)
+			throw std::runtime_error("TiledMatrix3D: unsupported version or byte order " + path);
+		if(header.kind != matrix3d_binary_header::kind_of<T>() || header.element_bytes != sizeof(T))
+			throw std::runtime_error("TiledMatrix3D: element type mismatch " + path);
+		if(header.floors == 0 || header.rows == 0 || header.columns == 0 || header.data_offset != tiled_matrix3d_header::size)
+			throw std::runtime_error("TiledMatrix3D: corrupted header " + path);
+		unsigned int brick_shift = 0;
+		for(std::uint32_t side : {header.brick_floors, header.brick_rows, header.brick_columns}) {
+			if(side == 0 || (side & (side - 1)) != 0)
+				throw std::runtime_error("TiledMatrix3D: corrupted header " + path);
+			brick_shift += _log2(side);
+		}
+		// the cells of a brick must fit in a size_type, and the volume and the bricks pass the checks of a new file
+		if(brick_shift >= 64)
+			throw std::runtime_error("TiledMatrix3D: corrupted header " + path);
+
+		try {
+			Matrix3D<T>::_cells(header.floors, header.rows, header.columns);
+			_shape(header.floors, header.rows, header.columns, header.brick_floors, header.brick_rows, header.brick_columns);
+			Matrix3D<T>::_cells(_bricks, 1, _brick_cells());
+		}
+		catch(const std::bad_array_new_length &) {
+			throw std::runtime_error("TiledMatrix3D: corrupted header " + path);
+		}
+	}
+
+	TiledMatrix3D(const TiledMatrix3D &) = delete;
+	TiledMatrix3D &operator=(const TiledMatrix3D &) = delete;
+
+	/**
+	    @brief Move constructor
+
+	    Takes over the file and the cache of other, which is left without a file:
+	    it can only be destroyed or assigned.
+	*/
+	TiledMatrix3D(TiledMatrix3D &&other) noexcept : _file(std::move(other._file)),
+		_floors(other._floors), _rows(other._rows), _columns(other._columns),
+		_shift_z(other._shift_z), _shift_y(other._shift_y), _shift_x(other._shift_x),
+		_bricks_y(other._bricks_y), _bricks_x(other._bricks_x), _bricks(other._bricks), _budget(other._budget),
+		_resident(std::move(other._resident)), _lru(std::move(other._lru)), _last_index(other._last_index),
+		_last(other._last), _last_layer(other._last_layer), _loads(other._loads), _writebacks(other._writebacks) {
+		other._floors = other._rows = other._columns = 0;
+		other._bricks = 0;
+		other._last = nullptr;
+		other._resident.clear();
+		other._lru.clear();
+	}
+
+	/**
+	    @brief Move assignment operator
+
+	    Writes back the modified bricks of the current volume, and takes over
+	    the file and the cache of other.
+	*/
+	TiledMatrix3D &operator=(TiledMatrix3D &&other) noexcept {
+		TiledMatrix3D tmp(std::move(other));
+		swap(tmp);
+		return *this;
+	}
+
+	// Swaps the content of two tiled matrixes
+	void swap(TiledMatrix3D &other) noexcept {
+		std::swap(_file, other._file);
+		std::swap(_floors, other._floors);
+		std::swap(_rows, other._rows);
+		std::swap(_columns, other._columns);
+		std::swap(_shift_z, other._shift_z);
+		std::swap(_shift_y, other._shift_y);
+		std::swap(_shift_x, other._shift_x);
+		std::swap(_bricks_y, other._bricks_y);
+		std::swap(_bricks_x, other._bricks_x);
+		std::swap(_bricks, other._bricks);
+		std::swap(_budget, other._budget);
+		std::swap(_resident, other._resident);
+		std::swap(_lru, other._lru);
+		std::swap(_last_index, other._last_index);
+		std::swap(_last, other._last);
+		std::swap(_last_layer, other._last_layer);
+		std::swap(_loads, other._loads);
+		std::swap(_writebacks, other._writebacks);
+	}
+
+	/**
+	    @brief Destructor
+
+	    Writes back the modified bricks. Errors are ignored: call flush()
+	    before destroying the matrix to be notified of them.
+	*/
+	~TiledMatrix3D() {
+		try {
+			flush();
+		}
+		catch(...) {}
+	}
+
+	// Return the number of floors of the volume
+	size_type getFloors() const {
+		return _floors;
+	}
+
+	// Return the number of rows of the volume
+	size_type getRows() const {
+		return _rows;
+	}
+
+	// Return the number of columns of the volume
+	size_type getColumns() const {
+		return _columns;
+	}
+
+	// Return the number of cells of the volume
+	size_type size() const {
+		return _floors * _rows * _columns;
+	}
+
+	// Return the number of floors of a brick
+	size_type getBrickFloors() const {
+		return size_type(1) << _shift_z;
+	}
+
+	// Return the number of rows of a brick
+	size_type getBrickRows() const {
+		return size_type(1) << _shift_y;
+	}
+
+	// Return the number of columns of a brick
+	size_type getBrickColumns() const {
+		return size_type(1) << _shift_x;
+	}
+
+	// Return the number of bricks of the volume
+	size_type bricks() const {
+		return _bricks;
+	}
+
+	// Return the memory budget of the cache, in bytes
+	std::size_t memory_budget() const {
+		return _budget;
+	}
+
+	// Changes the memory budget of the cache, evicting the bricks in excess
+	void set_memory_budget(std::size_t bytes) {
+		_budget = bytes;
+		_evict(_capacity());
+	}
+
+	// Return the number of bricks in memory
+	std::size_t resident_bricks() const {
+		return _resident.size();
+	}
+
+	// Return the number of bricks read from the file so far
+	std::size_t loads() const {
+		return _loads;
+	}
+
+	// Return the number of bricks written to the file so far
+	std::size_t writebacks() const {
+		return _writebacks;
+	}
+
+	/**
+	    @brief Getter of data in a cell
+
+	    Return a constant reference to the data in the cell identified by the
+	    given coordinates, reading its brick if not in memory. The reference
+	    is valid until another brick is accessed.
+
+	    @pre z < _floors && y < _rows && x < _columns
+	*/
+	const T &operator()(size_type z, size_type y, size_type x) const {
+		assert(z < _floors && y < _rows && x < _columns);
+		return _brick(_brick_index(z, y, x))->cells[_cell_index(z, y, x)];
+	}
+
+	/**
+	    @brief Getter/setter of data in a cell
+
+	    Return a reference to the data in the cell identified by the given
+	    coordinates, reading its brick if not in memory and marking it
+	    as modified. The reference is valid until another brick is accessed.
+
+	    @pre z < _floors && y < _rows && x < _columns
+	*/
+	T &operator()(size_type z, size_type y, size_type x) {
+		assert(z < _floors && y < _rows && x < _columns);
+		brick *b = _brick(_brick_index(z, y, x));
+		b->dirty = true;
+		return b->cells[_cell_index(z, y, x)];
+	}
+
+	/**
+	    @brief Brick access (read-only)
+
+	    Return a pointer to the cells of a brick, as a row-major array of
+	    getBrickFloors() x getBrickRows() x getBrickColumns() cells.
+	    The pointer is valid until another brick is accessed.
+
+	    @param index index of the brick, in row-major order of the brick coordinates
+
+	    @pre index < bricks()
+	*/
+	const T *brick_data(size_type index) const {
+		assert(index < _bricks);
+		return _brick(index)->cells.data();
+	}
+
+	/**
+	    @brief Brick access
+
+	    Same as the read-only brick access, but the brick is marked as modified.
+
+	    @pre index < bricks()
+	*/
+	T *brick_data(size_type index) {
+		assert(index < _bricks);
+		brick *b = _brick(index);
+		b->dirty = true;
+		return b->cells.data();
+	}
+
+	/**
+	    @brief Prefetch hint
+
+	    Tells the operating system that the bricks covering the floors z1-z2
+	    will be read soon, so that it reads them from the disk in the background.
+	    It is called automatically by sequential scans along z.
+
+	    @pre z1 <= z2 && z2 < _floors
+	*/
+	void prefetch(size_type z1, size_type z2) const {
+		assert(z1 <= z2 && z2 < _floors);
+		const size_type layer_bricks = _bricks_y * _bricks_x;
+		const size_type first = (z1 >> _shift_z) * layer_bricks;
+		const size_type last = ((z2 >> _shift_z) + 1) * layer_bricks;
+		_file->will_need(_brick_offset(first), _brick_offset(last) - _brick_offset(first));
+	}
+
+	/**
+	    @brief Write back
+
+	    Writes all the modified bricks to the file. They stay in memory.
+
+	    @throw std::system_error if a brick cannot be written
+	*/
+	void flush() {
+		for(typename std::unordered_map<size_type, brick>::iterator i = _resident.begin(); i != _resident.end(); ++i)
+			_write_back(i->first, i->second);
+	}
+
+	/**
+	    @brief slice method
+
+	    Return an in-memory Matrix3D containing a copy of the values in the
+	    coordinate intervals z1-z2, y1-y2 and x1-x2, copying them brick by brick.
+
+	    @pre z1 <= z2 < _floors && y1 <= y2 < _rows && x1 <= x2 < _columns
+
+	    @throw std::bad_alloc possible allocation exception
+	*/
+	Matrix3D<T, F> slice(size_type z1, size_type z2, size_type y1, size_type y2, size_type x1, size_type x2) const {
+
+		assert(z1 < _floors && z2 < _floors && y1 < _rows && y2 < _rows && x1 < _columns && x2 < _columns);
+		assert(z2 >= z1 && y2 >= y1 && x2 >= x1);
+
+		Matrix3D<T, F> sliced(uninitialized, z2 - z1 + 1, y2 - y1 + 1, x2 - x1 + 1);
+		T *out = sliced.begin();
+
+		const size_type brick_columns = getBrickColumns();
+		for(size_type z = z1; z <= z2; ++z)
+			for(size_type y = y1; y <= y2; ++y)
+				for(size_type x = x1; x <= x2; ) {
+					const size_type run = std::min(brick_columns - (x & (brick_columns - 1)), x2 + 1 - x);
+					const T *in = &(*this)(z, y, x);
+					out = std::copy(in, in + run, out);
+					x += run;
+				}
+
+		return sliced;
+	}
+};
+
+/**
+    @brief Global function transform (tiled)
+
+    Same as the transform function on a Matrix3D, but applied to a volume
+    which does not fit in memory: the result is written to a new file with
+    the same bricks and memory budget as A, one brick at a time, so only a
+    few bricks of each volume are in memory at any time.
+
+    @param A the starting tiled 3D matrix
+    @param path path of the file of the returned matrix
+
+    @return the tiled 3D matrix obtained by applying the functor to the data of A
+
+    @throw std::system_error if the files cannot be read or written
+*/
+template <typename Q, typename F, typename H = default_functor<Q>, typename G, typename T>
+TiledMatrix3D<Q, H> trasform(const TiledMatrix3D<T, G> &A, const std::string &path) {
+	return trasform<Q, H>(A, path, F());
+}
+
+/**
+    @brief Global function transform (tiled, functor object)
+
+    Same as the tiled transform function, but the functor is passed as
+    an object, so that stateful functors and lambdas can be used.
+
+    @param A the starting tiled 3D matrix
+    @param path path of the file of the returned matrix
+    @param functor the functor to apply to the data in the cells
+
+    @return the tiled 3D matrix obtained by applying the functor to the data of A
+*/
+template <typename Q, typename H = default_functor<Q>, typename G, typename T, typename Fn,
+	typename = typename std::enable_if<std::is_invocable<Fn&, const T&>::value>::type>
+TiledMatrix3D<Q, H> trasform(const TiledMatrix3D<T, G> &A, const std::string &path, Fn functor) {
+
+	typedef typename TiledMatrix3D<T, G>::size_type size_type;
+
+	TiledMatrix3D<Q, H> B(path, A.getFloors(), A.getRows(), A.getColumns(), A.memory_budget(),
+		A.getBrickFloors(), A.getBrickRows(), A.getBrickColumns());
+
+	const size_type brick_floors = A.getBrickFloors(), brick_rows = A.getBrickRows(), brick_columns = A.getBrickColumns();
+	const size_type bricks_y = (A.getRows() + brick_rows - 1) / brick_rows;
+	const size_type bricks_x = (A.getColumns() + brick_columns - 1) / brick_columns;
+
+	for(size_type b = 0; b < A.bricks(); ++b) {
+		const size_type z0 = (b / (bricks_y * bricks_x)) * brick_floors;
+		const size_type y0 = ((b / bricks_x) % bricks_y) * brick_rows;
+		const size_type x0 = (b % bricks_x) * brick_columns;
+
+		// only the cells inside the volume are transformed
+		const size_type floors = std::min(brick_floors, A.getFloors() - z0);
+		const size_type rows = std::min(brick_rows, A.getRows() - y0);
+		const size_type columns = std::min(brick_columns, A.getColumns() - x0);
+
+		const T *in = A.brick_data(b);
+		Q *out = B.brick_data(b);
+		for(size_type z = 0; z < floors; ++z)
+			for(size_type y = 0; y < rows; ++y) {
+				const size_type row = (z * brick_rows + y) * brick_columns;
+				for(size_type x = 0; x < columns; ++x)
+					out[row + x] = functor(in[row + x]);
+			}
+	}
+
+	B.flush();
+	return B;
+}
+
+#endif
@@ -0,0 +1,409 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstddef>
+#include <utility>
+#include <thread>
+#include <cmath>
+
+#include "Matrix3D.h"
+#include "customType.h"
+
+using namespace std;
+
+// Micro-benchmarks of the fundamental operations of Matrix3D, built with -O3 by `make bench`.
+// Every benchmark runs on cubes of several sizes and on int, double and customType cells,
+// and reports the best time over a few repetitions as ns per cell and GB/s, where the bytes
+// are those of the cells read and written once. The report is CSV, or JSON with --json;
+// --quick runs the smallest sizes only.
+
+// Keeps the compiler from optimizing away a computed value
+template <typename T>
+void do_not_optimize(const T &value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+// Value stored in the cell of index i
+template <typename T>
+T cell_value(size_t i) {
+    return T(i * 2654435761u % 1000003);
+}
+
+template <>
+customType cell_value<customType>(size_t i) {
+    return customType(int(i * 2654435761u % 1000003), double(i), char('a' + i % 26));
+}
+
+// Cell types of the matrixes converted from (source) and to (target) by the conversion benchmark
+template <typename T>
+struct conversion_types { typedef T source; typedef double target; };
+
+template <>
+struct conversion_types<double> { typedef double source; typedef float target; };
+
+template <>
+struct conversion_types<customType> { typedef char source; typedef customType target; };
+
+// Functor applied by the trasform benchmark
+template <typename T>
+struct bench_functor {
+    T operator()(const T &v) const { return v + v; }
+};
+
+template <>
+struct bench_functor<customType> {
+    customType operator()(const customType &v) const { return customType(v._a + 1, v._b * 2, v._c); }
+};
+
+// Functor applied repeatedly in place by the transform_inplace benchmark, which must not overflow
+template <typename T>
+struct bench_negate {
+    T operator()(const T &v) const { return -v; }
+};
+
+template <>
+struct bench_negate<customType> {
+    customType operator()(const customType &v) const { return customType(-v._a, -v._b, v._c); }
+};
+
+// Ordering of the cells for std::sort
+struct cell_less {
+    template <typename T>
+    bool operator()(const T &a, const T &b) const { return a < b; }
+
+    bool operator()(const customType &a, const customType &b) const { return a._a < b._a; }
+};
+
+template <typename T> const char *type_name();
+template <> const char *type_name<int>() { return "int"; }
+template <> const char *type_name<float>() { return "float"; }
+template <> const char *type_name<double>() { return "double"; }
+template <> const char *type_name<customType>() { return "customType"; }
+
+struct bench_result {
+    string benchmark;
+    string type;
+    size_t side;
+    size_t cells;
+    double ns_per_cell;
+    double gb_per_s;
+};
+
+struct bench_report {
+
+    vector<bench_result> results;
+
+    /**
+        Runs fn (which must redo all its work at each call) until at least min_ms
+        milliseconds and 3 repetitions have passed, and records the best time.
+        bytes is the number of bytes of the cells read and written by a call.
+    */
+    template <typename Fn>
+    void run(const string &benchmark, const char *type, size_t side, size_t cells, double bytes, Fn fn, double min_ms = 50) {
+        double best = 0, total = 0;
+        for (int rep = 0; rep < 3 || total < min_ms * 1e6; ++rep) {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            fn();
+            double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+            best = (rep == 0 || ns < best) ? ns : best;
+            total += ns;
+        }
+        results.push_back(bench_result{benchmark, type, side, cells, best / cells, bytes / best});
+    }
+
+    void print_csv(ostream &os) const {
+        os << "benchmark,type,side,cells,ns_per_cell,gb_per_s" << endl;
+        for (const bench_result &r : results)
+            os << r.benchmark << "," << r.type << "," << r.side << "," << r.cells << "," << r.ns_per_cell << "," << r.gb_per_s << endl;
+    }
+
+    void print_json(ostream &os) const {
+        os << "[" << endl;
+        for (size_t i = 0; i < results.size(); ++i) {
+            const bench_result &r = results[i];
+            os << "  {\"benchmark\": \"" << r.benchmark << "\", \"type\": \"" << r.type << "\", \"side\": " << r.side
+                << ", \"cells\": " << r.cells << ", \"ns_per_cell\": " << r.ns_per_cell << ", \"gb_per_s\": " << r.gb_per_s << "}"
+                << (i + 1 < results.size() ? "," : "") << endl;
+        }
+        os << "]" << endl;
+    }
+};
+
+// Allocation-heavy loop of the allocator benchmarks: slice of the central half, then trasform of the slice
+template <typename T, typename Alloc>
+void bench_slice_trasform(bench_report &report, const string &benchmark, size_t n, const vector<T> &values, const Alloc &alloc) {
+    const size_t q = n / 4, sliced = (n / 2) * (n / 2) * (n / 2);
+    Matrix3D<T, default_functor<T>, Alloc> A(n, n, n, values[0], alloc);
+    A.fill(values.begin(), values.end());
+    report.run(benchmark, type_name<T>(), n, sliced, 4.0 * sliced * sizeof(T), [&] {
+        Matrix3D<T, default_functor<T>, Alloc> S = A.slice(q, q + n / 2 - 1, q, q + n / 2 - 1, q, q + n / 2 - 1);
+        Matrix3D<T, default_functor<T>, Alloc> C = trasform<T, bench_functor<T>>(S);
+        do_not_optimize(C);
+    });
+}
+
+template <typename T>
+void bench_type(bench_report &report, size_t n) {
+
+    const char *type = type_name<T>();
+    const size_t cells = n * n * n;
+    const double bytes = double(cells) * sizeof(T);
+
+    vector<T> values(cells);
+    for (size_t i = 0; i < cells; ++i)
+        values[i] = cell_value<T>(i);
+
+    Matrix3D<T> A(n, n, n);
+    A.fill(values.begin(), values.end());
+
+    report.run("construct", type, n, cells, bytes, [&] {
+        Matrix3D<T> B(n, n, n, values[1]);
+        do_not_optimize(B);
+    });
+
+    report.run("construct_uninitialized", type, n, cells, bytes, [&] {
+        Matrix3D<T> B(uninitialized, n, n, n);
+        copy(values.begin(), values.end(), B.begin());
+        do_not_optimize(B);
+    });
+
+    report.run("copy", type, n, cells, 2 * bytes, [&] {
+        Matrix3D<T> B(A);
+        do_not_optimize(B);
+    });
+
+    // no cell is copied by a move, so no bytes are counted
+    Matrix3D<T> moved(A);
+    report.run("move", type, n, cells, 0, [&] {
+        Matrix3D<T> B(std::move(moved));
+        moved = std::move(B);
+        do_not_optimize(moved);
+    });
+
+    // operator() with the innermost loop along x (contiguous), y and z
+    report.run("access_x_major", type, n, cells, bytes, [&] {
+        size_t hits = 0;
+        for (size_t z = 0; z < n; ++z)
+            for (size_t y = 0; y < n; ++y)
+                for (size_t x = 0; x < n; ++x)
+                    hits += (A(z, y, x) == values[0]);
+        do_not_optimize(hits);
+    });
+    report.run("access_y_major", type, n, cells, bytes, [&] {
+        size_t hits = 0;
+        for (size_t z = 0; z < n; ++z)
+            for (size_t x = 0; x < n; ++x)
+                for (size_t y = 0; y < n; ++y)
+                    hits += (A(z, y, x) == values[0]);
+        do_not_optimize(hits);
+    });
+    report.run("access_z_major", type, n, cells, bytes, [&] {
+        size_t hits = 0;
+        for (size_t y = 0; y < n; ++y)
+            for (size_t x = 0; x < n; ++x)
+                for (size_t z = 0; z < n; ++z)
+                    hits += (A(z, y, x) == values[0]);
+        do_not_optimize(hits);
+    });
+
+    // reference for operator(): the former 32-bit offsets on the raw array, innermost loop along x
+    report.run("access_raw_32bit", type, n, cells, bytes, [&] {
+        const T *raw = std::as_const(A).begin();
+        const unsigned int side = static_cast<unsigned int>(n);
+        size_t hits = 0;
+        for (unsigned int z = 0; z < side; ++z)
+            for (unsigned int y = 0; y < side; ++y)
+                for (unsigned int x = 0; x < side; ++x)
+                    hits += (raw[(z * side * side) + (y * side) + x] == values[0]);
+        do_not_optimize(hits);
+    });
+
+    // the central half along each axis
+    const size_t q = n / 4, sliced = (n / 2) * (n / 2) * (n / 2);
+    report.run("slice", type, n, sliced, 2.0 * sliced * sizeof(T), [&] {
+        Matrix3D<T> S = A.slice(q, q + n / 2 - 1, q, q + n / 2 - 1, q, q + n / 2 - 1);
+        do_not_optimize(S);
+    });
+
+    Matrix3D<T> B = A;
+    report.run("operator==", type, n, cells, 2 * bytes, [&] {
+        bool equal = (A == B);
+        do_not_optimize(equal);
+    });
+
+    if constexpr (matrix3d_hashable<T>::value) {
+        report.run("hash", type, n, cells, bytes, [&] {
+            uint64_t h = B.hash();
+            do_not_optimize(h);
+        });
+    }
+
+    report.run("fill", type, n, cells, 2 * bytes, [&] {
+        B.fill(values.begin(), values.end());
+        do_not_optimize(B);
+    });
+
+    report.run("fill_value", type, n, cells, bytes, [&] {
+        B.fill(values[1]);
+        do_not_optimize(B);
+    });
+
+    report.run("trasform", type, n, cells, 2 * bytes, [&] {
+        Matrix3D<T> C = trasform<T, bench_functor<T>>(A);
+        do_not_optimize(C);
+    });
+
+    matrix_pool pool;
+    bench_slice_trasform(report, "slice_trasform_std_allocator", n, values, allocator<T>());
+    bench_slice_trasform(report, "slice_trasform_aligned_allocator", n, values, aligned_allocator<T>());
+    bench_slice_trasform(report, "slice_trasform_pool_allocator", n, values, pool_allocator<T>(pool));
+
+    report.run("transform_inplace", type, n, cells, 2 * bytes, [&] {
+        transform_inplace(B, bench_negate<T>());
+        do_not_optimize(B);
+    });
+
+    Matrix3D<T> C(n, n, n);
+    report.run("zip_transform", type, n, cells, 3 * bytes, [&] {
+        zip_transform(C, [](const T &a, const T &b) { return cell_less()(a, b) ? a : b; }, A, B);
+        do_not_optimize(C);
+    });
+
+    typedef typename conversion_types<T>::source source_type;
+    typedef typename conversion_types<T>::target target_type;
+    Matrix3D<source_type> source(n, n, n);
+    for (size_t i = 0; i < cells; ++i)
+        *(source.begin() + i) = source_type(i % 100);
+    report.run("conversion", type, n, cells, double(cells) * (sizeof(source_type) + sizeof(target_type)), [&] {
+        Matrix3D<target_type> C(source);
+        do_not_optimize(C);
+    });
+
+    report.run("operator<<", type, n, cells, bytes, [&] {
+        ostringstream os;
+        os << A;
+        do_not_optimize(os);
+    }, 0);
+
+    if constexpr (is_arithmetic<T>::value) {
+        ostringstream text;
+        text << A;
+        const string written = text.str();
+        report.run("operator>>", type, n, cells, bytes, [&] {
+            istringstream is(written);
+            Matrix3D<T> C;
+            is >> C;
+            do_not_optimize(C);
+        }, 0);
+    }
+
+    report.run("sort", type, n, cells, bytes, [&] {
+        Matrix3D<T> C = A;
+        sort(C.begin(), C.end(), cell_less());
+        do_not_optimize(C);
+    }, 0);
+}
+
+// Functor of the parallel scaling benchmark costing a few dozen ns per cell
+struct bench_expensive {
+    float operator()(float a) const {
+        float r = a;
+        for (int k = 0; k < 32; ++k)
+            r = std::sqrt(r * r + 1.0f);
+        return r;
+    }
+};
+
+// Scaling of the parallel trasform with a cheap and an expensive functor, from 1 thread to all the hardware threads
+void bench_parallel(bench_report &report, size_t n) {
+
+    const size_t cells = n * n * n;
+    const double bytes = 2.0 * cells * sizeof(float);
+    Matrix3D<float> A(n, n, n, 0.5f);
+
+    const unsigned int hardware = max(thread::hardware_concurrency(), 1u);
+    for (unsigned int threads = 1; threads <= hardware; threads *= 2) {
+        Matrix3DThreadPool pool(threads);
+        report.run("trasform_parallel_" + to_string(threads), "float", n, cells, bytes, [&] {
+            Matrix3D<float> C = trasform<float, bench_functor<float>>(A, pool);
+            do_not_optimize(C);
+        });
+        report.run("trasform_parallel_expensive_" + to_string(threads), "float", n, cells, bytes, [&] {
+            Matrix3D<float> C = trasform<float>(A, bench_expensive(), pool);
+            do_not_optimize(C);
+        });
+
+        if (threads < hardware && threads * 2 > hardware)
+            threads = hardware / 2; // always measure all the hardware threads too
+    }
+}
+
+// Scan along z and 7-point stencil, in the order of the array, on a layout
+template <typename Matrix>
+void bench_layout(bench_report &report, const string &name, size_t n) {
+
+    const size_t cells = n * n * n;
+    const double bytes = double(cells) * sizeof(float);
+    Matrix volume(n, n, n, 1.0f);
+
+    report.run("scan_z_" + name, "float", n, cells, bytes, [&] {
+        float sum = 0;
+        for (size_t y = 0; y < n; ++y)
+            for (size_t x = 0; x < n; ++x)
+                for (size_t z = 0; z < n; ++z)
+                    sum += volume(z, y, x);
+        do_not_optimize(sum);
+    });
+
+    report.run("stencil_" + name, "float", n, cells, bytes, [&] {
+        float stencil = 0;
+        for (typename Matrix::indexed_iterator i = volume.indexed_begin(); i != volume.indexed_end(); ++i) {
+            const Matrix3DIndex &c = i.index();
+            if (c.z == 0 || c.y == 0 || c.x == 0 || c.z == n - 1 || c.y == n - 1 || c.x == n - 1)
+                continue;
+            stencil += volume(c.z - 1, c.y, c.x) + volume(c.z + 1, c.y, c.x) + volume(c.z, c.y - 1, c.x)
+                + volume(c.z, c.y + 1, c.x) + volume(c.z, c.y, c.x - 1) + volume(c.z, c.y, c.x + 1) - 6 * (*i);
+        }
+        do_not_optimize(stencil);
+    });
+}
+
+int main(int argc, char **argv) {
+
+    bool json = false, quick = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--json") == 0)
+            json = true;
+        else if (strcmp(argv[i], "--quick") == 0)
+            quick = true;
+        else {
+            cerr << "usage: " << argv[0] << " [--json] [--quick]" << endl;
+            return 1;
+        }
+    }
+
+    vector<size_t> sides = {16, 64, 128};
+    if (quick)
+        sides.resize(1);
+
+    bench_report report;
+    for (size_t n : sides) {
+        bench_type<int>(report, n);
+        bench_type<double>(report, n);
+        bench_type<customType>(report, n);
+        bench_parallel(report, n);
+        bench_layout<Matrix3D<float>>(report, "row_major", n);
+        bench_layout<Matrix3D<float, default_functor<float>, allocator<float>, bricked_layout<>>>(report, "bricked", n);
+    }
+
+    if (json)
+        report.print_json(cout);
+    else
+        report.print_csv(cout);
+
+    return 0;
+}
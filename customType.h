@@ -0,0 +1,69 @@
+#ifndef CUSTOM_TYPE_H
+#define CUSTOM_TYPE_H
+
+#include <iostream>
+#include <utility> //swap
+
+// Custom element type used by the tests (main.cpp) and the benchmarks (bench.cpp)
+struct customType {
+
+    int _a;
+    double _b;
+    char _c;
+
+    customType() : _a(0), _b(0), _c('a') {}
+
+    customType(int a, double b, char c) : _a(a), _b(b), _c(c) {};
+
+    customType(const customType &other) {
+        _a = other._a;
+        _b = other._b;
+        _c = other._c;
+    }
+
+    customType(char c) : _a(0), _b(0), _c(c) {}
+
+    customType &operator=(const customType &other) {
+        if(this!=&other) {
+            customType tmp(other);
+            std::swap(_a, tmp._a);
+            std::swap(_b, tmp._b);
+            std::swap(_c, tmp._c);
+        }
+
+        return *this;
+    }
+
+    ~customType() {};
+
+    bool operator==(const customType &other) const {
+        return _a == other._a && _b == other._b && _c == other._c;
+    }
+
+    bool operator!=(const customType &other) const {
+        return !(*this == other);
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const customType &custom) {
+        
+        os << "(" << custom._a << "," << custom._b << "," << custom._c << ")";
+
+        return os;
+    }
+
+    void increase(int a, double b, int c) {
+        _a += a;
+        _b += b;
+        _c += c;
+
+    }
+
+    void init(int a, double b, char c) {
+        _a = a;
+        _b = b;
+        _c = c;
+    }
+
+};
+
+#endif
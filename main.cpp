@@ -1,71 +1,32 @@
 #include <iostream>
 #include <algorithm>
+#include <numeric>
+#include <vector>
+#include <type_traits>
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <stdexcept>
+#include <scoped_allocator>
+#include <cstdio>
+#include <cstring>
 
 #include "Matrix3D.h"
+#include "Matrix3DFile.h"
+#include "TiledMatrix3D.h"
+#include "SparseMatrix3D.h"
+#include "FixedMatrix3D.h"
+#include "RollingMatrix3D.h"
+#include "CowMatrix3D.h"
+#include "HashedMatrix3D.h"
+#include "customType.h"
 
 using namespace std;
 
-struct customType {
-
-    int _a;
-    double _b;
-    char _c;
-
-    customType() : _a(0), _b(0), _c('a') {}
-
-    customType(int a, double b, char c) : _a(a), _b(b), _c(c) {};
-
-    customType(const customType &other) {
-        _a = other._a;
-        _b = other._b;
-        _c = other._c;
-    }
-
-    customType(char c) : _a(0), _b(0), _c(c) {}
-
-    customType &operator=(const customType &other) {
-        if(this!=&other) {
-            customType tmp(other);
-            swap(_a, tmp._a);
-            swap(_b, tmp._b);
-            swap(_c, tmp._c);
-        }
-
-        return *this;
-    }
-
-    ~customType() {};
-
-    bool operator==(const customType &other) const {
-        return _a == other._a && _b == other._b && _c == other._c;
-    }
-
-    bool operator!=(const customType &other) const {
-        return !(*this == other);
-    }
-
-    friend ostream &operator<<(std::ostream &os, const customType &custom) {
-        
-        os << "(" << custom._a << "," << custom._b << "," << custom._c << ")";
-
-        return os;
-    }
-
-    void increase(int a, double b, int c) {
-        _a += a;
-        _b += b;
-        _c += c;
-
-    }
-
-    void init(int a, double b, char c) {
-        _a = a;
-        _b = b;
-        _c = c;
-    }
-
-};
-
 void test_default_constructor() {
 
     // DEFAULT CONSTRUCTOR
@@ -770,6 +731,1945 @@ void test_conversion() {
     cout << endl;
 }
 
+void test_move_semantics() {
+
+    // MOVE CONSTRUCTOR AND MOVE ASSIGNMENT
+
+    cout << "---- MOVE CONSTRUCTOR AND MOVE ASSIGNMENT ----" << endl;
+
+    static_assert(std::is_nothrow_move_constructible<Matrix3D<int>>::value, "Matrix3D must be nothrow move constructible");
+    static_assert(std::is_nothrow_move_assignable<Matrix3D<customType>>::value, "Matrix3D must be nothrow move assignable");
+
+    customType custom(8, 42, 'x');
+    Matrix3D<customType> initialized_mat_custom(2, 3, 10, custom);
+    const customType *cells = initialized_mat_custom.begin();
+
+    Matrix3D<customType> moved_mat_custom(std::move(initialized_mat_custom));
+    assert(moved_mat_custom.begin() == cells); // the array has been stolen, not copied
+    assert(moved_mat_custom.getFloors() == 2 && moved_mat_custom.getRows() == 3 && moved_mat_custom.getColumns() == 10);
+    assert(initialized_mat_custom.getFloors() == 0 && initialized_mat_custom.getRows() == 0 && initialized_mat_custom.getColumns() == 0);
+    assert(initialized_mat_custom.begin() == nullptr);
+
+    Matrix3D<customType> move_assigned_mat_custom(1, 1, 1);
+    move_assigned_mat_custom = std::move(moved_mat_custom);
+    assert(move_assigned_mat_custom.begin() == cells);
+    assert(move_assigned_mat_custom(1, 2, 9) == custom);
+    assert(moved_mat_custom.begin() == nullptr);
+
+    // the moved-from matrix is still usable
+    moved_mat_custom = move_assigned_mat_custom;
+    assert(moved_mat_custom == move_assigned_mat_custom);
+
+    Matrix3D<int> first_mat_int(1, 2, 3, 1);
+    Matrix3D<int> second_mat_int(3, 2, 1, 2);
+    const int *first_cells = first_mat_int.begin();
+    swap(first_mat_int, second_mat_int);
+    assert(second_mat_int.begin() == first_cells && second_mat_int.getColumns() == 3 && second_mat_int(0, 1, 2) == 1);
+
+    struct weird_functor
+    {
+        bool operator()(char a, char b) const {
+            return a > b;
+        }
+    };
+
+    Matrix3D<char> mat_char(1, 2, 2, 'c');
+    const char *char_cells = mat_char.begin();
+    Matrix3D<char, weird_functor> moved_mat_char(std::move(mat_char));
+    assert(moved_mat_char.begin() == char_cells);
+
+    // std::vector relocates by move when growing
+    vector<Matrix3D<int>> matrixes;
+    matrixes.push_back(Matrix3D<int>(2, 2, 2, 7));
+    const int *vector_cells = matrixes[0].begin();
+    for (int i = 0; i < 16; ++i)
+        matrixes.push_back(Matrix3D<int>(1, 1, 1, i));
+    assert(matrixes[0].begin() == vector_cells);
+
+    cout << "Printing Matrix3D<customType> obtained by move assignment" << endl;
+    cout << move_assigned_mat_custom << endl;
+
+    cout << endl;
+}
+
+void test_view() {
+
+    // VIEW
+
+    cout << "---- VIEW ----" << endl;
+
+    Matrix3D<int> increasing_mat_int(3, 4, 5);
+    int j = 0;
+    for (Matrix3D<int>::iterator i = increasing_mat_int.begin(); i != increasing_mat_int.end(); ++i) {
+        (*i) = j; ++j;
+    }
+
+    Matrix3DView<int> view_int = increasing_mat_int.view(1, 2, 1, 3, 2, 4);
+    assert(view_int.getFloors() == 2 && view_int.getRows() == 3 && view_int.getColumns() == 3);
+    assert(&view_int(0, 0, 0) == &increasing_mat_int(1, 1, 2)); // no copy, same cells
+    assert(view_int(1, 2, 2) == increasing_mat_int(2, 3, 4));
+
+    // writes through the view reach the parent matrix
+    view_int(0, 1, 1) = -1;
+    assert(increasing_mat_int(1, 2, 3) == -1);
+
+    // iterators visit the cells in (z, y, x) order
+    int visited = 0;
+    for (Matrix3DView<int>::iterator i = view_int.begin(); i != view_int.end(); ++i, ++visited) {
+        unsigned int z = visited / 9, y = (visited / 3) % 3, x = visited % 3;
+        assert(&(*i) == &view_int(z, y, x));
+        assert(&view_int.begin()[visited] == &view_int(z, y, x));
+    }
+    assert(visited == 18 && view_int.end() - view_int.begin() == 18);
+
+    // a sub-view of a view is still a view on the parent matrix
+    Matrix3DView<int> sub_view_int = view_int.view(1, 1, 0, 2, 1, 1);
+    assert(&sub_view_int(0, 2, 0) == &increasing_mat_int(2, 3, 3));
+
+    // comparison and materialization
+    const Matrix3D<int> &const_mat_int = increasing_mat_int;
+    Matrix3DView<const int> const_view_int = const_mat_int.view(1, 2, 1, 3, 2, 4);
+    assert(const_view_int == view_int);
+
+    Matrix3D<int> materialized_mat_int = view_int.materialize();
+    assert(materialized_mat_int == increasing_mat_int.slice(1, 2, 1, 3, 2, 4));
+    assert(materialized_mat_int.view() == view_int);
+
+    materialized_mat_int(0, 0, 0) = 1000;
+    assert(materialized_mat_int.view() != view_int);
+
+    // std algorithms work through the random access iterators
+    sort(view_int.begin(), view_int.end());
+    assert(is_sorted(view_int.begin(), view_int.end()));
+    assert(increasing_mat_int(1, 1, 2) == -1);
+
+    struct invert
+    {
+        int operator()(int a) {
+            return -a;
+        }
+    };
+
+    Matrix3D<int> inverted_mat_int = trasform<int, invert>(const_view_int);
+    assert(inverted_mat_int.getFloors() == 2 && inverted_mat_int.getRows() == 3 && inverted_mat_int.getColumns() == 3);
+    assert(inverted_mat_int(1, 2, 2) == -const_view_int(1, 2, 2));
+
+    cout << "Printing view (1, 2, 1, 3, 2, 4) of a Matrix3D<int> after sorting its cells" << endl;
+    cout << view_int << endl;
+
+    cout << endl;
+}
+
+void test_64bit_extents() {
+
+    // 64-BIT EXTENTS AND OVERFLOW-CHECKED ALLOCATION
+
+    cout << "---- 64-BIT EXTENTS AND OVERFLOW-CHECKED ALLOCATION ----" << endl;
+
+    static_assert(sizeof(Matrix3D<char>::size_type) == sizeof(size_t), "extents must be size_t");
+
+    Matrix3D<char> mat_char(2, 3, 4, 'a');
+    assert(mat_char.size() == 24);
+    assert(mat_char.end() - mat_char.begin() == 24);
+
+    // the number of cells (or of bytes) would not be addressable: nothing is allocated
+    bool thrown = false;
+    try {
+        Matrix3D<int> huge_mat_int(size_t(1) << 31, size_t(1) << 31, size_t(1) << 31);
+    }
+    catch(const bad_array_new_length &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    thrown = false;
+    try {
+        Matrix3D<double> huge_mat_double(size_t(1) << 21, size_t(1) << 21, size_t(1) << 19, 0.0);
+    }
+    catch(const bad_array_new_length &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    cout << endl;
+}
+
+void test_allocators() {
+
+    // ALLOCATORS
+
+    cout << "---- ALLOCATORS ----" << endl;
+
+    typedef Matrix3D<double, default_functor<double>, aligned_allocator<double>> aligned_mat_double;
+
+    aligned_mat_double aligned_mat(3, 5, 7, 1.5);
+    assert(reinterpret_cast<uintptr_t>(aligned_mat.begin()) % 64 == 0);
+    aligned_mat_double aligned_copy(aligned_mat);
+    assert(reinterpret_cast<uintptr_t>(aligned_copy.begin()) % 64 == 0);
+    assert(aligned_copy == aligned_mat);
+
+    aligned_mat_double aligned_slice = aligned_mat.slice(1, 2, 1, 3, 2, 6);
+    assert(reinterpret_cast<uintptr_t>(aligned_slice.begin()) % 64 == 0);
+
+    typedef Matrix3D<int, default_functor<int>, pool_allocator<int>> pooled_mat_int;
+
+    matrix_pool pool, other_pool;
+    const int *recycled = nullptr;
+    {
+        pooled_mat_int pooled_mat(4, 4, 4, 3, pool_allocator<int>(pool));
+        assert(pooled_mat.get_allocator().pool().misses() == 1);
+        recycled = pooled_mat.begin();
+    }
+    assert(pool.cached_bytes() == 64 * sizeof(int));
+
+    // a matrix with the same shape gets the very same buffer back
+    pooled_mat_int pooled_mat(4, 4, 4, 5, pool_allocator<int>(pool));
+    assert(pooled_mat.begin() == recycled);
+    assert(pool.hits() == 1 && pool.misses() == 1 && pool.cached_bytes() == 0);
+
+    // copies, slices and transforms draw from the pool of the source
+    pooled_mat_int pooled_copy(pooled_mat);
+    assert(pooled_copy.get_allocator() == pooled_mat.get_allocator());
+    pooled_mat_int pooled_slice = pooled_mat.slice(0, 1, 0, 1, 0, 1);
+    assert(pooled_slice.get_allocator() == pooled_mat.get_allocator());
+
+    struct tochar
+    {
+        char operator()(int a) {
+            return static_cast<char>('a' + a);
+        }
+    };
+
+    Matrix3D<char, default_functor<char>, pool_allocator<char>> pooled_chars = trasform<char, tochar>(pooled_mat);
+    assert(&pooled_chars.get_allocator().pool() == &pool);
+    assert(pooled_chars(3, 3, 3) == 'f');
+
+    // the allocator follows the array on swap
+    pooled_mat_int other_mat(1, 1, 1, 0, pool_allocator<int>(other_pool));
+    other_mat.swap(pooled_mat);
+    assert(&other_mat.get_allocator().pool() == &pool && &pooled_mat.get_allocator().pool() == &other_pool);
+
+    pool.release();
+    assert(pool.cached_bytes() == 0);
+
+    cout << endl;
+}
+
+// Cell without padding whose == only looks at the key, so that its bytes may differ between equal cells
+struct keyed_cell {
+    int key;
+    int tag;
+
+    bool operator==(const keyed_cell &other) const {
+        return key == other.key;
+    }
+};
+
+// Cell without padding whose == compares every member, opted in to the bytewise comparison
+struct packed_cell {
+    int key;
+    int tag;
+
+    bool operator==(const packed_cell &other) const {
+        return key == other.key && tag == other.tag;
+    }
+};
+
+template <>
+struct matrix3d_bytewise_equality<packed_cell> : std::true_type {};
+
+void test_mismatch() {
+
+    // BULK COMPARISON AND MISMATCH
+
+    cout << "---- BULK COMPARISON AND MISMATCH ----" << endl;
+
+    static_assert(is_bitwise_comparable<int, default_functor<int>>::value, "int is compared as raw bytes");
+    static_assert(!is_bitwise_comparable<double, default_functor<double>>::value, "-0.0 == 0.0 but their bytes differ");
+    static_assert(!is_bitwise_comparable<customType, default_functor<customType>>::value, "customType has padding");
+    static_assert(!is_bitwise_comparable<keyed_cell, default_functor<keyed_cell>>::value, "class types are not assumed bytewise");
+    static_assert(is_bitwise_comparable<packed_cell, default_functor<packed_cell>>::value, "packed_cell opts in");
+
+    // large enough to go through the SIMD chunks and the tail of the comparison
+    Matrix3D<int> mat_int(3, 17, 19, 4);
+    Matrix3D<int> other_mat_int(mat_int);
+    assert(mat_int == other_mat_int);
+    assert(!mat_int.mismatch(other_mat_int));
+
+    other_mat_int(2, 16, 18) = 5; // last cell, in the tail
+    assert(mat_int != other_mat_int);
+    optional<Matrix3DIndex> index = mat_int.mismatch(other_mat_int);
+    assert(index && index->z == 2 && index->y == 16 && index->x == 18);
+
+    other_mat_int(1, 3, 7) = 5;
+    other_mat_int(0, 0, 5) = 5;
+    index = mat_int.mismatch(other_mat_int);
+    assert(index && *index == (Matrix3DIndex{0, 0, 5}));
+
+    Matrix3D<char> mat_char(2, 40, 40, 'a');
+    for (size_t i = 0; i < mat_char.size(); i += 7) {
+        Matrix3D<char> edited_mat_char(mat_char);
+        edited_mat_char.begin()[i] = 'b';
+        index = mat_char.mismatch(edited_mat_char);
+        assert(index && index->z * 1600 + index->y * 40 + index->x == i);
+    }
+
+    // floating point values still go through the == operator
+    Matrix3D<double> mat_double(1, 2, 2, 0.0);
+    Matrix3D<double> negative_zeros(1, 2, 2, -0.0);
+    assert(mat_double == negative_zeros);
+
+    // a == which ignores a member goes through the generic path, whatever the bytes
+    Matrix3D<keyed_cell> keyed(2, 3, 30, keyed_cell{1, 0});
+    Matrix3D<keyed_cell> other_keyed(2, 3, 30, keyed_cell{1, 7});
+    assert(keyed(0, 0, 0) == other_keyed(0, 0, 0));
+    assert(keyed == other_keyed && !keyed.mismatch(other_keyed));
+    other_keyed(1, 2, 29).key = 2;
+    index = keyed.mismatch(other_keyed);
+    assert(keyed != other_keyed && index && *index == (Matrix3DIndex{1, 2, 29}));
+
+    Matrix3D<packed_cell> packed(2, 3, 30, packed_cell{1, 0});
+    Matrix3D<packed_cell> other_packed(packed);
+    other_packed(1, 2, 29).tag = 7;
+    index = packed.mismatch(other_packed);
+    assert(packed != other_packed && index && *index == (Matrix3DIndex{1, 2, 29}));
+
+    // custom functors keep working through the generic path
+    struct weird_functor
+    {
+        bool operator()(char a, char b) const {
+            return a > b;
+        }
+    };
+
+    Matrix3D<char, weird_functor> weird_mat_char(1, 2, 3, 'c');
+    Matrix3D<char, weird_functor> greater_mat_char(1, 2, 3, 'd');
+    greater_mat_char(0, 1, 1) = 'a';
+    index = weird_mat_char.mismatch(greater_mat_char);
+    assert(index && *index == (Matrix3DIndex{0, 1, 1}));
+
+    customType custom(8, 42, 'x');
+    Matrix3D<customType> mat_custom(2, 3, 10, custom);
+    Matrix3D<customType> edited_mat_custom(mat_custom);
+    edited_mat_custom(1, 0, 4) = customType(0, 0.0, 'O');
+    index = mat_custom.mismatch(edited_mat_custom);
+    assert(index && *index == (Matrix3DIndex{1, 0, 4}));
+
+    cout << endl;
+}
+
+void test_parallel_trasform() {
+
+    // PARALLEL TRASFORM
+
+    cout << "---- PARALLEL TRASFORM ----" << endl;
+
+    Matrix3D<int> increasing_mat_int(7, 33, 65);
+    int j = 0;
+    for (Matrix3D<int>::iterator i = increasing_mat_int.begin(); i != increasing_mat_int.end(); ++i) {
+        (*i) = j; ++j;
+    }
+
+    struct invert
+    {
+        int operator()(int a) {
+            return -a;
+        }
+    };
+
+    Matrix3DThreadPool pool(4);
+    assert(pool.size() == 4);
+
+    Matrix3D<int> inverted_mat_int = trasform<int, invert>(increasing_mat_int);
+    Matrix3D<int> parallel_inverted_mat_int = trasform<int, invert>(increasing_mat_int, pool);
+    assert(parallel_inverted_mat_int == inverted_mat_int);
+
+    // stateful functors and lambdas, sequential and parallel
+    const int offset = 10;
+    Matrix3D<long> shifted_mat_long = trasform<long>(increasing_mat_int, [offset](int a) { return long(a) + offset; });
+    Matrix3D<long> parallel_shifted_mat_long = trasform<long>(increasing_mat_int, [offset](int a) { return long(a) + offset; }, pool);
+    assert(shifted_mat_long == parallel_shifted_mat_long);
+    assert(parallel_shifted_mat_long(6, 32, 64) == long(increasing_mat_int.size()) - 1 + offset);
+
+    atomic<size_t> calls(0);
+    Matrix3D<char> parity_mat_char = trasform<char>(increasing_mat_int, [&calls](int a) { ++calls; return a % 2 ? 'o' : 'e'; }, pool);
+    assert(calls == increasing_mat_int.size());
+    assert(parity_mat_char(0, 0, 1) == 'o' && parity_mat_char(0, 0, 2) == 'e');
+
+    // exceptions thrown by the functor reach the caller
+    bool thrown = false;
+    try {
+        trasform<int>(increasing_mat_int, [](int a) { if (a == 9000) throw a; return a; }, pool);
+    }
+    catch(int a) {
+        thrown = (a == 9000);
+    }
+    assert(thrown);
+
+    // parallel loops nested in a parallel loop run on the calling thread
+    atomic<size_t> visited(0);
+    pool.parallel_for(0, 16, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+            pool.parallel_for(0, 100, [&](size_t f, size_t l) { visited += l - f; });
+    });
+    assert(visited == 1600);
+
+    cout << endl;
+}
+
+void test_expression_templates() {
+
+    // EXPRESSION TEMPLATES
+
+    cout << "---- EXPRESSION TEMPLATES ----" << endl;
+
+    Matrix3D<int> a(2, 3, 4), b(2, 3, 4), c(2, 3, 4);
+    int j = 0;
+    for (Matrix3D<int>::size_type i = 0; i < a.size(); ++i, ++j) {
+        a.begin()[i] = j;
+        b.begin()[i] = 2 * j;
+        c.begin()[i] = j % 5;
+    }
+
+    // arithmetic with scalar broadcast, evaluated in one pass
+    Matrix3D<int> result = a * b + c - 3;
+    for (Matrix3D<int>::size_type i = 0; i < result.size(); ++i)
+        assert(result.begin()[i] == a.begin()[i] * b.begin()[i] + c.begin()[i] - 3);
+    assert(result(1, 2, 3) == 23 * 46 + 3 - 3);
+
+    Matrix3D<double> halves = (a + 1) / 2.0;
+    assert(halves(0, 0, 0) == 0.5 && halves(0, 0, 1) == 1.0);
+
+    Matrix3D<int> negated = -a;
+    assert(negated(1, 2, 3) == -23);
+
+    // comparisons and where()
+    Matrix3D<bool> greater = b > a;
+    assert(!greater(0, 0, 0) && greater(0, 0, 1));
+    Matrix3D<int> clamped = where(a < 10, a, 10);
+    assert(clamped(0, 2, 1) == 9 && clamped(0, 2, 2) == 10 && clamped(1, 2, 3) == 10);
+
+    Matrix3D<bool> equal = elementwise_equal(b, a + a);
+    assert(find(equal.begin(), equal.end(), false) == equal.end());
+    Matrix3D<bool> different = elementwise_not_equal(c, 0);
+    assert(!different(0, 0, 0) && different(0, 0, 1));
+
+    // assignment in place, even when the target is an operand
+    Matrix3D<int> aliased = a;
+    int *cells = aliased.begin();
+    aliased = aliased * 2 + aliased;
+    assert(aliased.begin() == cells);
+    assert(aliased(1, 2, 3) == 69);
+
+    // assignment of an expression with different dimensions reallocates
+    Matrix3D<int> small(1, 1, 1);
+    small = a + b;
+    assert(small.getFloors() == 2 && small.getRows() == 3 && small.getColumns() == 4);
+    assert(small(1, 2, 3) == 69);
+
+    // compound assignments
+    Matrix3D<int> compound = a;
+    compound += b;
+    compound -= a * 2;
+    compound *= 3;
+    compound /= c + 1;
+    for (Matrix3D<int>::size_type i = 0; i < compound.size(); ++i)
+        assert(compound.begin()[i] == 3 * a.begin()[i] / (c.begin()[i] + 1));
+
+    // no intermediate matrix gets allocated
+    matrix_pool pool;
+    pool_allocator<int> alloc(pool);
+    Matrix3D<int, default_functor<int>, pool_allocator<int>> pa(2, 3, 4, 1, alloc), pb(2, 3, 4, 2, alloc);
+    const size_t misses = pool.misses(), hits = pool.hits();
+    Matrix3D<int, default_functor<int>, pool_allocator<int>> fused(pa * pb + pa - pb * 4 + 1, alloc);
+    assert(pool.misses() + pool.hits() == misses + hits + 1);
+    assert(fused(1, 2, 3) == 1 * 2 + 1 - 8 + 1);
+
+    cout << endl;
+}
+
+void test_reductions() {
+
+    // REDUCTIONS
+
+    cout << "---- REDUCTIONS ----" << endl;
+
+    Matrix3D<int> increasing_mat_int(3, 4, 5);
+    int j = 0;
+    for (Matrix3D<int>::iterator i = increasing_mat_int.begin(); i != increasing_mat_int.end(); ++i) {
+        (*i) = (j * 7) % 11; ++j;
+    }
+
+    // full reductions against std algorithms
+    assert(reduce_all<sum_reduction>(increasing_mat_int) == accumulate(increasing_mat_int.begin(), increasing_mat_int.end(), 0LL));
+    assert(reduce_all<min_reduction>(increasing_mat_int) == *min_element(increasing_mat_int.begin(), increasing_mat_int.end()));
+    assert(reduce_all<max_reduction>(increasing_mat_int) == 10);
+    double mean = accumulate(increasing_mat_int.begin(), increasing_mat_int.end(), 0.0) / increasing_mat_int.size();
+    assert(fabs(reduce_all<mean_reduction>(increasing_mat_int) - mean) < 1e-12);
+    double variance = 0;
+    for (Matrix3D<int>::iterator i = increasing_mat_int.begin(); i != increasing_mat_int.end(); ++i)
+        variance += (*i - mean) * (*i - mean);
+    variance /= increasing_mat_int.size();
+    assert(fabs(reduce_all<variance_reduction>(increasing_mat_int) - variance) < 1e-12);
+
+    // argmax gives the first occurrence of the largest value (j = 3)
+    Matrix3DIndex largest = reduce_all<argmax_reduction>(increasing_mat_int);
+    assert(largest == (Matrix3DIndex{0, 0, 3}));
+
+    // axis reductions against triple loops
+    Matrix3D<long long> sum_z = reduce<sum_reduction>(increasing_mat_int, Matrix3DAxis::z);
+    Matrix3D<long long> sum_y = reduce<sum_reduction>(increasing_mat_int, Matrix3DAxis::y);
+    Matrix3D<int> max_x = reduce<max_reduction>(increasing_mat_int, Matrix3DAxis::x);
+    Matrix3D<size_t> argmax_y = reduce<argmax_reduction>(increasing_mat_int, Matrix3DAxis::y);
+    assert(sum_z.getFloors() == 1 && sum_z.getRows() == 4 && sum_z.getColumns() == 5);
+    assert(sum_y.getFloors() == 3 && sum_y.getRows() == 1 && sum_y.getColumns() == 5);
+    assert(max_x.getFloors() == 3 && max_x.getRows() == 4 && max_x.getColumns() == 1);
+    for (size_t z = 0; z < 3; ++z)
+        for (size_t y = 0; y < 4; ++y)
+            for (size_t x = 0; x < 5; ++x) {
+                long long along_z = 0, along_y = 0;
+                int along_x = increasing_mat_int(z, y, 0);
+                size_t best_y = 0;
+                for (size_t k = 0; k < 3; ++k) along_z += increasing_mat_int(k, y, x);
+                for (size_t k = 0; k < 4; ++k) {
+                    along_y += increasing_mat_int(z, k, x);
+                    if (increasing_mat_int(z, k, x) > increasing_mat_int(z, best_y, x)) best_y = k;
+                }
+                for (size_t k = 0; k < 5; ++k) along_x = max(along_x, increasing_mat_int(z, y, k));
+                assert(sum_z(0, y, x) == along_z);
+                assert(sum_y(z, 0, x) == along_y);
+                assert(max_x(z, y, 0) == along_x);
+                assert(argmax_y(z, 0, x) == best_y);
+            }
+
+    // a 1D vector, reducing twice
+    Matrix3D<long long> sum_zy = reduce<sum_reduction>(sum_z, Matrix3DAxis::y);
+    assert(sum_zy.getFloors() == 1 && sum_zy.getRows() == 1 && sum_zy.getColumns() == 5);
+    assert(reduce_all<sum_reduction>(sum_zy) == reduce_all<sum_reduction>(increasing_mat_int));
+
+    // compensated floating point sum
+    Matrix3D<float> tenths(16, 256, 256, 0.1f);
+    float naive = 0.0f;
+    for (Matrix3D<float>::iterator i = tenths.begin(); i != tenths.end(); ++i)
+        naive += *i;
+    const double exact = double(0.1f) * tenths.size();
+    float kahan = reduce_all<sum_reduction>(tenths);
+    assert(fabs(kahan - exact) / exact < 1e-6);
+    assert(fabs(naive - exact) > fabs(kahan - exact));
+    assert(fabs(reduce_all<mean_reduction>(tenths) - 0.1f) < 1e-7);
+
+    // variance is stable with a large offset
+    Matrix3D<double> offset(2, 50, 50);
+    j = 0;
+    for (Matrix3D<double>::iterator i = offset.begin(); i != offset.end(); ++i, ++j)
+        (*i) = 1e9 + (j % 2);
+    assert(fabs(reduce_all<variance_reduction>(offset) - 0.25) < 1e-9);
+
+    // parallel reductions give exactly the sequential results
+    Matrix3DThreadPool pool(4);
+    Matrix3D<double> noise(9, 70, 130);
+    j = 0;
+    for (Matrix3D<double>::iterator i = noise.begin(); i != noise.end(); ++i, ++j)
+        (*i) = sin(j * 0.37) * 1000.0;
+    assert(reduce_all<sum_reduction>(noise, pool) == reduce_all<sum_reduction>(noise));
+    assert(reduce_all<variance_reduction>(noise, pool) == reduce_all<variance_reduction>(noise));
+    assert(reduce_all<argmax_reduction>(noise, pool) == reduce_all<argmax_reduction>(noise));
+    assert(reduce<mean_reduction>(noise, Matrix3DAxis::z, pool) == reduce<mean_reduction>(noise, Matrix3DAxis::z));
+    assert(reduce<min_reduction>(noise, Matrix3DAxis::y, pool) == reduce<min_reduction>(noise, Matrix3DAxis::y));
+    assert(reduce<sum_reduction>(noise, Matrix3DAxis::x, pool) == reduce<sum_reduction>(noise, Matrix3DAxis::x));
+
+    // empty matrixes
+    Matrix3D<int> empty;
+    assert(reduce_all<sum_reduction>(empty) == 0);
+    assert(reduce<sum_reduction>(empty, Matrix3DAxis::x).size() == 0);
+
+    cout << endl;
+}
+
+void test_binary_io() {
+
+    // BINARY FILES AND MAPPING
+
+    cout << "---- BINARY FILES AND MAPPING ----" << endl;
+
+    Matrix3D<float> increasing_mat_float(5, 6, 7);
+    int j = 0;
+    for (Matrix3D<float>::iterator i = increasing_mat_float.begin(); i != increasing_mat_float.end(); ++i) {
+        (*i) = j * 0.5f; ++j;
+    }
+
+    // round trip through a stream
+    stringstream buffer;
+    save_binary(increasing_mat_float, buffer);
+    assert(buffer.str().size() == matrix3d_binary_header::size + increasing_mat_float.size() * sizeof(float));
+    Matrix3D<float> loaded = load_binary<float>(buffer);
+    assert(loaded.getFloors() == 5 && loaded.getRows() == 6 && loaded.getColumns() == 7);
+    assert(loaded == increasing_mat_float);
+
+    // the element type must match
+    buffer.seekg(0);
+    bool thrown = false;
+    try {
+        load_binary<int>(buffer);
+    }
+    catch(runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // files written with the other byte order are converted
+    string swapped = buffer.str();
+    matrix3d_binary_header header;
+    memcpy(&header, swapped.data(), sizeof(header));
+    header.swap_bytes();
+    memcpy(&swapped[0], &header, sizeof(header));
+    for (size_t i = matrix3d_binary_header::size; i < swapped.size(); i += sizeof(float))
+        reverse(swapped.begin() + i, swapped.begin() + i + sizeof(float));
+    stringstream swapped_buffer(swapped);
+    assert(load_binary<float>(swapped_buffer) == increasing_mat_float);
+
+    // empty matrixes
+    stringstream empty_buffer;
+    save_binary(Matrix3D<int>(), empty_buffer);
+    assert(load_binary<int>(empty_buffer).size() == 0);
+
+    // cells of 256 bytes or more
+    struct wide_cell { double values[40]; };
+    static_assert(sizeof(wide_cell) > 255, "the cell must not fit in a byte");
+    Matrix3D<wide_cell> wide(2, 3, 4);
+    for (size_t i = 0; i < wide.size(); ++i)
+        fill(begin((wide.begin() + i)->values), end((wide.begin() + i)->values), double(i));
+    stringstream wide_buffer;
+    save_binary(wide, wide_buffer);
+    Matrix3D<wide_cell> wide_loaded = load_binary<wide_cell>(wide_buffer);
+    assert(wide_loaded.size() == wide.size() && as_const(wide_loaded)(1, 2, 3).values[39] == 23.0);
+
+    // mapped files, read-only
+    const string path = "test_matrix3d.m3d";
+    save_binary(increasing_mat_float, path);
+    assert(load_binary<float>(path) == increasing_mat_float);
+    {
+        Matrix3D<float, default_functor<float>, mapped_allocator<float>> mapped = map_binary<float>(path);
+        assert(mapped.get_allocator().mapping() != nullptr);
+        assert(mapped.get_allocator().mapping()->contains(mapped.begin()));
+        assert(reinterpret_cast<uintptr_t>(mapped.begin()) % 64 == 0);
+        assert(mapped(4, 5, 6) == increasing_mat_float(4, 5, 6));
+        assert(equal(mapped.begin(), mapped.end(), increasing_mat_float.begin()));
+
+        // copies are ordinary matrixes on the heap
+        Matrix3D<float, default_functor<float>, mapped_allocator<float>> copy(mapped);
+        assert(copy.get_allocator().mapping() == nullptr);
+        copy(0, 0, 0) = -1.0f;
+        assert(mapped(0, 0, 0) == 0.0f);
+
+        // the mapping follows the array when moved
+        Matrix3D<float, default_functor<float>, mapped_allocator<float>> moved(std::move(mapped));
+        assert(moved.get_allocator().mapping()->contains(moved.begin()));
+        assert(moved(1, 2, 3) == increasing_mat_float(1, 2, 3));
+        copy = std::move(moved);
+        assert(copy(1, 2, 3) == increasing_mat_float(1, 2, 3));
+    }
+
+    // mapped files, copy-on-write: changes never reach the file
+    {
+        Matrix3D<float, default_functor<float>, mapped_allocator<float>> mapped = map_binary<float>(path, Matrix3DMapping::copy_on_write);
+        mapped(2, 2, 2) = 1000.0f;
+        assert(mapped(2, 2, 2) == 1000.0f);
+        Matrix3D<float, default_functor<float>, mapped_allocator<float>> remapped = map_binary<float>(path);
+        assert(remapped(2, 2, 2) == increasing_mat_float(2, 2, 2));
+    }
+
+    // truncated files are refused
+    {
+        ofstream truncated(path, ios::binary | ios::trunc);
+        truncated.write(swapped.data(), 100);
+    }
+    thrown = false;
+    try {
+        map_binary<float>(path);
+    }
+    catch(runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    remove(path.c_str());
+
+    cout << endl;
+}
+
+void test_tiled() {
+
+    // OUT-OF-CORE TILED MATRIX
+
+    cout << "---- OUT-OF-CORE TILED MATRIX ----" << endl;
+
+    const string path = "test_tiled.m3dt", transformed_path = "test_tiled_transformed.m3dt";
+
+    // 40 x 50 x 70 cells in bricks of 8 x 16 x 16, at most 4 of them in memory
+    const size_t brick_bytes = 8 * 16 * 16 * sizeof(int);
+    {
+        TiledMatrix3D<int> tiled(path, 40, 50, 70, 4 * brick_bytes, 8, 16, 16);
+        assert(tiled.getFloors() == 40 && tiled.getRows() == 50 && tiled.getColumns() == 70);
+        assert(tiled.bricks() == 5 * 4 * 5);
+        assert(tiled(39, 49, 69) == 0);
+
+        for (size_t z = 0; z < 40; ++z)
+            for (size_t y = 0; y < 50; ++y)
+                for (size_t x = 0; x < 70; ++x)
+                    tiled(z, y, x) = int((z * 50 + y) * 70 + x);
+
+        assert(tiled.resident_bricks() == 4);
+        assert(tiled.writebacks() >= tiled.bricks() - 4);
+
+        const TiledMatrix3D<int> &constant = tiled;
+        assert(constant(12, 34, 56) == (12 * 50 + 34) * 70 + 56);
+
+        // slices are in-memory matrixes
+        Matrix3D<int> sliced = tiled.slice(5, 9, 10, 40, 3, 60);
+        assert(sliced.getFloors() == 5 && sliced.getRows() == 31 && sliced.getColumns() == 58);
+        for (size_t z = 0; z < 5; ++z)
+            for (size_t y = 0; y < 31; ++y)
+                for (size_t x = 0; x < 58; ++x)
+                    assert(sliced(z, y, x) == int(((z + 5) * 50 + y + 10) * 70 + x + 3));
+
+        // transform brick by brick into a new file
+        TiledMatrix3D<long> doubled = trasform<long>(tiled, transformed_path, [](int a) { return 2L * a; });
+        assert(doubled(39, 49, 69) == 2L * ((39 * 50 + 49) * 70 + 69));
+        assert(doubled.getBrickFloors() == 8 && doubled.getBrickRows() == 16 && doubled.getBrickColumns() == 16);
+
+        tiled.flush();
+        tiled.set_memory_budget(brick_bytes);
+        assert(tiled.resident_bricks() == 1);
+
+        // moves take over the file and the cache
+        TiledMatrix3D<int> moved(std::move(tiled));
+        assert(moved(1, 2, 3) == (1 * 50 + 2) * 70 + 3);
+        moved(1, 2, 3) = -1;
+    }
+
+    // the changes are in the file, written back on destruction
+    {
+        TiledMatrix3D<int> reopened(path, 1 << 20);
+        assert(reopened.getFloors() == 40 && reopened.getBrickRows() == 16);
+        assert(reopened(1, 2, 3) == -1);
+        assert(reopened(25, 0, 69) == (25 * 50) * 70 + 69);
+        assert(reopened.loads() == 2 && reopened.writebacks() == 0);
+
+        TiledMatrix3D<long> doubled(transformed_path);
+        assert(doubled(20, 20, 20) == 2L * ((20 * 50 + 20) * 70 + 20));
+
+        // floor by floor scans
+        long long sum = 0;
+        for (size_t z = 0; z < 40; ++z)
+            for (size_t y = 0; y < 50; ++y)
+                for (size_t x = 0; x < 70; ++x)
+                    sum += doubled(z, y, x);
+        assert(sum == 2LL * (140000LL * 139999 / 2));
+    }
+
+    // cells of 256 bytes or more
+    {
+        struct wide_cell { double values[40]; };
+        {
+            TiledMatrix3D<wide_cell> wide(transformed_path, 4, 4, 4, 1 << 20, 2, 2, 2);
+            wide(3, 2, 1).values[39] = 7.0;
+        }
+        TiledMatrix3D<wide_cell> reopened(transformed_path, 1 << 20);
+        assert(reopened(3, 2, 1).values[39] == 7.0);
+    }
+
+    // the element type must match
+    bool thrown = false;
+    try {
+        TiledMatrix3D<float> wrong(path);
+    }
+    catch(runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    // corrupted brick sides, whose cells do not fit in a size_t, are refused
+    for (uint32_t side : {uint32_t(1) << 31, uint32_t(1) << 21}) {
+        tiled_matrix3d_header header;
+        {
+            ifstream in(path, ios::binary);
+            in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        }
+        header.brick_floors = header.brick_rows = header.brick_columns = side;
+        {
+            ofstream out(transformed_path, ios::binary | ios::trunc);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        }
+        bool corrupted = false;
+        try {
+            TiledMatrix3D<int> reopened(transformed_path);
+        }
+        catch(runtime_error &) {
+            corrupted = true;
+        }
+        assert(corrupted);
+    }
+
+    remove(path.c_str());
+    remove(transformed_path.c_str());
+
+    cout << endl;
+}
+
+void test_layouts() {
+
+    // LAYOUT POLICIES
+
+    cout << "---- LAYOUT POLICIES ----" << endl;
+
+    typedef bricked_layout<4, 4, 4> bricks;
+    typedef Matrix3D<int, default_functor<int>, allocator<int>, bricks> bricked_mat_int;
+
+    // the bricked layout is a bijection, also with partial bricks on the edges
+    const size_t floors = 10, rows = 9, columns = 7;
+    vector<bool> used(floors * rows * columns, false);
+    for (size_t z = 0; z < floors; ++z)
+        for (size_t y = 0; y < rows; ++y)
+            for (size_t x = 0; x < columns; ++x) {
+                size_t offset = bricks::offset(z, y, x, floors, rows, columns);
+                assert(offset < used.size() && !used[offset]);
+                used[offset] = true;
+                assert(bricks::index(offset, floors, rows, columns) == (Matrix3DIndex{z, y, x}));
+            }
+    // the first brick is contiguous
+    assert(bricks::offset(3, 3, 3, floors, rows, columns) == 63);
+    assert(bricks::offset(0, 0, 4, floors, rows, columns) == 64);
+
+    bricked_mat_int bricked(floors, rows, columns);
+    Matrix3D<int> row_major(floors, rows, columns);
+    for (size_t z = 0; z < floors; ++z)
+        for (size_t y = 0; y < rows; ++y)
+            for (size_t x = 0; x < columns; ++x)
+                bricked(z, y, x) = row_major(z, y, x) = int((z * rows + y) * columns + x);
+
+    // conversions between layouts keep the coordinates of the cells
+    assert(Matrix3D<int>(bricked) == row_major);
+    assert(bricked_mat_int(row_major) == bricked);
+
+    // iterators walk brick by brick, and know where they are
+    assert(*bricked.begin() == 0 && *(bricked.begin() + 4) == 7 && *(bricked.begin() + 64) == 4);
+    for (bricked_mat_int::iterator i = bricked.begin(); i != bricked.end(); ++i) {
+        Matrix3DIndex index = bricked.index_of(i);
+        assert(*i == row_major(index.z, index.y, index.x));
+    }
+    size_t visited = 0;
+    for (bricked_mat_int::const_indexed_iterator i = bricked.indexed_begin(); i != bricked.indexed_end(); ++i, ++visited)
+        assert(i.index() == bricked.index_of(&*i));
+    assert(visited == bricked.size());
+    for (Matrix3D<int>::indexed_iterator i = row_major.indexed_begin(); i != row_major.indexed_end(); ++i)
+        assert(*i == row_major(i.index().z, i.index().y, i.index().x));
+
+    // slices, comparisons, expressions and reductions work on any layout
+    bricked_mat_int sliced = bricked.slice(2, 6, 3, 8, 1, 5);
+    assert(Matrix3D<int>(sliced) == row_major.slice(2, 6, 3, 8, 1, 5));
+
+    bricked_mat_int changed = bricked;
+    changed(7, 5, 6) = -1;
+    assert(changed.mismatch(bricked) == (Matrix3DIndex{7, 5, 6}));
+
+    bricked_mat_int doubled = bricked * 2 + 1;
+    assert(doubled(9, 8, 6) == 2 * row_major(9, 8, 6) + 1);
+    assert(Matrix3D<int>(trasform<int>(bricked, [](int a) { return a + 1; })) == row_major + 1);
+
+    assert(reduce_all<sum_reduction>(bricked) == reduce_all<sum_reduction>(row_major));
+    assert(reduce_all<argmax_reduction>(bricked) == (Matrix3DIndex{9, 8, 6}));
+    assert(Matrix3D<long long>(reduce<sum_reduction>(bricked, Matrix3DAxis::z)) == reduce<sum_reduction>(row_major, Matrix3DAxis::z));
+    assert(Matrix3D<int>(reduce<max_reduction>(bricked, Matrix3DAxis::x)) == reduce<max_reduction>(row_major, Matrix3DAxis::x));
+
+    // binary files are always row-major
+    stringstream buffer;
+    save_binary(bricked, buffer);
+    assert(load_binary<int>(buffer) == row_major);
+    buffer.seekg(0);
+    assert((load_binary<int, default_functor<int>, allocator<int>, bricks>(buffer)) == bricked);
+
+    cout << endl;
+}
+
+void test_morton_layout() {
+
+    // MORTON LAYOUT
+
+    cout << "---- MORTON LAYOUT ----" << endl;
+
+    // codes interleave the bits of the coordinates, x lowest
+    assert(morton_code::encode(0, 0, 1) == 1 && morton_code::encode(0, 1, 0) == 2 && morton_code::encode(1, 0, 0) == 4);
+    assert(morton_code::encode(1023, 1023, 1023) == (1u << 30) - 1);
+    for (uint32_t v = 0; v < 1024; v += 7) {
+        uint32_t z, y, x;
+        morton_code::decode(morton_code::encode(v, 1023 - v, v / 3), z, y, x);
+        assert(z == v && y == 1023 - v && x == v / 3);
+    }
+
+    typedef morton_layout<3> morton;
+    typedef Matrix3D<int, default_functor<int>, allocator<int>, morton> morton_mat_int;
+
+    // bijection with whole bricks in Z-order and row-major edge bricks
+    const size_t floors = 19, rows = 16, columns = 11;
+    vector<bool> used(floors * rows * columns, false);
+    for (size_t z = 0; z < floors; ++z)
+        for (size_t y = 0; y < rows; ++y)
+            for (size_t x = 0; x < columns; ++x) {
+                size_t offset = morton::offset(z, y, x, floors, rows, columns);
+                assert(offset < used.size() && !used[offset]);
+                used[offset] = true;
+                assert(morton::index(offset, floors, rows, columns) == (Matrix3DIndex{z, y, x}));
+            }
+    assert(morton::offset(1, 1, 1, floors, rows, columns) == 7);
+    assert(morton::offset(0, 0, 2, floors, rows, columns) == 8);
+    assert(morton::offset(7, 7, 7, floors, rows, columns) == 511);
+
+    morton_mat_int zorder(floors, rows, columns);
+    Matrix3D<int> row_major(floors, rows, columns);
+    for (size_t z = 0; z < floors; ++z)
+        for (size_t y = 0; y < rows; ++y)
+            for (size_t x = 0; x < columns; ++x)
+                zorder(z, y, x) = row_major(z, y, x) = int((z * rows + y) * columns + x);
+
+    // conversions to and from the row-major layout
+    assert(Matrix3D<int>(zorder) == row_major);
+    assert(morton_mat_int(row_major) == zorder);
+
+    // the iterators walk in Z-order
+    assert(*(zorder.begin() + 3) == row_major(0, 1, 1) && *(zorder.begin() + 4) == row_major(1, 0, 0));
+    size_t visited = 0;
+    for (morton_mat_int::indexed_iterator i = zorder.indexed_begin(); i != zorder.indexed_end(); ++i, ++visited) {
+        assert(i.index() == zorder.index_of(&*i));
+        assert(*i == row_major(i.index().z, i.index().y, i.index().x));
+    }
+    assert(visited == zorder.size());
+
+    assert(Matrix3D<int>(zorder.slice(3, 17, 2, 15, 0, 9)) == row_major.slice(3, 17, 2, 15, 0, 9));
+    assert(reduce_all<argmax_reduction>(zorder) == (Matrix3DIndex{18, 15, 10}));
+
+    cout << endl;
+}
+
+// Stencil computed cell by cell, as a reference for apply_stencil
+template <typename Matrix, typename W>
+Matrix3D<int> naive_stencil(const Matrix &A, const stencil_kernel<W> &kernel, Matrix3DBoundary boundary) {
+    const ptrdiff_t floors = A.getFloors(), rows = A.getRows(), columns = A.getColumns();
+    Matrix3D<int> out(floors, rows, columns);
+    for (ptrdiff_t z = 0; z < floors; ++z)
+        for (ptrdiff_t y = 0; y < rows; ++y)
+            for (ptrdiff_t x = 0; x < columns; ++x) {
+                int value = 0;
+                for (const stencil_tap<W> &t : kernel.taps()) {
+                    ptrdiff_t sz = z + t.dz, sy = y + t.dy, sx = x + t.dx;
+                    if (boundary == Matrix3DBoundary::clamp) {
+                        sz = min(max<ptrdiff_t>(sz, 0), floors - 1);
+                        sy = min(max<ptrdiff_t>(sy, 0), rows - 1);
+                        sx = min(max<ptrdiff_t>(sx, 0), columns - 1);
+                    }
+                    else if (boundary == Matrix3DBoundary::wrap) {
+                        sz = ((sz % floors) + floors) % floors;
+                        sy = ((sy % rows) + rows) % rows;
+                        sx = ((sx % columns) + columns) % columns;
+                    }
+                    else if (sz < 0 || sy < 0 || sx < 0 || sz >= floors || sy >= rows || sx >= columns)
+                        continue;
+                    value += t.weight * A(sz, sy, sx);
+                }
+                out(z, y, x) = value;
+            }
+    return out;
+}
+
+void test_stencils() {
+
+    // STENCILS
+
+    cout << "---- STENCILS ----" << endl;
+
+    const size_t floors = 9, rows = 21, columns = 600;
+    Matrix3D<int> A(floors, rows, columns);
+    for (size_t z = 0; z < floors; ++z)
+        for (size_t y = 0; y < rows; ++y)
+            for (size_t x = 0; x < columns; ++x)
+                A(z, y, x) = int((z * 31 + y * 7 + x * 3) % 17) - 8;
+    Matrix3D<int, default_functor<int>, allocator<int>, bricked_layout<4, 4, 4>> bricked(A);
+
+    Matrix3D<int> weights(3, 3, 5);
+    for (size_t i = 0; i < weights.size(); ++i)
+        *(weights.begin() + i) = int(i % 5) - 2;
+
+    stencil_kernel<int> kernels[] = {
+        stencil_kernel<int>::seven_point(-6, 1),
+        stencil_kernel<int>::twenty_seven_point(8, 4, 2, 1),
+        stencil_kernel<int>::from_matrix(weights)
+    };
+    stencil_kernel<int> far;
+    far.add(0, 0, -700, 1); // further than the size of the matrix
+    far.add(-10, 22, 3, 2);
+
+    assert(kernels[0].taps().size() == 7 && kernels[1].taps().size() == 27 && kernels[2].taps().size() == 45);
+
+    Matrix3DThreadPool pool(4);
+    const Matrix3DBoundary boundaries[] = {Matrix3DBoundary::clamp, Matrix3DBoundary::wrap, Matrix3DBoundary::zero};
+    for (Matrix3DBoundary boundary : boundaries) {
+        for (const stencil_kernel<int> &kernel : kernels) {
+            Matrix3D<int> expected = naive_stencil(A, kernel, boundary);
+            Matrix3D<int> out(floors, rows, columns);
+            apply_stencil(A, kernel, boundary, out);
+            assert(out == expected);
+            Matrix3D<int> parallel_out(floors, rows, columns, 1);
+            apply_stencil(A, kernel, boundary, parallel_out, pool);
+            assert(parallel_out == expected);
+            Matrix3D<int, default_functor<int>, allocator<int>, bricked_layout<4, 4, 4>> bricked_out(floors, rows, columns);
+            apply_stencil(bricked, kernel, boundary, bricked_out, pool);
+            assert(Matrix3D<int>(bricked_out) == expected);
+        }
+        Matrix3D<int> out(floors, rows, columns);
+        apply_stencil(A, far, boundary, out);
+        assert(out == naive_stencil(A, far, boundary));
+    }
+
+    // the weights of the taps at the same offset add up
+    stencil_kernel<int> twice;
+    twice.add(0, 1, 0, 2);
+    twice.add(0, 1, 0, 3);
+    assert(twice.taps().size() == 1 && twice.taps()[0].weight == 5);
+
+    cout << endl;
+}
+
+// Checks permute_axes<A0, A1, A2> against the definition, out of place and in place
+template <Matrix3DAxis A0, Matrix3DAxis A1, Matrix3DAxis A2, typename Matrix>
+void check_permutation(const Matrix &A, Matrix3DThreadPool &pool) {
+    Matrix B = permute_axes<A0, A1, A2>(A);
+    size_t dims[3] = {A.getFloors(), A.getRows(), A.getColumns()};
+    assert(B.getFloors() == dims[int(A0)] && B.getRows() == dims[int(A1)] && B.getColumns() == dims[int(A2)]);
+    size_t i[3];
+    for (i[0] = 0; i[0] < B.getFloors(); ++i[0])
+        for (i[1] = 0; i[1] < B.getRows(); ++i[1])
+            for (i[2] = 0; i[2] < B.getColumns(); ++i[2]) {
+                size_t a[3];
+                a[int(A0)] = i[0];
+                a[int(A1)] = i[1];
+                a[int(A2)] = i[2];
+                assert(B(i[0], i[1], i[2]) == A(a[0], a[1], a[2]));
+            }
+    assert((permute_axes<A0, A1, A2>(A, pool)) == B);
+
+    Matrix C = A;
+    permute_axes_in_place<A0, A1, A2>(C);
+    assert(C == B);
+    C = A;
+    permute_axes_in_place<A0, A1, A2>(C, pool);
+    assert(C == B);
+}
+
+template <typename Matrix>
+void check_permutations(const Matrix &A, Matrix3DThreadPool &pool) {
+    check_permutation<Matrix3DAxis::z, Matrix3DAxis::y, Matrix3DAxis::x>(A, pool);
+    check_permutation<Matrix3DAxis::z, Matrix3DAxis::x, Matrix3DAxis::y>(A, pool);
+    check_permutation<Matrix3DAxis::y, Matrix3DAxis::z, Matrix3DAxis::x>(A, pool);
+    check_permutation<Matrix3DAxis::y, Matrix3DAxis::x, Matrix3DAxis::z>(A, pool);
+    check_permutation<Matrix3DAxis::x, Matrix3DAxis::z, Matrix3DAxis::y>(A, pool);
+    check_permutation<Matrix3DAxis::x, Matrix3DAxis::y, Matrix3DAxis::z>(A, pool);
+}
+
+void test_permute_axes() {
+
+    // AXIS PERMUTATIONS
+
+    cout << "---- AXIS PERMUTATIONS ----" << endl;
+
+    Matrix3DThreadPool pool(4);
+
+    // cells of 1, 4 and 8 bytes, dimensions which are not multiples of the tiles
+    Matrix3D<int> ints(7, 45, 70);
+    iota(ints.begin(), ints.end(), 0);
+    check_permutations(ints, pool);
+
+    Matrix3D<double> doubles(33, 5, 66);
+    iota(doubles.begin(), doubles.end(), 0.5);
+    check_permutations(doubles, pool);
+
+    Matrix3D<char> chars(3, 40, 9);
+    for (size_t i = 0; i < chars.size(); ++i)
+        *(chars.begin() + i) = char('a' + i % 26);
+    check_permutations(chars, pool);
+
+    // in place: cube, square floors, same floors and columns
+    Matrix3D<float> cube(37, 37, 37);
+    iota(cube.begin(), cube.end(), 0.0f);
+    check_permutations(cube, pool);
+    Matrix3D<int> square(6, 50, 50);
+    iota(square.begin(), square.end(), 0);
+    check_permutations(square, pool);
+    Matrix3D<int> flat(20, 3, 20);
+    iota(flat.begin(), flat.end(), 0);
+    check_permutations(flat, pool);
+
+    // cells which are not trivially copyable, other layouts
+    Matrix3D<string> strings(4, 5, 4);
+    for (size_t i = 0; i < strings.size(); ++i)
+        *(strings.begin() + i) = to_string(i);
+    check_permutations(strings, pool);
+    Matrix3D<int, default_functor<int>, allocator<int>, bricked_layout<4, 4, 4>> bricked(ints);
+    check_permutations(bricked, pool);
+
+    cout << endl;
+}
+
+void test_sparse() {
+
+    // SPARSE MATRIX
+
+    cout << "---- SPARSE MATRIX ----" << endl;
+
+    // a huge volume costs nothing until cells are written
+    SparseMatrix3D<int> huge(100000, 100000, 100000, -1);
+    assert(huge.size() == 1000000000000000ul && huge.bricks() == 0 && huge(99999, 5, 77) == -1);
+    huge.set(99999, 5, 77, 3);
+    huge.set(0, 0, 0, 4);
+    assert(huge(99999, 5, 77) == 3 && huge(99999, 5, 78) == -1 && huge.non_empty() == 2 && huge.bricks() == 2);
+
+    // writing the background resets a cell, and the last reset frees the brick
+    huge.set(99999, 5, 77, -1);
+    assert(huge.non_empty() == 1 && huge.bricks() == 1);
+    huge.reset(0, 0, 0);
+    huge.reset(0, 0, 1);
+    assert(huge.non_empty() == 0 && huge.bricks() == 0 && huge.begin() == huge.end());
+
+    // iteration over the non-empty cells only
+    SparseMatrix3D<int> sparse(20, 30, 17);
+    Matrix3D<int> dense(20, 30, 17, 0);
+    for (size_t i = 0; i < 200; ++i) {
+        size_t z = (i * 7) % 20, y = (i * 13) % 30, x = (i * 5) % 17;
+        sparse.set(z, y, x, int(i + 1));
+        dense(z, y, x) = int(i + 1);
+    }
+    size_t visited = 0;
+    long long sum = 0;
+    for (SparseMatrix3D<int>::const_iterator i = sparse.begin(); i != sparse.end(); ++i, ++visited) {
+        Matrix3DIndex c = i.index();
+        assert(*i != 0 && dense(c.z, c.y, c.x) == *i);
+        sum += *i;
+    }
+    assert(visited == sparse.non_empty() && sum == reduce_all<sum_reduction>(dense));
+
+    // conversions to and from dense matrixes
+    assert(sparse.to_dense() == dense);
+    assert(SparseMatrix3D<int>(dense) == sparse);
+    Matrix3D<int, default_functor<int>, allocator<int>, bricked_layout<>> bricked(dense);
+    assert(SparseMatrix3D<int>(bricked) == sparse);
+    assert((sparse.to_dense<allocator<int>, morton_layout<>>()) == (Matrix3D<int, default_functor<int>, allocator<int>, morton_layout<>>(dense)));
+
+    // comparisons and printing only look at the non-empty cells
+    SparseMatrix3D<int> other = sparse;
+    assert(other == sparse);
+    other.set(19, 29, 16, 1000);
+    assert(other != sparse);
+    other.reset(19, 29, 16);
+    assert(other == sparse && !(sparse != SparseMatrix3D<int>(dense)));
+
+    SparseMatrix3D<char> letters(2, 2, 2, '.');
+    letters.set(1, 0, 1, 'b');
+    letters.set(0, 1, 0, 'a');
+    stringstream printed;
+    printed << letters;
+    assert(printed.str() == "rows: 2\ncolumns: 2\nfloors: 2\nbackground: .\nnon-empty cells: 2\n(0, 1, 0): a\n(1, 0, 1): b\n");
+
+    cout << endl;
+}
+
+// Fixed matrix built in a constant expression: the 3x3x3 box filter
+constexpr FixedMatrix3D<int, 3, 3, 3> box_kernel() {
+    FixedMatrix3D<int, 3, 3, 3> k(1);
+    k(1, 1, 1) = -26;
+    return k;
+}
+
+struct doubler {
+    constexpr int operator()(int a) const { return 2 * a; }
+};
+
+void test_fixed() {
+
+    // FIXED-SIZE MATRIX
+
+    cout << "---- FIXED-SIZE MATRIX ----" << endl;
+
+    // construction, indexing, slice, == and trasform in constant expressions
+    constexpr FixedMatrix3D<int, 3, 3, 3> kernel = box_kernel();
+    static_assert(kernel(1, 1, 1) == -26 && kernel(0, 2, 1) == 1, "constexpr indexing");
+    static_assert(FixedMatrix3D<int, 3, 3, 3>::offset(2, 1, 0) == 21 && kernel.size() == 27, "compile-time strides");
+    static_assert(kernel.slice<0, 0, 0, 2, 0, 2>() == FixedMatrix3D<int, 1, 3, 3>(1), "constexpr slice");
+    static_assert(kernel.slice<1, 1, 1, 1, 0, 2>() == FixedMatrix3D<int, 1, 1, 3>({1, -26, 1}), "constexpr slice");
+    static_assert(trasform<int, doubler>(kernel)(1, 1, 1) == -52, "constexpr trasform");
+    static_assert(sizeof(FixedMatrix3D<float, 4, 4, 4>) == 64 * sizeof(float), "inline storage");
+
+    FixedMatrix3D<double, 2, 3, 4> values;
+    for (size_t i = 0; i < values.size(); ++i)
+        values.data()[i] = double(i);
+    assert(values(1, 2, 3) == 23.0 && *(values.end() - 1) == 23.0);
+
+    // conversions from and to Matrix3D
+    Matrix3D<double> dense = values.to_matrix();
+    assert((dense.getFloors() == 2 && dense.getRows() == 3 && dense.getColumns() == 4 && dense(1, 0, 2) == 14.0));
+    assert((FixedMatrix3D<double, 2, 3, 4>(dense)) == values);
+
+    // trasform with a lambda, slice, fill, swap, comparisons
+    FixedMatrix3D<int, 2, 3, 4> rounded = trasform<int>(values, [](double d) { return int(d) % 5; });
+    assert(rounded(1, 2, 3) == 3 && rounded(0, 1, 0) == 4);
+    FixedMatrix3D<int, 1, 2, 2> corner = rounded.slice<1, 1, 1, 2, 2, 3>();
+    assert(corner(0, 0, 0) == 18 % 5 && corner(0, 1, 1) == 23 % 5);
+    FixedMatrix3D<int, 1, 2, 2> other(7);
+    corner.swap(other);
+    assert((corner == FixedMatrix3D<int, 1, 2, 2>(7) && other != corner));
+    other.fill(7);
+    assert(other == corner);
+
+    // same printing as Matrix3D
+    stringstream fixed_printed, dense_printed;
+    fixed_printed << values;
+    dense_printed << dense;
+    assert(fixed_printed.str() == dense_printed.str());
+
+    cout << endl;
+}
+
+void test_instrumentation() {
+
+    // INSTRUMENTATION COUNTERS
+
+    cout << "---- INSTRUMENTATION COUNTERS ----" << endl;
+
+    matrix3d_instrumentation::reset();
+    {
+        Matrix3D<int> a(4, 5, 6, 1);
+        Matrix3D<int> b(a);
+        Matrix3D<int> c;
+        c = b;
+        Matrix3D<int> d = a.slice(0, 1, 0, 1, 0, 1);
+        int values[] = {1, 2, 3};
+        c.fill(values, values + 3);
+        Matrix3D<double> e(a);
+        Matrix3D<int> f(std::move(b));
+    }
+    matrix3d_counters counters = matrix3d_instrumentation::snapshot();
+
+    if constexpr (matrix3d_instrumentation::enabled) {
+        // a, b, c, the slice and the conversion (fill writes the cells of c in place)
+        assert(counters.allocations == 5 && counters.deallocations == 5);
+        assert(counters.bytes_allocated == counters.bytes_deallocated);
+        assert(counters.bytes_allocated == 3 * 120 * sizeof(int) + 8 * sizeof(int) + 120 * sizeof(double));
+        assert(counters.copies(Matrix3DCopyKind::copy_constructor) == 1);
+        assert(counters.copies(Matrix3DCopyKind::copy_assignment) == 1);
+        assert(counters.copies(Matrix3DCopyKind::slice) == 1);
+        assert(counters.copies(Matrix3DCopyKind::fill) == 0);
+        assert(counters.copies(Matrix3DCopyKind::conversion) == 1);
+        assert(counters.total_copies() == 4 && counters.elements_touched == 3 * 120 + 8);
+    }
+    else {
+        assert(counters.allocations == 0 && counters.total_copies() == 0 && counters.elements_touched == 0);
+    }
+
+    // export of the counters
+    size_t exported = 0, total = 0;
+    counters.visit([&](const char *name, size_t value) {
+        assert(name != nullptr);
+        ++exported;
+        total += value;
+    });
+    assert(exported == 12 && total == counters.allocations + counters.deallocations + counters.bytes_allocated 
+        + counters.bytes_deallocated + counters.total_copies() + counters.elements_touched + counters.shared_copies + counters.detaches);
+
+    matrix3d_instrumentation::reset();
+    assert(matrix3d_instrumentation::snapshot().allocations == 0);
+
+    cout << endl;
+}
+
+// Writes the matrix with the stream operator of the cells instead of to_chars (unitbuf does not change the text)
+template <typename M>
+string text_of(const M &A, bool fast = true) {
+    ostringstream os;
+    if (!fast)
+        os << unitbuf;
+    os << A;
+    return os.str();
+}
+
+void test_text_io() {
+
+    // TEXT SERIALIZATION
+
+    cout << "---- TEXT SERIALIZATION ----" << endl;
+
+    Matrix3D<int> A(3, 4, 5);
+    for (size_t i = 0; i < A.size(); ++i)
+        *(A.begin() + i) = int(i * 7919 % 2001) - 1000;
+
+    // to_chars writes exactly the text of the stream operators of the cells
+    assert(text_of(A) == text_of(A, false));
+    assert(text_of(A).compare(0, 37, "rows: 4\ncolumns: 5\nfloors: 3\nmatrix: ") == 0);
+
+    Matrix3D<double> D(2, 3, 4);
+    for (size_t i = 0; i < D.size(); ++i)
+        *(D.begin() + i) = (double(i) - 11.5) / 3 * (i % 5 == 0 ? 1e7 : 1);
+    assert(text_of(D) == text_of(D, false));
+
+    Matrix3D<char> C(2, 2, 3, 'q');
+    C(1, 1, 2) = 'Z';
+    assert(text_of(C) == text_of(C, false));
+
+    Matrix3D<bool> B(1, 2, 2, true);
+    B(0, 1, 0) = false;
+    assert(text_of(B) == text_of(B, false));
+
+    // views are written by the same writer, in the same format as the matrixes
+    const Matrix3D<double> &d = D;
+    assert(text_of(d.view(0, 1, 1, 2, 1, 3)) == text_of(d.slice(0, 1, 1, 2, 1, 3)));
+    assert(text_of(d.view(0, 1, 1, 2, 1, 3)) == text_of(d.view(0, 1, 1, 2, 1, 3), false));
+    assert(text_of(A.view(1, 2, 0, 3, 2, 2)) == text_of(A.slice(1, 2, 0, 3, 2, 2), false));
+
+    // round trip of integers, through both parsers
+    Matrix3D<int> A2, A3;
+    istringstream(text_of(A)) >> A2;
+    assert(A2 == A);
+    istringstream slow(text_of(A));
+    slow >> hex >> dec >> unitbuf;
+    slow >> A3;
+    assert(A3 == A);
+
+    // doubles are exact with 17 significant digits
+    ostringstream precise;
+    precise.precision(17);
+    precise << D;
+    Matrix3D<double> D2;
+    istringstream(precise.str()) >> D2;
+    assert(D2 == D);
+
+    Matrix3D<char> C2;
+    istringstream(text_of(C)) >> C2;
+    assert(C2 == C);
+
+    // layouts other than row-major
+    Matrix3D<int, default_functor<int>, allocator<int>, bricked_layout<2, 2, 2>> bricked(A), bricked2;
+    assert(text_of(bricked) == text_of(A));
+    istringstream(text_of(A)) >> bricked2;
+    assert(bricked2 == bricked);
+
+    // several matrixes in a stream, and nothing after the last cell is consumed
+    istringstream two(text_of(A) + text_of(A2.slice(0, 0, 0, 1, 0, 1)) + "tail");
+    Matrix3D<int> first, second;
+    two >> first >> second;
+    assert(first == A && second == A.slice(0, 0, 0, 1, 0, 1));
+    string tail;
+    two >> tail;
+    assert(tail == "tail");
+
+    // empty matrix
+    Matrix3D<int> empty, empty2(1, 1, 1);
+    istringstream(text_of(empty)) >> empty2;
+    assert(empty2.size() == 0);
+
+    // malformed text sets the failbit and leaves the matrix unchanged
+    const char *bad[] = {
+        "rows: 2\ncolumns: 2\nfloors: 1\nmatrix: \n1° floor: 0\n1 2 \n3 x \n",
+        "rows: 2\ncolumns: 2\nfloors: 1\nmatrix: \n1° floor: 0\n1 2 \n3 \n",
+        "rows: 2\ncolumns: 2\nfloors: 1\nmatrix: \n1° floor: 1\n1 2 \n3 4 \n",
+        "columns: 2\nrows: 2\nfloors: 1\nmatrix: \n1° floor: 0\n1 2 \n3 4 \n",
+        "rows: 0\ncolumns: 2\nfloors: 1\nmatrix: \n1° floor: 0\n",
+        "rows: 1\ncolumns: 1\nfloors: 1\nmatrix: \n1° floor: 0\n99999999999 \n",
+        "rows: 4294967296\ncolumns: 4294967296\nfloors: 4294967296\nmatrix: \n"
+    };
+    for (const char *text : bad) {
+        Matrix3D<int> kept(A);
+        istringstream is(text);
+        is >> kept;
+        assert(is.fail() && kept == A);
+    }
+
+    // a well-formed text is read
+    Matrix3D<int> small;
+    istringstream("rows: 2\ncolumns: 2\nfloors: 1\nmatrix: \n1° floor: 0\n1 2 \n3 -4 \n") >> small;
+    assert(small.getFloors() == 1 && small.getRows() == 2 && small.getColumns() == 2 && small(0, 1, 1) == -4);
+
+    cout << A2.slice(0, 0, 0, 1, 0, 4);
+}
+
+// Cell type without a default constructor which counts the live objects, and can throw on a copy
+struct tracked {
+    static int live;
+    static int copies_before_throw; // negative: never throws
+    int value;
+
+    explicit tracked(int v) : value(v) { ++live; }
+    tracked(const tracked &other) : value(other.value) {
+        if (copies_before_throw == 0)
+            throw runtime_error("tracked: copy failed");
+        if (copies_before_throw > 0)
+            --copies_before_throw;
+        ++live;
+    }
+    tracked &operator=(const tracked &other) { value = other.value; return *this; }
+    ~tracked() { --live; }
+
+    bool operator==(const tracked &other) const { return value == other.value; }
+};
+
+int tracked::live = 0;
+int tracked::copies_before_throw = -1;
+
+// Return true if the construction throws, leaving no live tracked object behind
+template <typename Fn>
+bool throws_without_leaks(int copies, Fn construct) {
+    const int live = tracked::live;
+    tracked::copies_before_throw = copies;
+    bool thrown = false;
+    try {
+        construct();
+    }
+    catch (const runtime_error &) {
+        thrown = true;
+    }
+    tracked::copies_before_throw = -1;
+    return thrown && tracked::live == live;
+}
+
+void test_raw_storage() {
+
+    // RAW STORAGE AND UNINITIALIZED CONSTRUCTION
+
+    cout << "---- RAW STORAGE AND UNINITIALIZED CONSTRUCTION ----" << endl;
+
+    static_assert(matrix3d_plain_construct<allocator<int>, int>::value, "std::allocator constructs with placement new");
+    static_assert(matrix3d_plain_construct<aligned_allocator<int>, int>::value, "aligned_allocator has no construct member");
+    static_assert(!matrix3d_plain_construct<scoped_allocator_adaptor<allocator<int>>, int>::value, "scoped_allocator_adaptor has its own construct");
+
+    // bulk initialization: zeros, memset of a byte, fill of a value, memcpy of a copy
+    Matrix3D<int> zeros(3, 4, 5);
+    assert(count(zeros.begin(), zeros.end(), 0) == 60);
+    Matrix3D<char> chars(3, 4, 5, 'f');
+    assert(count(chars.begin(), chars.end(), 'f') == 60);
+    Matrix3D<double> halves(3, 4, 5, 0.5);
+    assert(count(halves.begin(), halves.end(), 0.5) == 60);
+    halves(2, 3, 4) = 7;
+    Matrix3D<double> halves_copy(halves);
+    assert(halves_copy == halves);
+
+    // cells constructed one by one through an allocator with its own construct
+    Matrix3D<int, default_functor<int>, scoped_allocator_adaptor<allocator<int>>> scoped(2, 2, 2, 9), scoped_copy(scoped);
+    assert(count(scoped_copy.begin(), scoped_copy.end(), 9) == 8);
+
+    // uninitialized cells, to be overwritten
+    Matrix3D<int> raw(uninitialized, 2, 3, 4);
+    assert(raw.getFloors() == 2 && raw.getRows() == 3 && raw.getColumns() == 4);
+    for (size_t i = 0; i < raw.size(); ++i)
+        *(raw.begin() + i) = int(i);
+    assert(raw(1, 2, 3) == 23);
+    Matrix3D<customType> raw_custom(uninitialized, 1, 2, 2);
+    assert(raw_custom(0, 1, 1) == customType());
+
+    // cells without a default constructor
+    {
+        Matrix3D<tracked> A(2, 3, 4, tracked(1));
+        assert(tracked::live == 24);
+        A(1, 2, 3) = tracked(5);
+        Matrix3D<tracked> B(A);
+        assert(B == A && tracked::live == 48);
+        Matrix3D<tracked> S = A.slice(1, 1, 1, 2, 2, 3);
+        assert(tracked::live == 52);
+        assert(S.size() == 4 && S(0, 1, 1) == tracked(5));
+        Matrix3D<tracked, default_functor<tracked>, allocator<tracked>, bricked_layout<2, 2, 2>> bricked(A);
+        assert(bricked(1, 2, 3) == tracked(5) && bricked(0, 0, 0) == tracked(1));
+        Matrix3D<tracked, default_functor<tracked>, allocator<tracked>, bricked_layout<2, 2, 2>> bricked_slice = bricked.slice(0, 1, 1, 2, 3, 3);
+        assert(bricked_slice(1, 1, 0) == tracked(5));
+        Matrix3D<tracked> converted(zeros);
+        assert(converted.size() == 60 && converted(2, 3, 4) == tracked(0));
+
+        // a failed construction destroys the cells already constructed
+        assert(throws_without_leaks(10, [] { Matrix3D<tracked> C(2, 3, 4, tracked(1)); }));
+        assert(throws_without_leaks(10, [&A] { Matrix3D<tracked> C(A); }));
+        assert(throws_without_leaks(2, [&A] { Matrix3D<tracked> C = A.slice(0, 1, 0, 1, 0, 1); }));
+        assert(throws_without_leaks(3, [&bricked] { auto C = bricked.slice(0, 1, 0, 1, 0, 1); }));
+    }
+    assert(tracked::live == 0);
+
+    cout << raw;
+}
+
+// Cell type whose assignment throws when the assigned value is negative
+struct picky {
+    int value;
+
+    picky(int v = 0) : value(v) {}
+    picky &operator=(const picky &other) {
+        if (other.value < 0)
+            throw runtime_error("picky: negative value");
+        value = other.value;
+        return *this;
+    }
+
+    bool operator==(const picky &other) const { return value == other.value; }
+};
+
+void test_fill_in_place() {
+
+    // IN-PLACE FILL, FILL WITH A VALUE AND FILL OF A REGION
+
+    cout << "---- IN-PLACE FILL, FILL WITH A VALUE AND FILL OF A REGION ----" << endl;
+
+    Matrix3DThreadPool pool(4);
+
+    vector<int> values(4 * 5 * 6);
+    iota(values.begin(), values.end(), 0);
+
+    // memmove from a vector of cells of the same type, and conversion from another type
+    Matrix3D<int> A(4, 5, 6, -1);
+    A.fill(values.begin(), values.end());
+    assert(equal(A.begin(), A.end(), values.begin()));
+    Matrix3D<double> D(4, 5, 6);
+    D.fill(values.begin(), values.end());
+    assert(D(3, 4, 5) == 119.0);
+
+    // shorter and longer sequences
+    Matrix3D<int> B(2, 2, 2, -1);
+    B.fill(values.begin(), values.begin() + 3);
+    assert(B(0, 0, 0) == 0 && B(0, 0, 1) == 1 && B(0, 1, 0) == 2 && B(0, 1, 1) == -1 && B(1, 1, 1) == -1);
+    B.fill(values.rbegin(), values.rend());
+    assert(B(0, 0, 0) == 119 && B(1, 1, 1) == 112);
+
+    // a sequence of cells of the matrix itself
+    Matrix3D<int> shifted(A);
+    shifted.fill(shifted.begin() + 1, shifted.end());
+    assert(shifted(0, 0, 0) == 1 && shifted(3, 4, 4) == 119 && shifted(3, 4, 5) == 119);
+
+    // fill with a value, sequentially and in parallel
+    A.fill(7);
+    assert(count(A.begin(), A.end(), 7) == 120);
+    Matrix3D<float> big(32, 32, 32);
+    big.fill(2.5f, pool);
+    assert(count(big.begin(), big.end(), 2.5f) == 32 * 32 * 32);
+
+    // parallel fill, with a memcpy per block and with conversions
+    vector<float> ramp(big.size());
+    iota(ramp.begin(), ramp.end(), 0.0f);
+    big.fill(ramp.begin(), ramp.end(), pool);
+    assert(equal(big.begin(), big.end(), ramp.begin()));
+    Matrix3D<double> big_double(32, 32, 32);
+    big_double.fill(ramp.begin(), ramp.end() - 10, pool);
+    assert(big_double(31, 31, 21) == 32767.0 - 10 && big_double(31, 31, 22) == 0.0);
+    Matrix3D<float> big_shifted(big);
+    big_shifted.fill(big_shifted.begin() + 1, big_shifted.end(), pool);
+    assert(big_shifted(0, 0, 0) == 1.0f && big_shifted(31, 31, 30) == 32767.0f);
+
+    // fill of a region, with the row-major and the bricked layouts
+    Matrix3D<int> R(4, 5, 6, 0);
+    R.fill_region(1, 2, 0, 3, 2, 4, 9);
+    Matrix3D<int, default_functor<int>, allocator<int>, bricked_layout<2, 2, 2>> bricked(4, 5, 6, 0);
+    bricked.fill_region(1, 2, 0, 3, 2, 4, 9);
+    size_t nines = 0;
+    for (size_t z = 0; z < 4; ++z)
+        for (size_t y = 0; y < 5; ++y)
+            for (size_t x = 0; x < 6; ++x) {
+                const bool inside = z >= 1 && z <= 2 && y <= 3 && x >= 2 && x <= 4;
+                assert(R(z, y, x) == (inside ? 9 : 0) && bricked(z, y, x) == R(z, y, x));
+                nines += inside;
+            }
+    assert(nines == 2 * 4 * 3);
+
+    // cells whose assignment may throw are filled in a copy: the matrix is unchanged on failure
+    Matrix3D<picky> P(1, 2, 2, picky(1));
+    const int bad[] = {5, 6, -1, 8};
+    bool thrown = false;
+    try {
+        P.fill(bad, bad + 4);
+    }
+    catch (const runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown && count(P.begin(), P.end(), picky(1)) == 4);
+    thrown = false;
+    try {
+        P.fill_region(0, 0, 0, 1, 1, 1, picky(-1));
+    }
+    catch (const runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown && count(P.begin(), P.end(), picky(1)) == 4);
+    P.fill(bad, bad + 2);
+    P.fill_region(0, 0, 1, 1, 0, 1, picky(3));
+    assert(P(0, 0, 0) == picky(5) && P(0, 0, 1) == picky(6) && P(0, 1, 0) == picky(3) && P(0, 1, 1) == picky(3));
+
+    cout << R.slice(1, 1, 0, 4, 0, 5);
+}
+
+void test_zip_transform() {
+
+    // ZIP TRANSFORM AND TRANSFORM IN PLACE
+
+    cout << "---- ZIP TRANSFORM AND TRANSFORM IN PLACE ----" << endl;
+
+    Matrix3DThreadPool pool(4);
+
+    const size_t n = 20;
+    Matrix3D<float> A(n, n, n), B(n, n, n);
+    Matrix3D<bool> mask(n, n, n);
+    Matrix3D<int> weights(n, n, n);
+    for (size_t i = 0; i < A.size(); ++i) {
+        *(A.begin() + i) = float(i % 97);
+        *(B.begin() + i) = float(i % 13) / 2;
+        *(mask.begin() + i) = (i % 3 != 0);
+        *(weights.begin() + i) = int(i % 5);
+    }
+
+    // out = f(A, B, mask), sequentially and in parallel
+    auto masked_sum = [](float a, float b, bool m) { return m ? a + b : 0.0f; };
+    Matrix3D<float> out(n, n, n), parallel_out(n, n, n);
+    zip_transform(out, masked_sum, A, B, mask);
+    zip_transform(pool, parallel_out, masked_sum, A, B, mask);
+    for (size_t z = 0; z < n; ++z)
+        for (size_t y = 0; y < n; ++y)
+            for (size_t x = 0; x < n; ++x)
+                assert(out(z, y, x) == masked_sum(A(z, y, x), B(z, y, x), mask(z, y, x)));
+    assert(parallel_out == out);
+
+    // four inputs, into a destination of another type
+    Matrix3D<double> weighted(n, n, n);
+    zip_transform(weighted, [](float a, float b, bool m, int w) { return m ? double(a) * w - b : -1.0; }, A, B, mask, weights);
+    assert(weighted(0, 0, 0) == -1.0 && weighted(0, 0, 1) == 1.0 * 1 - 0.5);
+
+    // the destination as an input
+    Matrix3D<float> accumulated(A);
+    zip_transform(accumulated, plus<float>(), accumulated, B);
+    assert(accumulated == A + B);
+
+    // inputs with a different layout are read through their coordinates
+    Matrix3D<float, default_functor<float>, allocator<float>, bricked_layout<4, 4, 4>> bricked(B);
+    Matrix3D<float> mixed(n, n, n), mixed_parallel(n, n, n);
+    zip_transform(mixed, masked_sum, A, bricked, mask);
+    zip_transform(pool, mixed_parallel, masked_sum, A, bricked, mask);
+    assert(mixed == out && mixed_parallel == out);
+
+    // transform in place
+    Matrix3D<int> C(weights);
+    transform_inplace(C, [](int v) { return 2 * v + 1; });
+    assert(C(0, 0, 3) == 7 && C(0, 0, 5) == 1);
+    transform_inplace(C, [](int v) { return (v - 1) / 2; }, pool);
+    assert(C == weights);
+
+    cout << trasform<int>(mixed.slice(0, 0, 0, 1, 0, 9), [](float v) { return int(v); });
+}
+
+void test_rolling() {
+
+    // ROLLING WINDOW OF FLOORS
+
+    cout << "---- ROLLING WINDOW OF FLOORS ----" << endl;
+
+    const size_t rows = 2, columns = 3;
+    RollingMatrix3D<int> R(4, rows, columns);
+    assert(R.getFloors() == 0 && R.size() == 0 && R.begin() == R.end() && R.contiguous().size() == 0);
+
+    // frame k holds k * 10 + its index
+    vector<Matrix3D<int>> frames;
+    for (int k = 0; k < 7; ++k) {
+        Matrix3D<int> frame(1, rows, columns);
+        for (size_t i = 0; i < frame.size(); ++i)
+            *(frame.begin() + i) = k * 10 + int(i);
+        frames.push_back(frame);
+    }
+
+    // the window grows, then keeps the last 4 floors
+    for (int k = 0; k < 7; ++k) {
+        R.push_floor(frames[k].begin());
+        const size_t kept = min<size_t>(k + 1, 4);
+        assert(R.getFloors() == kept && R.full() == (kept == 4));
+        for (size_t z = 0; z < kept; ++z)
+            assert(R(z, 1, 2) == (k + 1 - int(kept) + int(z)) * 10 + 5);
+    }
+
+    // the window as a contiguous matrix, and through its iterators
+    Matrix3D<int> window = R.contiguous();
+    assert(window.getFloors() == 4 && window(0, 0, 0) == 30 && window(3, 1, 2) == 65);
+    assert(R.end() - R.begin() == 24 && equal(R.begin(), R.end(), window.begin()));
+    const RollingMatrix3D<int> &constant = R;
+    RollingMatrix3D<int>::const_iterator c = R.begin();
+    assert(c == constant.begin() && c[6] == 40 && *(constant.end() - 1) == 65);
+    assert(accumulate(R.begin(), R.end(), 0) == accumulate(window.begin(), window.end(), 0));
+
+    // trasform, as on the contiguous matrix
+    auto half = [](int v) { return v / 2.0; };
+    assert(trasform<double>(R, half) == trasform<double>(window, half));
+
+    // writes through operator() and the iterators reach the ring
+    R(2, 0, 1) = -1;
+    *(R.begin() + 13) = -2;
+    assert(R.contiguous()(2, 0, 1) == -2);
+    sort(R.begin(), R.end());
+    assert(is_sorted(R.begin(), R.end()) && R(0, 0, 0) == -2);
+
+    // windows are equal whatever the position of their oldest floor in the ring
+    RollingMatrix3D<int> S(4, rows, columns), T(4, rows, columns);
+    for (int k = 0; k < 6; ++k)
+        S.push_floor(frames[k].begin());
+    for (int k = 2; k < 6; ++k)
+        T.push_floor(frames[k].begin());
+    assert(S == T);
+    T.push_floor(frames[6].begin());
+    assert(S != T);
+
+    // a floor written in place
+    int *newest = S.push_floor();
+    copy(frames[6].begin(), frames[6].end(), newest);
+    assert(S == T && S.plane(3) == newest);
+
+    S.clear();
+    assert(S.getFloors() == 0 && S.capacity() == 4);
+
+    cout << T;
+}
+
+// Stage of a pipeline taking the volume by value and only reading it
+template <typename M>
+float pipeline_stage(M volume) {
+    return volume.size() > 0 ? static_cast<const M &>(volume)(0, 0, 0) : 0.0f;
+}
+
+void test_cow() {
+
+    // COPY-ON-WRITE MATRIX
+
+    cout << "---- COPY-ON-WRITE MATRIX ----" << endl;
+
+    matrix3d_instrumentation::reset();
+
+    CowMatrix3D<float> A(4, 5, 6, 1.0f);
+    const CowMatrix3D<float> &a = A;
+    assert(A.unique() && A.use_count() == 1);
+
+    // copies share the cells
+    CowMatrix3D<float> B(A), C;
+    C = B;
+    assert(A.use_count() == 3 && &B.matrix() == &A.matrix() && &C.matrix() == &A.matrix());
+    assert(pipeline_stage(A) == 1.0f);
+    assert(A.use_count() == 3);
+
+    // reads through constant references do not detach, writes do
+    assert(as_const(B)(3, 4, 5) == 1.0f && as_const(B).begin() == a.matrix().begin() && B.use_count() == 3);
+    B(3, 4, 5) = 2.0f;
+    assert(B.unique() && A.use_count() == 2 && as_const(B)(3, 4, 5) == 2.0f && a(3, 4, 5) == 1.0f && as_const(C)(3, 4, 5) == 1.0f);
+    assert(A == C && A != B);
+
+    // a write to a matrix which is not shared happens in place
+    const float *cells = B.matrix().begin();
+    B(0, 0, 0) = 3.0f;
+    *B.begin() = 4.0f;
+    assert(B.matrix().begin() == cells && as_const(B)(0, 0, 0) == 4.0f);
+
+    // a reference handed out by a non-const call marks the cells leaked: the next copies are deep
+    CowMatrix3D<float> L(2, 2, 2, 0.0f);
+    float &leaked = L(0, 0, 0);
+    CowMatrix3D<float> M = L, N;
+    N = L;
+    leaked = 1.0f;
+    assert(as_const(M)(0, 0, 0) == 0.0f && as_const(N)(0, 0, 0) == 0.0f && as_const(L)(0, 0, 0) == 1.0f);
+    assert(L.unique() && M.unique() && N.unique());
+    CowMatrix3D<float> O = M;
+    assert(M.use_count() == 2);
+    L = M;
+    assert(L.use_count() == 3 && as_const(L)(0, 0, 0) == 0.0f);
+
+    // fill with a value replaces shared cells without copying them, the other fills detach
+    CowMatrix3D<float> D(A);
+    D.fill(5.0f);
+    assert(count(as_const(D).begin(), as_const(D).end(), 5.0f) == 120 && a(0, 0, 0) == 1.0f);
+    CowMatrix3D<float> E(A);
+    vector<float> ramp(120);
+    iota(ramp.begin(), ramp.end(), 0.0f);
+    E.fill(ramp.begin(), ramp.end());
+    CowMatrix3D<float> G(A);
+    G.fill_region(0, 0, 0, 0, 0, 1, 9.0f);
+    assert(as_const(E)(3, 4, 5) == 119.0f && as_const(G)(0, 0, 1) == 9.0f && as_const(G)(0, 0, 2) == 1.0f && a(0, 0, 1) == 1.0f);
+    assert(A.use_count() == 2);
+
+    // swap and moves only exchange the blocks
+    CowMatrix3D<float> H(A);
+    swap(H, B);
+    assert(B.use_count() == 3 && H.unique() && as_const(H)(3, 4, 5) == 2.0f);
+    CowMatrix3D<float> moved(std::move(H));
+    assert(as_const(moved)(3, 4, 5) == 2.0f && H.size() == 0 && H.use_count() == 0);
+
+    // the functions of Matrix3D work on matrix()
+    assert(trasform<double>(A.matrix(), [](float v) { return v * 2.0; })(1, 1, 1) == 2.0);
+    CowMatrix3D<float> from_matrix(Matrix3D<float>(2, 2, 2, 7.0f));
+    assert(as_const(from_matrix)(1, 1, 1) == 7.0f && from_matrix != A);
+
+    matrix3d_counters counters = matrix3d_instrumentation::snapshot();
+    if constexpr (matrix3d_instrumentation::enabled) {
+        // B, C, the copy passed to the stage, O, L, D, E, G, H: 9 shared copies (M and N copied leaked cells); B, E and G detached
+        assert(counters.shared_copies == 9 && counters.detaches == 3 && counters.copies_saved() == 6);
+    }
+
+    // copies sharing cells which are not equal to themselves compare as their matrixes do
+    CowMatrix3D<double> with_nan(2, 2, 2, 1.0), shared_nan;
+    with_nan.fill_region(1, 1, 1, 1, 1, 1, numeric_limits<double>::quiet_NaN());
+    shared_nan = with_nan;
+    assert(&shared_nan.matrix() == &with_nan.matrix());
+    assert(Matrix3D<double>(with_nan.matrix()) != with_nan.matrix() && with_nan.matrix() != shared_nan.matrix() && with_nan != shared_nan);
+    CowMatrix3D<int> ints(2, 2, 2, 1), shared_ints(ints);
+    assert(ints == shared_ints);
+
+    // concurrent readers and copies of the same matrix
+    CowMatrix3D<float> shared(64, 64, 64, 1.0f);
+    vector<thread> readers;
+    atomic<size_t> ones(0);
+    for (int t = 0; t < 4; ++t)
+        readers.emplace_back([&shared, &ones] {
+            for (int r = 0; r < 100; ++r) {
+                const CowMatrix3D<float> copy(shared);
+                ones += (copy(r % 64, 1, 2) == 1.0f);
+            }
+        });
+    for (thread &t : readers)
+        t.join();
+    assert(ones == 400 && shared.unique());
+
+    matrix3d_instrumentation::reset();
+
+    cout << G.matrix().slice(0, 0, 0, 1, 0, 5);
+}
+
+// Hash of keyed_cell agreeing with its ==, which only looks at the key
+namespace std {
+
+template <>
+struct hash<keyed_cell> {
+    size_t operator()(const keyed_cell &cell) const {
+        return hash<int>()(cell.key);
+    }
+};
+
+}
+
+void test_hash() {
+
+    // CONTENT HASH
+
+    cout << "---- CONTENT HASH ----" << endl;
+
+    // the same hash on every target, SIMD or not, with and without a tail shorter than a stripe
+    Matrix3D<int> A(16, 16, 16), B(5, 7, 9);
+    iota(A.begin(), A.end(), 0);
+    iota(B.begin(), B.end(), 0);
+    assert(A.hash() == 0xcf38494f1b2e55f5ULL && B.hash() == 0x956264e63f6ee2beULL);
+    assert(Matrix3D<double>(3, 3, 3, -1.5).hash() == 0x6c0bed351c765334ULL);
+
+    // streaming in pieces of any size gives the same hash as hashing at once
+    vector<unsigned char> bytes(5000);
+    for (size_t i = 0; i < bytes.size(); ++i)
+        bytes[i] = static_cast<unsigned char>(i * 131 + 7);
+    matrix3d_hasher whole(42), pieces(42);
+    whole.update(bytes.data(), bytes.size());
+    for (size_t i = 0, step = 1; i < bytes.size(); i += step, step = step * 3 % 97 + 1)
+        pieces.update(bytes.data() + i, min(step, bytes.size() - i));
+    assert(whole.digest() == pieces.digest() && whole.digest() != matrix3d_hasher(43).digest());
+
+    // any change of a cell or of the dimensions changes the hash
+    const Matrix3D<int> &a = A;
+    const uint64_t h = a.hash();
+    assert(a.hash() == h);
+    A(7, 8, 9) ^= 1 << 20;
+    assert(a.hash() != h);
+    A(7, 8, 9) ^= 1 << 20;
+    assert(a.hash() == h);
+    Matrix3D<int> flat(1, 1, 4096), tall(4096, 1, 1);
+    copy(a.begin(), a.end(), flat.begin());
+    copy(a.begin(), a.end(), tall.begin());
+    assert(flat.hash() != h && tall.hash() != h && flat.hash() != tall.hash());
+
+    // different dimensions compare different, without asserting
+    assert(!(flat == tall) && flat != tall && !(A == B));
+
+    // the hash is computed at every call, so writes through kept pointers are seen
+    Matrix3D<int> C = A;
+    int *cell = &C(0, 0, 0);
+    *cell = -1;
+    assert(C.hash() != h && C != A);
+    *cell = 0;
+    assert(C.hash() == h && C == A);
+
+    // -0.0 == +0.0, so they have the same hash
+    Matrix3D<float> zeros(2, 2, 2, 0.0f), negative_zeros(2, 2, 2, -0.0f);
+    assert(zeros == negative_zeros && zeros.hash() == negative_zeros.hash());
+
+    // cells without a bytewise hash go through std::hash
+    Matrix3D<string> words(2, 2, 2, "cell");
+    Matrix3D<string> other_words(words);
+    other_words(1, 1, 1) = "other";
+    assert(words.hash() != other_words.hash() && words.hash() == Matrix3D<string>(2, 2, 2, "cell").hash());
+    static_assert(!matrix3d_hashable<customType>::value, "customType has no std::hash");
+
+    // class types go through std::hash, so cells equal by their == hash the same whatever their bytes
+    static_assert(!matrix3d_hash_as_bytes<keyed_cell>::value && matrix3d_hash_as_bytes<packed_cell>::value, 
+        "only the types with bytewise == are hashed as raw bytes");
+    Matrix3D<keyed_cell> keyed(2, 2, 2, keyed_cell{1, 0}), other_keyed(2, 2, 2, keyed_cell{1, 7});
+    assert(keyed == other_keyed && keyed.hash() == other_keyed.hash());
+    assert(hash<Matrix3D<keyed_cell>>()(keyed) == hash<Matrix3D<keyed_cell>>()(other_keyed));
+    assert(HashedMatrix3D<keyed_cell>(keyed) == HashedMatrix3D<keyed_cell>(other_keyed));
+
+    // deduplication of volumes by content
+    unordered_map<Matrix3D<int>, int> seen;
+    vector<Matrix3D<int>> volumes = {A, B, A, flat, B, A};
+    int duplicates = 0;
+    for (const Matrix3D<int> &volume : volumes)
+        duplicates += !seen.emplace(volume, int(seen.size())).second;
+    assert(duplicates == 3 && seen.size() == 3 && seen.at(flat) == 2);
+    static_assert(!is_default_constructible<hash<Matrix3D<int, bool (*)(int, int)>>>::value, 
+        "no std::hash with an equality functor other than the default one");
+
+    // HASHED MATRIX
+
+    cout << "---- HASHED MATRIX ----" << endl;
+
+    // the hash is computed once, with the cells
+    HashedMatrix3D<int> HA(A), HB(B);
+    assert(HA.hash() == h && HB.hash() == B.hash() && HA.matrix() == A);
+    assert(HA(7, 8, 9) == A(7, 8, 9) && equal(HA.begin(), HA.end(), A.begin()));
+
+    // the bulk mutators hash the cells again
+    HashedMatrix3D<int> HC(HA);
+    HC.fill(0);
+    assert(HC.hash() == Matrix3D<int>(16, 16, 16).hash() && HC != HA);
+    HC.fill(a.begin(), a.end());
+    assert(HC.hash() == h && HC == HA);
+    HC.fill_region(0, 0, 0, 0, 0, 0, -1);
+    assert(HC.hash() != h && HC != HA);
+
+    // cells written one by one are released and wrapped again
+    Matrix3D<int> released = HC.release();
+    assert(HC.size() == 0 && HC.hash() == Matrix3D<int>().hash());
+    released(0, 0, 0) = 0;
+    HC = HashedMatrix3D<int>(move(released));
+    assert(HC.hash() == h && HC == HA);
+
+    // moves leave an empty matrix with its hash, swaps exchange the hashes
+    HashedMatrix3D<int> HD(move(HC));
+    assert(HD.hash() == h && HC.hash() == HashedMatrix3D<int>().hash() && HC == HashedMatrix3D<int>());
+    HD.swap(HB);
+    assert(HD.hash() == B.hash() && HB.hash() == h);
+
+    // deduplication with the hash computed once per volume
+    unordered_map<HashedMatrix3D<int>, int> hashed_seen;
+    int hashed_duplicates = 0;
+    for (Matrix3D<int> &volume : volumes)
+        hashed_duplicates += !hashed_seen.emplace(HashedMatrix3D<int>(move(volume)), int(hashed_seen.size())).second;
+    assert(hashed_duplicates == 3 && hashed_seen.size() == 3 && hashed_seen.at(HashedMatrix3D<int>(flat)) == 2);
+    static_assert(!is_default_constructible<hash<HashedMatrix3D<int, bool (*)(int, int)>>>::value, 
+        "no std::hash with an equality functor other than the default one");
+
+    cout << "hash of a 16x16x16 ramp: " << hex << h << dec << endl;
+}
 
 int main() {
 
@@ -801,6 +2701,54 @@ int main() {
 
     test_conversion();
 
+    test_move_semantics();
+
+    test_view();
+
+    test_64bit_extents();
+
+    test_allocators();
+
+    test_mismatch();
+
+    test_parallel_trasform();
+
+    test_expression_templates();
+
+    test_reductions();
+
+    test_binary_io();
+
+    test_tiled();
+
+    test_layouts();
+
+    test_morton_layout();
+
+    test_stencils();
+
+    test_permute_axes();
+
+    test_sparse();
+
+    test_fixed();
+
+    test_instrumentation();
+
+    test_text_io();
+
+    test_raw_storage();
+
+    test_fill_in_place();
+
+    test_zip_transform();
+
+    test_rolling();
+
+    test_cow();
+
+    test_hash();
+
     return 0;
 
 }
\ No newline at end of file